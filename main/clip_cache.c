@@ -0,0 +1,246 @@
+#include "clip_cache.h"
+#include "config.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "CLIP_CACHE";
+
+typedef struct {
+    char id[CLIP_ID_LEN + 1];
+    uint8_t *data;          // PSRAM
+    size_t size;
+    size_t received;        // == size once complete
+    uint32_t last_used;     // LRU tick, 0 = free slot
+} clip_slot_t;
+
+static clip_slot_t g_slots[CLIP_CACHE_SLOTS];
+static clip_slot_t *g_receiving = NULL;
+static size_t g_total_bytes = 0;
+static uint32_t g_tick = 0;
+static clip_evict_cb_t g_on_evict = NULL;
+
+// Mutex for thread-safe access
+static SemaphoreHandle_t clip_mutex = NULL;
+
+static clip_slot_t *find(const char *id) {
+    for (int i = 0; i < CLIP_CACHE_SLOTS; i++) {
+        if (g_slots[i].last_used && strncmp(g_slots[i].id, id, CLIP_ID_LEN) == 0) {
+            return &g_slots[i];
+        }
+    }
+    return NULL;
+}
+
+static void release(clip_slot_t *slot) {
+    if (slot == g_receiving) {
+        g_receiving = NULL;
+    }
+    g_total_bytes -= slot->size;
+    heap_caps_free(slot->data);
+    memset(slot, 0, sizeof(*slot));
+}
+
+static clip_slot_t *free_slot(void) {
+    for (int i = 0; i < CLIP_CACHE_SLOTS; i++) {
+        if (!g_slots[i].last_used) {
+            return &g_slots[i];
+        }
+    }
+    return NULL;
+}
+
+static clip_slot_t *lru_slot(void) {
+    clip_slot_t *lru = NULL;
+    for (int i = 0; i < CLIP_CACHE_SLOTS; i++) {
+        if (g_slots[i].last_used && (!lru || g_slots[i].last_used < lru->last_used)) {
+            lru = &g_slots[i];
+        }
+    }
+    return lru;
+}
+
+// Ids evicted by one clip_cache_begin(), reported once the mutex is released
+typedef struct {
+    char ids[CLIP_CACHE_SLOTS][CLIP_ID_LEN + 1];
+    int count;
+} evicted_t;
+
+static void evict(clip_slot_t *slot, evicted_t *evicted) {
+    char *id = evicted->ids[evicted->count++];
+    strlcpy(id, slot->id, CLIP_ID_LEN + 1);
+    release(slot);
+    ESP_LOGI(TAG, "Evicted %s (%u bytes cached)", id, (unsigned)g_total_bytes);
+}
+
+// The callback sends on the websocket and can block for WS_SEND_TIMEOUT_MS -
+// never call it with clip_mutex held, or lookups from other tasks stall too
+static void report_evicted(const evicted_t *evicted) {
+    for (int i = 0; g_on_evict && i < evicted->count; i++) {
+        g_on_evict(evicted->ids[i]);
+    }
+}
+
+esp_err_t clip_cache_init(clip_evict_cb_t on_evict) {
+    clip_mutex = xSemaphoreCreateMutex();
+    if (clip_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create clip mutex");
+        return ESP_FAIL;
+    }
+    g_on_evict = on_evict;
+    ESP_LOGI(TAG, "Clip cache: %d slots, %dKB", CLIP_CACHE_SLOTS, CLIP_CACHE_BYTES / 1024);
+    return ESP_OK;
+}
+
+esp_err_t clip_cache_begin(const char *id, size_t size) {
+    if (size == 0 || size > CLIP_MAX_BYTES) {
+        ESP_LOGW(TAG, "Rejected clip %s (%u bytes)", id, (unsigned)size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    evicted_t evicted = { .count = 0 };
+    
+    xSemaphoreTake(clip_mutex, portMAX_DELAY);
+    
+    // Abandon an unfinished upload
+    if (g_receiving) {
+        release(g_receiving);
+    }
+    
+    clip_slot_t *slot = find(id);
+    if (slot) {
+        release(slot);
+    }
+    
+    // Make room - by byte budget, then by slot count
+    while (g_total_bytes + size > CLIP_CACHE_BYTES && lru_slot()) {
+        evict(lru_slot(), &evicted);
+    }
+    slot = free_slot();
+    if (!slot) {
+        slot = lru_slot();
+        evict(slot, &evicted);
+    }
+    
+    slot->data = heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    if (!slot->data) {
+        xSemaphoreGive(clip_mutex);
+        report_evicted(&evicted);
+        ESP_LOGE(TAG, "Clip alloc failed (%u bytes)", (unsigned)size);
+        return ESP_ERR_NO_MEM;
+    }
+    strlcpy(slot->id, id, sizeof(slot->id));
+    slot->size = size;
+    slot->received = 0;
+    slot->last_used = ++g_tick;
+    g_total_bytes += size;
+    g_receiving = slot;
+    
+    xSemaphoreGive(clip_mutex);
+    report_evicted(&evicted);
+    return ESP_OK;
+}
+
+bool clip_cache_receiving(const char *id) {
+    bool receiving;
+    
+    xSemaphoreTake(clip_mutex, portMAX_DELAY);
+    receiving = g_receiving && strncmp(g_receiving->id, id, CLIP_ID_LEN) == 0;
+    xSemaphoreGive(clip_mutex);
+    
+    return receiving;
+}
+
+bool clip_cache_abort(void) {
+    char id[CLIP_ID_LEN + 1] = {0};
+    size_t received = 0;
+    
+    xSemaphoreTake(clip_mutex, portMAX_DELAY);
+    clip_slot_t *slot = g_receiving;
+    if (slot) {
+        strlcpy(id, slot->id, sizeof(id));
+        received = slot->received;
+        release(slot);
+    }
+    xSemaphoreGive(clip_mutex);
+    
+    if (slot) {
+        ESP_LOGW(TAG, "Abandoned %s after %u bytes", id, (unsigned)received);
+    }
+    return slot != NULL;
+}
+
+bool clip_cache_append(const uint8_t *data, size_t len) {
+    bool complete = false;
+    
+    xSemaphoreTake(clip_mutex, portMAX_DELAY);
+    clip_slot_t *slot = g_receiving;
+    if (slot) {
+        size_t room = slot->size - slot->received;
+        if (len > room) {
+            ESP_LOGW(TAG, "Clip %s overrun by %u bytes", slot->id, (unsigned)(len - room));
+            len = room;
+        }
+        memcpy(slot->data + slot->received, data, len);
+        slot->received += len;
+        
+        if (slot->received == slot->size) {
+            ESP_LOGI(TAG, "Stored %s (%u bytes, %u cached)",
+                     slot->id, (unsigned)slot->size, (unsigned)g_total_bytes);
+            g_receiving = NULL;
+            complete = true;
+        }
+    }
+    xSemaphoreGive(clip_mutex);
+    
+    return complete;
+}
+
+const uint8_t *clip_cache_get(const char *id, size_t *size) {
+    const uint8_t *data = NULL;
+    
+    xSemaphoreTake(clip_mutex, portMAX_DELAY);
+    clip_slot_t *slot = find(id);
+    if (slot && slot != g_receiving) {
+        slot->last_used = ++g_tick;
+        *size = slot->size;
+        data = slot->data;
+    }
+    xSemaphoreGive(clip_mutex);
+    
+    return data;
+}
+
+esp_err_t clip_cache_drop(const char *id) {
+    xSemaphoreTake(clip_mutex, portMAX_DELAY);
+    clip_slot_t *slot = find(id);
+    if (slot) {
+        release(slot);
+    }
+    xSemaphoreGive(clip_mutex);
+    
+    return slot ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+int clip_cache_list(char *buf, size_t len) {
+    int count = 0;
+    size_t pos = 0;
+    buf[0] = '\0';
+    
+    xSemaphoreTake(clip_mutex, portMAX_DELAY);
+    for (int i = 0; i < CLIP_CACHE_SLOTS; i++) {
+        clip_slot_t *slot = &g_slots[i];
+        if (!slot->last_used || slot == g_receiving) continue;
+        
+        int n = snprintf(buf + pos, len - pos, "%s%s", count ? " " : "", slot->id);
+        if (n < 0 || pos + n >= len) break;
+        pos += n;
+        count++;
+    }
+    xSemaphoreGive(clip_mutex);
+    
+    return count;
+}
@@ -0,0 +1,92 @@
+#ifndef _CLIP_CACHE_H_
+#define _CLIP_CACHE_H_
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Called with the id of every clip dropped to make room for a new one,
+ * so the server can keep its residency view in sync. Runs in the
+ * clip_cache_begin() caller after the cache lock is released, so it may block.
+ */
+typedef void (*clip_evict_cb_t)(const char *id);
+
+/**
+ * @brief Initialize the clip cache
+ * 
+ * @param on_evict Eviction callback (may be NULL)
+ * @return ESP_OK on success
+ */
+esp_err_t clip_cache_init(clip_evict_cb_t on_evict);
+
+/**
+ * @brief Start receiving a clip - following binary frames go to clip_cache_append()
+ * 
+ * Evicts least recently played clips until the new one fits. An existing
+ * clip with the same id is replaced.
+ * 
+ * @param id Clip id (up to CLIP_ID_LEN chars)
+ * @param size Total clip size in bytes
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if larger than CLIP_MAX_BYTES
+ */
+esp_err_t clip_cache_begin(const char *id, size_t size);
+
+/**
+ * @brief Check whether a clip upload is in progress
+ * 
+ * @param id Clip id the caller expects the data to belong to
+ * @return true between clip_cache_begin(id) and the last clip_cache_append()
+ */
+bool clip_cache_receiving(const char *id);
+
+/**
+ * @brief Abandon the clip upload in progress, if any
+ * 
+ * The partial clip is freed and never becomes playable. Call when the
+ * upload can no longer complete (disconnect, another command in between).
+ * 
+ * @return true if an upload was abandoned
+ */
+bool clip_cache_abort(void);
+
+/**
+ * @brief Append data to the clip being received
+ * 
+ * @param data Clip bytes
+ * @param len Number of bytes
+ * @return true once the clip is complete and playable
+ */
+bool clip_cache_append(const uint8_t *data, size_t len);
+
+/**
+ * @brief Look up a clip and mark it most recently used
+ * 
+ * The returned buffer stays valid until the next clip_cache_begin() or
+ * clip_cache_drop() - call all of these from the same task.
+ * 
+ * @param id Clip id
+ * @param size Filled with the clip size
+ * @return Clip data, or NULL on miss
+ */
+const uint8_t *clip_cache_get(const char *id, size_t *size);
+
+/**
+ * @brief Drop a clip
+ * 
+ * @param id Clip id
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if not cached
+ */
+esp_err_t clip_cache_drop(const char *id);
+
+/**
+ * @brief Write the ids of all cached clips, space-separated
+ * 
+ * @param buf Output buffer
+ * @param len Buffer size
+ * @return Number of clips listed
+ */
+int clip_cache_list(char *buf, size_t len);
+
+#endif // _CLIP_CACHE_H_
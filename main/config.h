@@ -25,6 +25,22 @@
 #define WS_SEND_TIMEOUT_MS      5000           // Reduced - fail faster
 #define WS_CONNECT_TIMEOUT_MS   8000
 
+// Device identity sent to the server at connect (?device_id=...&group=...)
+// Device id = DEVICE_ID_PREFIX + last 3 bytes of the WiFi STA MAC
+#define DEVICE_ID_PREFIX        "lyrat-"
+#define DEVICE_GROUP            "living_room"  // Comma-separated broadcast groups
+
+// ============================================================================
+// MQTT Configuration - local commands publish straight to mqtt_device
+// ============================================================================
+#define MQTT_BROKER_URI         "mqtt://laihieu2714.ddns.net"
+// Single-device commands go to one board's node topic. A board is node-<mac>
+// until renamed: type "node living_room_1" on its serial console (accepted at
+// any time) and restart it. The group topic home/group/<group>/control
+// reaches every board in the room: scenes only.
+#define MQTT_CONTROL_NODE       "living_room_1"
+#define MQTT_CONTROL_TOPIC      "home/" MQTT_CONTROL_NODE "/control"
+
 // ============================================================================
 // Audio I2S Configuration
 // ============================================================================
@@ -46,6 +62,14 @@
 #define AUDIO_CHUNK_SIZE        2048           // Smaller chunks = lower latency, more CPU
 #define AUDIO_WRITE_TIMEOUT_MS  1500
 
+// Response clip cache - short MP3 clips pushed by the server (CLIP_STORE)
+// and replayed locally on CLIP_PLAY. Kept encoded: PCM @ 48kHz would cost
+// ~96KB per second of audio, MP3 ~16KB.
+#define CLIP_CACHE_SLOTS        12
+#define CLIP_CACHE_BYTES        (256 * 1024)   // Total PSRAM budget, LRU eviction beyond this
+#define CLIP_MAX_BYTES          (48 * 1024)    // Largest single clip accepted
+#define CLIP_ID_LEN             16             // Hex chars, assigned by the server
+
 // ============================================================================
 // AFE (Audio Front-End) Configuration - LITE for ESP32
 // ESP32 is slower than S3, so we disable heavy features
@@ -98,7 +122,13 @@
 // ============================================================================
 // Streaming Optimization - NEW
 // ============================================================================
-#define STREAM_BATCH_SIZE       3              // Send 3 chunks at once to reduce WS overhead
+// Uplink batch size adapts per send: starts small for a fast first byte,
+// grows when a send takes a large share of the audio it carries
+#define STREAM_BATCH_MIN        1              // Chunks per WS frame - lower bound
+#define STREAM_BATCH_MAX        6              // Upper bound (buffer is sized for this)
+#define STREAM_CONGESTED_PCT    50             // Send time > 50% of batch audio → grow
+#define STREAM_FAST_PCT         10             // Send time < 10% of batch audio ...
+#define STREAM_FAST_STREAK      4              // ... this many sends in a row → shrink
 #define STREAM_YIELD_MS         5              // Yield time between batches
 #define STREAM_MAX_DURATION_MS  15000          // Max recording duration
 
@@ -118,6 +148,22 @@
 #define FEATURE_AUDIO_ENCODING  0              // 0 = PCM (OPUS needs ESP32-S3)
 #define FEATURE_ON_DEVICE_VAD   1              // NEW: Use on-device VAD
 #define FEATURE_SMART_SILENCE   1              // NEW: Stop early on silence
+// MultiNet device commands after the wake word (see local_cmd.c). On the
+// LyraT-Mini's ESP32 this is MN2 Chinese with a pinyin grammar (commands
+// spoken in Mandarin); ESP32-S3 builds use an English MN5+ grammar. Select
+// the model in sdkconfig.defaults before turning this on.
+// Shares the "model" partition and core 1 with WakeNet; local_cmd_init()
+// refuses to start below LOCAL_CMD_MIN_FREE_* after WakeNet is loaded, and
+// the core 1 load is logged per wake session next to the WakeNet-only figure.
+#define FEATURE_LOCAL_COMMANDS  0
+#define LOCAL_CMD_MIN_FREE_INTERNAL (40 * 1024) // Left for WiFi/WS/MQTT after MultiNet
+#define LOCAL_CMD_MIN_FREE_PSRAM    (512 * 1024) // Left for the playback buffers
+#define FEATURE_FOLLOWUP        1              // Listen again after a reply, no wake word
+
+// Follow-up window - opened once reply playback has drained
+#define FOLLOWUP_WINDOW_MS      6000           // Closes if no speech starts within this
+#define FOLLOWUP_TAIL_MS        300            // Decoder + I2S tail after the ring buffer empties
+#define FOLLOWUP_DRAIN_MAX_MS   30000          // Give up waiting for playback to drain
 
 // ============================================================================
 // Debug Flags
@@ -0,0 +1,136 @@
+#include "local_cmd.h"
+#include "config.h"
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "mqtt_client.h"
+#include "esp_mn_speech_commands.h"
+#include <stdio.h>
+
+static const char *TAG = "LOCAL_CMD";
+
+// esp-sr has text-phrase English MultiNet (MN5+) for the ESP32-S3 only. The
+// LyraT-Mini's ESP32 runs MN2 Chinese, whose grammar is space-separated
+// pinyin - the commands are then spoken in Mandarin.
+#if CONFIG_IDF_TARGET_ESP32S3
+#define PHRASE(en, pinyin)  en
+#else
+#define PHRASE(en, pinyin)  pinyin
+#endif
+
+typedef struct {
+    const char *phrase;     // MultiNet grammar for this target
+    const char *name;
+    const char *device;     // mqtt_device name, NULL = handled on the LyraT
+    int value;
+} local_cmd_t;
+
+// Indexed by local_cmd_id_t
+static const local_cmd_t g_commands[LOCAL_CMD_COUNT] = {
+    [LOCAL_CMD_STOP]        = {PHRASE("stop", "ting zhi"),                                 "stop",       NULL,     0},
+    [LOCAL_CMD_LIGHT1_ON]   = {PHRASE("turn on light one", "da kai yi hao deng"),          "light1_on",  "light1", 1},
+    [LOCAL_CMD_LIGHT1_OFF]  = {PHRASE("turn off light one", "guan bi yi hao deng"),        "light1_off", "light1", 0},
+    [LOCAL_CMD_LIGHT2_ON]   = {PHRASE("turn on light two", "da kai er hao deng"),          "light2_on",  "light2", 1},
+    [LOCAL_CMD_LIGHT2_OFF]  = {PHRASE("turn off light two", "guan bi er hao deng"),        "light2_off", "light2", 0},
+    [LOCAL_CMD_LIGHT3_ON]   = {PHRASE("turn on light three", "da kai san hao deng"),       "light3_on",  "light3", 1},
+    [LOCAL_CMD_LIGHT3_OFF]  = {PHRASE("turn off light three", "guan bi san hao deng"),     "light3_off", "light3", 0},
+    [LOCAL_CMD_FAN1_ON]     = {PHRASE("turn on fan one", "da kai yi hao feng shan"),       "fan1_on",    "fan1",   1},
+    [LOCAL_CMD_FAN1_OFF]    = {PHRASE("turn off fan one", "guan bi yi hao feng shan"),     "fan1_off",   "fan1",   0},
+    [LOCAL_CMD_FAN2_ON]     = {PHRASE("turn on fan two", "da kai er hao feng shan"),       "fan2_on",    "fan2",   1},
+    [LOCAL_CMD_FAN2_OFF]    = {PHRASE("turn off fan two", "guan bi er hao feng shan"),     "fan2_off",   "fan2",   0},
+    [LOCAL_CMD_DOOR_OPEN]   = {PHRASE("open the door", "da kai da men"),                   "door_open",  "servo",  180},
+    [LOCAL_CMD_DOOR_CLOSE]  = {PHRASE("close the door", "guan bi da men"),                 "door_close", "servo",  120},
+};
+
+static esp_mqtt_client_handle_t g_mqtt = NULL;
+static volatile bool g_mqtt_connected = false;
+
+static void mqtt_event_handler(void *arg, esp_event_base_t base, int32_t event_id, void *event_data) {
+    switch ((esp_mqtt_event_id_t)event_id) {
+    case MQTT_EVENT_CONNECTED:
+        ESP_LOGI(TAG, "MQTT connected");
+        g_mqtt_connected = true;
+        break;
+    case MQTT_EVENT_DISCONNECTED:
+        ESP_LOGW(TAG, "MQTT disconnected");
+        g_mqtt_connected = false;
+        break;
+    default:
+        break;
+    }
+}
+
+esp_err_t local_cmd_init(void) {
+    // MultiNet is already loaded next to WakeNet - check what it left
+    size_t free_internal = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t free_psram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    if (free_internal < LOCAL_CMD_MIN_FREE_INTERNAL || free_psram < LOCAL_CMD_MIN_FREE_PSRAM) {
+        ESP_LOGE(TAG, "Over budget after MultiNet (internal %u < %u or PSRAM %u < %u), local commands off",
+                 (unsigned)free_internal, (unsigned)LOCAL_CMD_MIN_FREE_INTERNAL,
+                 (unsigned)free_psram, (unsigned)LOCAL_CMD_MIN_FREE_PSRAM);
+        return ESP_ERR_NO_MEM;
+    }
+    
+    // Command grammar
+    esp_mn_commands_clear();
+    for (int i = 0; i < LOCAL_CMD_COUNT; i++) {
+        esp_mn_commands_add(i, (char *)g_commands[i].phrase);
+    }
+    esp_mn_error_t *errors = esp_mn_commands_update();
+    if (errors) {
+        for (int i = 0; i < errors->num; i++) {
+            ESP_LOGW(TAG, "Rejected phrase: %s", errors->phrases[i]->string);
+        }
+    }
+    
+    // MQTT - same broker and topic mqtt_device subscribes to
+    esp_mqtt_client_config_t mqtt_cfg = {
+        .broker.address.uri = MQTT_BROKER_URI,
+    };
+    g_mqtt = esp_mqtt_client_init(&mqtt_cfg);
+    if (!g_mqtt) {
+        ESP_LOGE(TAG, "MQTT init failed");
+        return ESP_FAIL;
+    }
+    esp_mqtt_client_register_event(g_mqtt, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
+    esp_err_t err = esp_mqtt_client_start(g_mqtt);
+    
+    ESP_LOGI(TAG, "%d local commands registered (internal %u, PSRAM %u free)",
+             LOCAL_CMD_COUNT, (unsigned)free_internal, (unsigned)free_psram);
+    return err;
+}
+
+const char *local_cmd_name(int id) {
+    if (id < 0 || id >= LOCAL_CMD_COUNT) return NULL;
+    return g_commands[id].name;
+}
+
+esp_err_t local_cmd_execute(int id) {
+    if (id < 0 || id >= LOCAL_CMD_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    const local_cmd_t *cmd = &g_commands[id];
+    if (!cmd->device) {
+        return ESP_OK;
+    }
+    if (!g_mqtt_connected) {
+        ESP_LOGW(TAG, "MQTT not connected, dropping %s", cmd->name);
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    char payload[64];
+    int len = snprintf(payload, sizeof(payload), "{\"device\":\"%s\",\"value\":%d}", cmd->device, cmd->value);
+    
+    // Queue instead of publish - never block the recorder task on the network
+    int64_t start = esp_timer_get_time();
+    int msg_id = esp_mqtt_client_enqueue(g_mqtt, MQTT_CONTROL_TOPIC, payload, len, 1, 0, true);
+    if (msg_id < 0) {
+        ESP_LOGE(TAG, "Enqueue failed for %s", cmd->name);
+        return ESP_FAIL;
+    }
+    
+    ESP_LOGI(TAG, "📡 %s → %s (%lld us)", cmd->name, payload, esp_timer_get_time() - start);
+    return ESP_OK;
+}
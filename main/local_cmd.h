@@ -0,0 +1,54 @@
+#ifndef _LOCAL_CMD_H_
+#define _LOCAL_CMD_H_
+
+#include "esp_err.h"
+#include <stdbool.h>
+
+// Command ids as reported by MultiNet (AUDIO_REC_COMMAND_DECT + id)
+typedef enum {
+    LOCAL_CMD_STOP = 0,
+    LOCAL_CMD_LIGHT1_ON,
+    LOCAL_CMD_LIGHT1_OFF,
+    LOCAL_CMD_LIGHT2_ON,
+    LOCAL_CMD_LIGHT2_OFF,
+    LOCAL_CMD_LIGHT3_ON,
+    LOCAL_CMD_LIGHT3_OFF,
+    LOCAL_CMD_FAN1_ON,
+    LOCAL_CMD_FAN1_OFF,
+    LOCAL_CMD_FAN2_ON,
+    LOCAL_CMD_FAN2_OFF,
+    LOCAL_CMD_DOOR_OPEN,
+    LOCAL_CMD_DOOR_CLOSE,
+    LOCAL_CMD_COUNT
+} local_cmd_id_t;
+
+/**
+ * @brief Register the command grammar with MultiNet and start the MQTT client
+ * 
+ * Call after the recorder (and so MultiNet) has been created.
+ * 
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if free internal RAM or PSRAM
+ *         is below LOCAL_CMD_MIN_FREE_* - leave local commands off then
+ */
+esp_err_t local_cmd_init(void);
+
+/**
+ * @brief Get the short name of a command (used in logs and LOCAL_CMD frames)
+ * 
+ * @param id Command id
+ * @return Name, or NULL for an unknown id
+ */
+const char *local_cmd_name(int id);
+
+/**
+ * @brief Publish a device command to MQTT_CONTROL_TOPIC
+ * 
+ * Non-blocking - the message is queued in the MQTT client. LOCAL_CMD_STOP
+ * publishes nothing; playback is stopped by the caller.
+ * 
+ * @param id Command id
+ * @return ESP_OK if queued, ESP_ERR_INVALID_STATE if MQTT is not connected
+ */
+esp_err_t local_cmd_execute(int id);
+
+#endif // _LOCAL_CMD_H_
@@ -10,12 +10,14 @@
  * - Smart silence detection with timeout
  */
 
+#include <stdio.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "esp_log.h"
 #include "esp_wifi.h"
+#include "esp_mac.h"
 #include "nvs_flash.h"
 #include "audio_element.h"
 #include "audio_pipeline.h"
@@ -32,8 +34,14 @@
 #include "mp3_decoder.h"
 #include "filter_resample.h"
 #include "esp_timer.h"
+#include "esp_system.h"
 #include "config.h"
 #include "settings.h"
+#include "clip_cache.h"
+#include "tuning.h"
+#if FEATURE_LOCAL_COMMANDS
+#include "local_cmd.h"
+#endif
 #include "audio_recorder.h"
 #include "recorder_sr.h"
 
@@ -90,13 +98,56 @@ static esp_websocket_client_handle_t g_ws = NULL;
 static audio_board_handle_t g_board = NULL;
 static audio_rec_handle_t g_recorder = NULL;
 
+static char g_device_id[32] = {0};
+
 static volatile bool g_flush = false;
 static volatile bool g_playback_started = false;
 
+// Command recognized on-device during this turn (-1 = none, go to cloud)
+static volatile int g_local_cmd = -1;
+
+// Turn opened by the follow-up window instead of the wake word
+static volatile bool g_turn_followup = false;
+static volatile bool g_followup_pending = false;
+static int64_t g_turn_trigger_time = 0;     // Wake word / follow-up window open
+static int64_t g_end_sent_time = 0;         // END sent, 0 = response already timed
+
 // Streaming stats
 static volatile int64_t g_stream_start_time = 0;
 static volatile int g_total_bytes_sent = 0;
 
+// Adaptive uplink batching - per-turn counters, batch carries over between turns
+typedef struct {
+    int batch;              // Chunks per WS frame right now
+    int ups;
+    int downs;
+    int sends;
+    int fails;              // Short or timed-out sends
+    int fast_streak;
+    int64_t send_total_us;
+    int64_t send_max_us;
+} uplink_stats_t;
+
+static uplink_stats_t g_uplink = {.batch = STREAM_BATCH_MIN};
+
+// Time-to-audio: playback command → first MP3 bytes in the decoder
+typedef struct {
+    int64_t total_ms;
+    int count;
+} tta_stats_t;
+
+static tta_stats_t g_tta_stream = {0};
+static tta_stats_t g_tta_clip = {0};
+
+// Per-turn latency: END → response start, by how the turn was opened
+static tta_stats_t g_latency_wake = {0};
+static tta_stats_t g_latency_followup = {0};
+static int64_t g_audio_cmd_time = 0;    // 0 = first bytes already counted
+
+// Clip upload in progress (CLIP_STORE)
+static char g_clip_rx_id[CLIP_ID_LEN + 1] = {0};
+static bool g_reply_streaming = false;  // Between AUDIO_START and AUDIO_END
+
 // ============================================================================
 // Memory Debug Helper
 // ============================================================================
@@ -111,6 +162,34 @@ static void log_memory(const char *label) {
 #define log_memory(x)
 #endif
 
+// ============================================================================
+// Core 1 Load - the recorder (AFE + WakeNet, + MultiNet in a wake session)
+// is alone on RECORDER_TASK_CORE, so its idle time gives the budget left
+// ============================================================================
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+typedef struct {
+    configRUN_TIME_COUNTER_TYPE idle;   // us (esp_timer run-time clock)
+    int64_t wall_us;
+} core_mark_t;
+
+static core_mark_t g_session_mark;
+static volatile uint32_t g_wake_count = 0;
+
+static void core_mark(core_mark_t *mark) {
+    mark->idle = ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(RECORDER_TASK_CORE));
+    mark->wall_us = esp_timer_get_time();
+}
+
+static int core_busy_pct(const core_mark_t *since) {
+    core_mark_t now;
+    core_mark(&now);
+    int64_t wall = now.wall_us - since->wall_us;
+    if (wall <= 0) return 0;
+    int64_t idle = (configRUN_TIME_COUNTER_TYPE)(now.idle - since->idle);
+    return (int)(100 - idle * 100 / wall);
+}
+#endif
+
 // ============================================================================
 // On-Device VAD Helper - Lightweight RMS-based
 // ============================================================================
@@ -145,7 +224,7 @@ static inline int16_t calculate_rms(const int16_t *samples, int count) {
 // Playback Pipeline (MP3 from server) - Optimized buffer sizes
 // ============================================================================
 static void init_playback(void) {
-    ESP_LOGI(TAG, "Init playback (buf: %dKB)", RAW_WRITE_BUFFER_SIZE / 1024);
+    ESP_LOGI(TAG, "Init playback (buf: %dKB)", tuning_get_int(TUNE_RAW_WRITE_BUFFER_SIZE) / 1024);
     
     audio_pipeline_cfg_t cfg = DEFAULT_AUDIO_PIPELINE_CONFIG();
     g_play_pipe = audio_pipeline_init(&cfg);
@@ -153,7 +232,7 @@ static void init_playback(void) {
     // Raw input - reduced buffer
     raw_stream_cfg_t raw_cfg = RAW_STREAM_CFG_DEFAULT();
     raw_cfg.type = AUDIO_STREAM_READER;
-    raw_cfg.out_rb_size = RAW_WRITE_BUFFER_SIZE;
+    raw_cfg.out_rb_size = tuning_get_int(TUNE_RAW_WRITE_BUFFER_SIZE);
     g_raw_writer = raw_stream_init(&raw_cfg);
     
     // MP3 decoder - pin to core 0 with playback
@@ -173,7 +252,7 @@ static void init_playback(void) {
     // I2S output - optimized settings
     i2s_stream_cfg_t i2s_cfg = I2S_STREAM_CFG_DEFAULT();
     i2s_cfg.type = AUDIO_STREAM_WRITER;
-    i2s_cfg.out_rb_size = I2S_WRITE_BUFFER_SIZE;
+    i2s_cfg.out_rb_size = tuning_get_int(TUNE_I2S_WRITE_BUFFER_SIZE);
     i2s_cfg.task_prio = 23;  // Highest priority for smooth playback
     i2s_cfg.task_core = PLAYBACK_TASK_CORE;
     i2s_cfg.chan_cfg.id = I2S_NUM_PLAY;
@@ -197,7 +276,7 @@ static void init_playback(void) {
 // Recording Pipeline - Optimized for on-device VAD
 // ============================================================================
 static void init_recording(void) {
-    ESP_LOGI(TAG, "Init recording (buf: %dKB)", RAW_READ_BUFFER_SIZE / 1024);
+    ESP_LOGI(TAG, "Init recording (buf: %dKB)", tuning_get_int(TUNE_RAW_READ_BUFFER_SIZE) / 1024);
     
     audio_pipeline_cfg_t cfg = DEFAULT_AUDIO_PIPELINE_CONFIG();
     g_rec_pipe = audio_pipeline_init(&cfg);
@@ -214,7 +293,7 @@ static void init_recording(void) {
     
     raw_stream_cfg_t raw_cfg = RAW_STREAM_CFG_DEFAULT();
     raw_cfg.type = AUDIO_STREAM_READER;
-    raw_cfg.out_rb_size = RAW_READ_BUFFER_SIZE;
+    raw_cfg.out_rb_size = tuning_get_int(TUNE_RAW_READ_BUFFER_SIZE);
     g_raw_reader = raw_stream_init(&raw_cfg);
     
     audio_pipeline_register(g_rec_pipe, i2s, "i2s");
@@ -306,6 +385,180 @@ static void play_ding(void) {
     ESP_LOGI(TAG, "Ding complete");
 }
 
+// ============================================================================
+// Playback Control
+// ============================================================================
+static void start_playback(void) {
+    g_flush = false;
+    set_state(STATE_PLAYING);
+    
+    // Reset and start playback fresh
+    if (g_playback_started) {
+        audio_pipeline_stop(g_play_pipe);
+        audio_pipeline_wait_for_stop(g_play_pipe);
+        audio_pipeline_reset_ringbuffer(g_play_pipe);
+        audio_pipeline_reset_elements(g_play_pipe);
+    }
+    audio_pipeline_run(g_play_pipe);
+    g_playback_started = true;
+}
+
+static void record_tta(tta_stats_t *stats, const char *label) {
+    int64_t ms = (esp_timer_get_time() - g_audio_cmd_time) / 1000;
+    g_audio_cmd_time = 0;
+    stats->total_ms += ms;
+    stats->count++;
+    ESP_LOGI(TAG, "⏱️ Time-to-audio (%s): %lld ms (avg %lld ms over %d)",
+             label, ms, stats->total_ms / stats->count, stats->count);
+}
+
+static void record_turn_latency(void) {
+    if (!g_end_sent_time) return;
+    
+    tta_stats_t *stats = g_turn_followup ? &g_latency_followup : &g_latency_wake;
+    int64_t ms = (esp_timer_get_time() - g_end_sent_time) / 1000;
+    g_end_sent_time = 0;
+    stats->total_ms += ms;
+    stats->count++;
+    ESP_LOGI(TAG, "⏱️ Turn (%s): END → reply %lld ms (avg %lld ms over %d)",
+             g_turn_followup ? "follow-up" : "wake", ms, stats->total_ms / stats->count, stats->count);
+}
+
+#if FEATURE_FOLLOWUP
+static void open_followup_window(void);
+#endif
+
+// Reply fully queued for playback (AUDIO_END, or the last byte of a cached
+// clip) - the follow-up window opens once the ring buffer drains
+static void finish_reply(void) {
+    set_state(STATE_IDLE);
+#if FEATURE_FOLLOWUP
+    open_followup_window();
+#endif
+}
+
+// ============================================================================
+// Response Clip Cache - server-pushed clips played without streaming
+// ============================================================================
+static void send_clip_msg(const char *cmd, const char *id) {
+    char msg[24 + CLIP_ID_LEN];
+    int len = snprintf(msg, sizeof(msg), "%s %s", cmd, id);
+    esp_websocket_client_send_text(g_ws, msg, len, pdMS_TO_TICKS(1000));
+}
+
+static void on_clip_evicted(const char *id) {
+    if (esp_websocket_client_is_connected(g_ws)) {
+        send_clip_msg("CLIP_EVICTED", id);
+    }
+}
+
+// Tell the server which clips survived the reconnect
+static void send_clip_list(void) {
+    char msg[16 + CLIP_CACHE_SLOTS * (CLIP_ID_LEN + 1)];
+    int len = snprintf(msg, sizeof(msg), "CLIP_HAVE");
+    if (clip_cache_list(msg + len + 1, sizeof(msg) - len - 1) > 0) {
+        msg[len] = ' ';
+        len = strlen(msg);
+    }
+    esp_websocket_client_send_text(g_ws, msg, len, pdMS_TO_TICKS(1000));
+}
+
+static void play_clip(const char *id) {
+    size_t size = 0;
+    const uint8_t *clip = clip_cache_get(id, &size);
+    if (!clip) {
+        ESP_LOGW(TAG, "📼 Clip miss: %s", id);
+        g_audio_cmd_time = 0;
+        send_clip_msg("CLIP_MISS", id);
+        return;
+    }
+    
+    ESP_LOGI(TAG, "📼 Clip %s (%u bytes)", id, (unsigned)size);
+    start_playback();
+    
+    // start_playback() empties the raw ring buffer and raw_write_buf is never
+    // below CLIP_MAX_BYTES (tuning_defs.h), so the whole clip fits - this
+    // does not block the WS task
+    for (size_t off = 0; off < size && !g_flush; off += AUDIO_CHUNK_SIZE) {
+        size_t n = (size - off < AUDIO_CHUNK_SIZE) ? size - off : AUDIO_CHUNK_SIZE;
+        raw_stream_write(g_raw_writer, (char *)clip + off, n);
+        if (off == 0) {
+            record_tta(&g_tta_clip, "clip");
+        }
+    }
+    finish_reply();
+}
+
+// Text frames are not NUL-terminated - copy the clip id argument out
+static bool clip_arg(const char *data, int len, int prefix_len, char *id) {
+    int n = len - prefix_len;
+    if (n <= 0 || n > CLIP_ID_LEN) return false;
+    memcpy(id, data + prefix_len, n);
+    id[n] = '\0';
+    return true;
+}
+
+// The binary frames of a CLIP_STORE follow it back to back - a text frame
+// or a disconnect in between means the upload was cut off
+static void abort_clip_store(void) {
+    if (!g_clip_rx_id[0]) return;
+    if (clip_cache_abort() && esp_websocket_client_is_connected(g_ws)) {
+        send_clip_msg("CLIP_REJECTED", g_clip_rx_id);
+    }
+    g_clip_rx_id[0] = '\0';
+}
+
+static void handle_clip_store(const char *data, int len) {
+    char args[48];
+    unsigned size = 0;
+    char id[CLIP_ID_LEN + 1];
+    
+    if (len >= (int)sizeof(args)) return;
+    memcpy(args, data, len);
+    args[len] = '\0';
+    if (sscanf(args, "CLIP_STORE %16s %u", id, &size) != 2) return;
+    
+    if (clip_cache_begin(id, size) == ESP_OK) {
+        strlcpy(g_clip_rx_id, id, sizeof(g_clip_rx_id));
+    } else {
+        send_clip_msg("CLIP_REJECTED", id);
+    }
+}
+
+// ============================================================================
+// Runtime Tuning - TUNE k=v ..., TUNE_RESET, REBOOT from the server
+// ============================================================================
+static void send_tuning(void) {
+    char msg[512];
+    int len = snprintf(msg, sizeof(msg), "TUNING ");
+    len += tuning_dump(msg + len, sizeof(msg) - len);
+    esp_websocket_client_send_text(g_ws, msg, len, pdMS_TO_TICKS(1000));
+}
+
+static void handle_tune(const char *data, int len) {
+    char args[256];
+    if (len >= (int)sizeof(args)) {
+        ESP_LOGW(TAG, "TUNE command too long (%d)", len);
+        return;
+    }
+    memcpy(args, data, len);
+    args[len] = '\0';
+    
+    char *save = NULL;
+    strtok_r(args, " ", &save);  // "TUNE"
+    for (char *pair = strtok_r(NULL, " ", &save); pair; pair = strtok_r(NULL, " ", &save)) {
+        char *eq = strchr(pair, '=');
+        if (!eq) continue;
+        *eq = '\0';
+        if (tuning_set(pair, eq + 1) != ESP_OK) {
+            char err[48];
+            int n = snprintf(err, sizeof(err), "TUNE_ERR %s", pair);
+            esp_websocket_client_send_text(g_ws, err, n, pdMS_TO_TICKS(1000));
+        }
+    }
+    send_tuning();
+}
+
 // ============================================================================
 // WebSocket Handler - Optimized
 // ============================================================================
@@ -317,12 +570,16 @@ static void ws_handler(void *arg, esp_event_base_t base, int32_t id, void *data)
         ESP_LOGI(TAG, "🌐 Connected");
         // DON'T run pipeline yet - wait for audio
         g_playback_started = false;
+        send_clip_list();
+        send_tuning();
         break;
         
     case WEBSOCKET_EVENT_DISCONNECTED:
         ESP_LOGW(TAG, "❌ Disconnected");
         set_state(STATE_IDLE);
         g_playback_started = false;
+        g_reply_streaming = false;
+        abort_clip_store();
         
         // Auto reconnect after delay
         vTaskDelay(pdMS_TO_TICKS(WS_RETRY_DELAY_MS));
@@ -337,24 +594,51 @@ static void ws_handler(void *arg, esp_event_base_t base, int32_t id, void *data)
         
         // Text commands
         if (ws->op_code == 0x01) {
+            // Includes AUDIO_START, CLIP_PLAY and a new CLIP_STORE - none of
+            // them may land in a half-received clip
+            abort_clip_store();
+            
             if (ws->data_len == 9 && memcmp(ws->data_ptr, "AUDIO_END", 9) == 0) {
                 ESP_LOGI(TAG, "✅ Audio complete");
-                set_state(STATE_IDLE);
+                g_reply_streaming = false;
+                finish_reply();
             }
             else if (ws->data_len == 11 && memcmp(ws->data_ptr, "AUDIO_START", 11) == 0) {
                 ESP_LOGI(TAG, "🎵 Audio starting");
-                g_flush = false;
-                set_state(STATE_PLAYING);
-                
-                // Reset and start playback fresh
-                if (g_playback_started) {
-                    audio_pipeline_stop(g_play_pipe);
-                    audio_pipeline_wait_for_stop(g_play_pipe);
-                    audio_pipeline_reset_ringbuffer(g_play_pipe);
-                    audio_pipeline_reset_elements(g_play_pipe);
+                g_reply_streaming = true;
+                g_audio_cmd_time = esp_timer_get_time();
+                record_turn_latency();
+                start_playback();
+            }
+            else if (ws->data_len > 10 && memcmp(ws->data_ptr, "CLIP_PLAY ", 10) == 0) {
+                char id[CLIP_ID_LEN + 1];
+                if (clip_arg(ws->data_ptr, ws->data_len, 10, id)) {
+                    g_audio_cmd_time = esp_timer_get_time();
+                    record_turn_latency();
+                    play_clip(id);
+                }
+            }
+            else if (ws->data_len > 11 && memcmp(ws->data_ptr, "CLIP_STORE ", 11) == 0) {
+                handle_clip_store(ws->data_ptr, ws->data_len);
+            }
+            else if (ws->data_len >= 4 && memcmp(ws->data_ptr, "TUNE", 4) == 0 &&
+                     (ws->data_len == 4 || ws->data_ptr[4] == ' ')) {
+                handle_tune(ws->data_ptr, ws->data_len);
+            }
+            else if (ws->data_len == 10 && memcmp(ws->data_ptr, "TUNE_RESET", 10) == 0) {
+                tuning_reset();
+                send_tuning();
+            }
+            else if (ws->data_len == 6 && memcmp(ws->data_ptr, "REBOOT", 6) == 0) {
+                // Applies REBUILD parameters (buffer sizes, AFE gain, ping)
+                ESP_LOGW(TAG, "🔁 Reboot requested by server");
+                esp_restart();
+            }
+            else if (ws->data_len > 10 && memcmp(ws->data_ptr, "CLIP_DROP ", 10) == 0) {
+                char id[CLIP_ID_LEN + 1];
+                if (clip_arg(ws->data_ptr, ws->data_len, 10, id)) {
+                    clip_cache_drop(id);
                 }
-                audio_pipeline_run(g_play_pipe);
-                g_playback_started = true;
             }
             else if (ws->data_len == 14 && memcmp(ws->data_ptr, "STOP_RECORDING", 14) == 0) {
                 ESP_LOGI(TAG, "🛑 Server: stop");
@@ -363,13 +647,24 @@ static void ws_handler(void *arg, esp_event_base_t base, int32_t id, void *data)
                 }
             }
         }
-        // Binary audio data
-        else if (ws->op_code == 0x02 && !g_flush && g_raw_writer) {
+        // Binary clip data (between CLIP_STORE and the last byte)
+        else if (ws->op_code == 0x02 && g_clip_rx_id[0] && clip_cache_receiving(g_clip_rx_id)) {
+            if (clip_cache_append((const uint8_t *)ws->data_ptr, ws->data_len)) {
+                send_clip_msg("CLIP_STORED", g_clip_rx_id);
+                g_clip_rx_id[0] = '\0';
+            }
+        }
+        // Binary audio data - only between AUDIO_START and AUDIO_END, so the
+        // tail of an abandoned clip upload is dropped instead of played
+        else if (ws->op_code == 0x02 && g_reply_streaming && !g_flush && g_raw_writer) {
             if (!g_playback_started) {
                 audio_pipeline_run(g_play_pipe);
                 g_playback_started = true;
             }
             raw_stream_write(g_raw_writer, (char *)ws->data_ptr, ws->data_len);
+            if (g_audio_cmd_time) {
+                record_tta(&g_tta_stream, "stream");
+            }
         }
         break;
         
@@ -379,6 +674,64 @@ static void ws_handler(void *arg, esp_event_base_t base, int32_t id, void *data)
     }
 }
 
+// ============================================================================
+// Uplink - timed sends, batch size adapted to how long each send blocks
+// ============================================================================
+static void uplink_begin_turn(void) {
+    int batch_min = tuning_get_int(TUNE_STREAM_BATCH_MIN);
+    int batch = g_uplink.batch / 2;  // Decay toward a fast first byte
+    memset(&g_uplink, 0, sizeof(g_uplink));
+    g_uplink.batch = (batch < batch_min) ? batch_min : batch;
+}
+
+static void uplink_send(const uint8_t *buf, int len) {
+    int64_t start = esp_timer_get_time();
+    int sent = esp_websocket_client_send_bin(g_ws, (const char *)buf, len, pdMS_TO_TICKS(WS_SEND_TIMEOUT_MS));
+    int64_t send_us = esp_timer_get_time() - start;
+    
+    if (sent > 0) {
+        g_total_bytes_sent += sent;
+    }
+    g_uplink.sends++;
+    g_uplink.send_total_us += send_us;
+    if (send_us > g_uplink.send_max_us) {
+        g_uplink.send_max_us = send_us;
+    }
+    
+    // Compare the time the send blocked (TCP backpressure) with the audio it carried
+    int64_t audio_us = (int64_t)len * 1000000 / (REC_SAMPLE_RATE * 2);
+    if (sent < len || send_us * 100 > audio_us * tuning_get_int(TUNE_STREAM_CONGESTED_PCT)) {
+        g_uplink.fails += (sent < len);
+        g_uplink.fast_streak = 0;
+        if (g_uplink.batch < STREAM_BATCH_MAX) {
+            g_uplink.batch++;
+            g_uplink.ups++;
+            ESP_LOGI(TAG, "📶 Uplink slow (%lld us for %lld us audio) → batch %d",
+                     send_us, audio_us, g_uplink.batch);
+        }
+    } else if (send_us * 100 < audio_us * tuning_get_int(TUNE_STREAM_FAST_PCT)) {
+        if (++g_uplink.fast_streak >= tuning_get_int(TUNE_STREAM_FAST_STREAK) &&
+            g_uplink.batch > tuning_get_int(TUNE_STREAM_BATCH_MIN)) {
+            g_uplink.batch--;
+            g_uplink.downs++;
+            g_uplink.fast_streak = 0;
+        }
+    } else {
+        g_uplink.fast_streak = 0;
+    }
+}
+
+// Per-turn uplink telemetry for the server's /status
+static void uplink_report(void) {
+    char msg[160];
+    int len = snprintf(msg, sizeof(msg),
+                       "STATS uplink batch=%d ups=%d downs=%d sends=%d fails=%d avg_us=%lld max_us=%lld",
+                       g_uplink.batch, g_uplink.ups, g_uplink.downs, g_uplink.sends, g_uplink.fails,
+                       g_uplink.sends ? g_uplink.send_total_us / g_uplink.sends : 0LL,
+                       g_uplink.send_max_us);
+    esp_websocket_client_send_text(g_ws, msg, len, pdMS_TO_TICKS(1000));
+}
+
 // ============================================================================
 // Streaming Task - With on-device VAD and batching
 // ============================================================================
@@ -388,8 +741,14 @@ static void stream_task(void *arg) {
     g_stream_start_time = esp_timer_get_time();
     g_total_bytes_sent = 0;
     
-    // Allocate buffer in PSRAM
-    const int buf_size = AUDIO_CHUNK_SIZE * STREAM_BATCH_SIZE;
+    // Tell the server how this turn was opened - follow-ups keep its context
+    const char *turn = g_turn_followup ? "TURN followup" : "TURN wake";
+    esp_websocket_client_send_text(g_ws, turn, strlen(turn), pdMS_TO_TICKS(1000));
+    ESP_LOGI(TAG, "🎙️ %s (trigger → stream %lld ms)", turn,
+             (g_stream_start_time - g_turn_trigger_time) / 1000);
+    
+    // Allocate buffer in PSRAM - sized for the largest batch
+    const int buf_size = AUDIO_CHUNK_SIZE * STREAM_BATCH_MAX;
     uint8_t *buf = heap_caps_malloc(buf_size, MALLOC_CAP_SPIRAM);
     if (!buf) {
         ESP_LOGE(TAG, "Buffer alloc failed");
@@ -398,18 +757,28 @@ static void stream_task(void *arg) {
         return;
     }
     
+    uplink_begin_turn();
+    
     int batch_offset = 0;
     bool first_chunk = true;
     int silence_count = 0;
     int speech_count = 0;
     int total_chunks = 0;
+    bool no_speech = false;
     
-    const int max_chunks = STREAM_MAX_DURATION_MS / (AUDIO_CHUNK_SIZE * 1000 / (REC_SAMPLE_RATE * 2));
+    // Runtime-tunable knobs, fixed for the duration of this turn
+    const int vad_rms = tuning_get_int(TUNE_VAD_RMS_THRESHOLD);
+    const int vad_min_speech = tuning_get_int(TUNE_VAD_MIN_SPEECH_CHUNKS);
+    const int vad_silence = tuning_get_int(TUNE_VAD_SILENCE_CHUNKS);
+    const int yield_ms = tuning_get_int(TUNE_STREAM_YIELD_MS);
+    const int64_t followup_us = tuning_get_int(TUNE_FOLLOWUP_WINDOW_MS) * 1000LL;
+    const int max_chunks = tuning_get_int(TUNE_STREAM_MAX_DURATION_MS) / (AUDIO_CHUNK_SIZE * 1000 / (REC_SAMPLE_RATE * 2));
     
     while (get_state() == STATE_STREAMING && esp_websocket_client_is_connected(g_ws)) {
         // Read audio chunk
+        int want = (buf_size - batch_offset < AUDIO_CHUNK_SIZE) ? buf_size - batch_offset : AUDIO_CHUNK_SIZE;
         int len = audio_recorder_data_read(g_recorder, buf + batch_offset, 
-                                           AUDIO_CHUNK_SIZE, pdMS_TO_TICKS(30));
+                                           want, pdMS_TO_TICKS(30));
         
         if (len > 0) {
             total_chunks++;
@@ -420,7 +789,7 @@ static void stream_task(void *arg) {
             int sample_count = len / 2;
             int16_t rms = calculate_rms(samples, sample_count);
             
-            if (rms > VAD_RMS_THRESHOLD) {
+            if (rms > vad_rms) {
                 speech_count++;
                 silence_count = 0;
                 
@@ -431,18 +800,16 @@ static void stream_task(void *arg) {
 #endif
             } else {
                 // Only count silence after speech started
-                if (speech_count >= VAD_MIN_SPEECH_CHUNKS) {
+                if (speech_count >= vad_min_speech) {
                     silence_count++;
                     
                     // Smart silence detection
-                    if (silence_count >= VAD_SILENCE_CHUNKS) {
+                    if (silence_count >= vad_silence) {
                         ESP_LOGI(TAG, "🔇 Silence detected → sending");
                         
                         // Send remaining buffer
                         if (batch_offset > 0) {
-                            esp_websocket_client_send_bin(g_ws, (char *)buf, batch_offset, 
-                                                          pdMS_TO_TICKS(WS_SEND_TIMEOUT_MS));
-                            g_total_bytes_sent += batch_offset;
+                            uplink_send(buf, batch_offset);
                         }
                         break;
                     }
@@ -452,11 +819,9 @@ static void stream_task(void *arg) {
             
             batch_offset += len;
             
-            // Send batch when full
-            if (batch_offset >= buf_size) {
-                esp_websocket_client_send_bin(g_ws, (char *)buf, batch_offset, 
-                                              pdMS_TO_TICKS(WS_SEND_TIMEOUT_MS));
-                g_total_bytes_sent += batch_offset;
+            // Send batch when full (batch size adapts in uplink_send)
+            if (batch_offset >= g_uplink.batch * AUDIO_CHUNK_SIZE) {
+                uplink_send(buf, batch_offset);
                 
                 if (first_chunk) {
                     int64_t latency = (esp_timer_get_time() - g_stream_start_time) / 1000;
@@ -472,34 +837,71 @@ static void stream_task(void *arg) {
                 ESP_LOGW(TAG, "⏱️ Max duration reached");
                 break;
             }
+            
+#if FEATURE_FOLLOWUP && FEATURE_ON_DEVICE_VAD
+            // Follow-up window closes if the user doesn't start talking
+            if (g_turn_followup && speech_count < vad_min_speech &&
+                esp_timer_get_time() - g_stream_start_time > followup_us) {
+                ESP_LOGI(TAG, "💤 Follow-up window closed");
+                no_speech = true;
+                break;
+            }
+#endif
         }
         
         // Yield to other tasks
-        vTaskDelay(pdMS_TO_TICKS(STREAM_YIELD_MS));
+        vTaskDelay(pdMS_TO_TICKS(yield_ms));
     }
     
     // Send any remaining data
     if (batch_offset > 0 && esp_websocket_client_is_connected(g_ws)) {
-        esp_websocket_client_send_bin(g_ws, (char *)buf, batch_offset, 
-                                      pdMS_TO_TICKS(WS_SEND_TIMEOUT_MS));
-        g_total_bytes_sent += batch_offset;
+        uplink_send(buf, batch_offset);
     }
     
-    // Send END signal
+    // Send END signal - or tell the server the device already handled the turn
     if (esp_websocket_client_is_connected(g_ws)) {
-        esp_websocket_client_send_text(g_ws, "END", 3, pdMS_TO_TICKS(1000));
+        if (no_speech) {
+            esp_websocket_client_send_text(g_ws, "FOLLOWUP_END", 12, pdMS_TO_TICKS(1000));
+        } else
+#if FEATURE_LOCAL_COMMANDS
+        if (g_local_cmd >= 0) {
+            char msg[48];
+            int len = snprintf(msg, sizeof(msg), "LOCAL_CMD %s", local_cmd_name(g_local_cmd));
+            esp_websocket_client_send_text(g_ws, msg, len, pdMS_TO_TICKS(1000));
+        } else
+#endif
+        {
+            esp_websocket_client_send_text(g_ws, "END", 3, pdMS_TO_TICKS(1000));
+            g_end_sent_time = esp_timer_get_time();
+        }
     }
     
     // Stats
     int64_t duration_ms = (esp_timer_get_time() - g_stream_start_time) / 1000;
-    ESP_LOGI(TAG, "📤 Sent %d bytes in %lld ms (%d chunks)", 
-             g_total_bytes_sent, duration_ms, total_chunks);
+    ESP_LOGI(TAG, "📤 Sent %d bytes in %lld ms (%d chunks, batch %d, +%d/-%d)", 
+             g_total_bytes_sent, duration_ms, total_chunks,
+             g_uplink.batch, g_uplink.ups, g_uplink.downs);
+    if (esp_websocket_client_is_connected(g_ws)) {
+        uplink_report();
+    }
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    if (!g_turn_followup) {
+        ESP_LOGI(TAG, "📊 Core %d busy %d%% over the wake session (WakeNet%s)", RECORDER_TASK_CORE,
+                 core_busy_pct(&g_session_mark), FEATURE_LOCAL_COMMANDS ? " + MultiNet" : "");
+    }
+#endif
     
     free(buf);
     
+    if (no_speech) {
+        audio_recorder_trigger_stop(g_recorder);
+    }
+    
     if (!esp_websocket_client_is_connected(g_ws)) {
         ESP_LOGW(TAG, "Connection lost during stream");
         set_state(STATE_IDLE);
+    } else if (g_local_cmd >= 0 || no_speech) {
+        set_state(STATE_IDLE);  // No cloud response coming
     } else {
         set_state(STATE_WAITING);
     }
@@ -507,6 +909,46 @@ static void stream_task(void *arg) {
     vTaskDelete(NULL);
 }
 
+// ============================================================================
+// Follow-up Window - next turn without the wake word
+// ============================================================================
+#if FEATURE_FOLLOWUP
+static void followup_task(void *arg) {
+    // Let the reply finish playing so the mic doesn't pick it up
+    ringbuf_handle_t rb = audio_element_get_output_ringbuf(g_raw_writer);
+    int waited = 0;
+    while (get_state() == STATE_IDLE && rb && rb_bytes_filled(rb) > 0 && waited < FOLLOWUP_DRAIN_MAX_MS) {
+        vTaskDelay(pdMS_TO_TICKS(TONE_PLAYBACK_POLL_MS));
+        waited += TONE_PLAYBACK_POLL_MS;
+    }
+    vTaskDelay(pdMS_TO_TICKS(tuning_get_int(TUNE_FOLLOWUP_TAIL_MS)));
+    
+    // Wake word or a new reply took over in the meantime
+    if (get_state() == STATE_IDLE && esp_websocket_client_is_connected(g_ws)) {
+        ESP_LOGI(TAG, "👂 Follow-up window open (%d ms)", tuning_get_int(TUNE_FOLLOWUP_WINDOW_MS));
+        g_turn_trigger_time = esp_timer_get_time();
+        g_turn_followup = true;
+        g_local_cmd = -1;
+        
+        // Open a recorder session without WakeNet, then stream as usual
+        set_state(STATE_STREAMING);
+        audio_recorder_trigger_start(g_recorder);
+        xTaskCreatePinnedToCore(stream_task, "stream", STREAM_TASK_STACK_SIZE, NULL,
+                                STREAM_TASK_PRIORITY, NULL, STREAM_TASK_CORE);
+    }
+    
+    g_followup_pending = false;
+    vTaskDelete(NULL);
+}
+
+static void open_followup_window(void) {
+    if (g_followup_pending) return;
+    g_followup_pending = true;
+    xTaskCreatePinnedToCore(followup_task, "followup", 3072, NULL,
+                            STREAM_TASK_PRIORITY, NULL, STREAM_TASK_CORE);
+}
+#endif
+
 // ============================================================================
 // Wake Word Callback - Optimized
 // ============================================================================
@@ -514,12 +956,55 @@ static int input_cb(int16_t *buffer, int buf_sz, void *user_ctx, TickType_t tick
     return raw_stream_read(g_raw_reader, (char *)buffer, buf_sz);
 }
 
+#if FEATURE_LOCAL_COMMANDS
+static bool g_local_cmd_ready = false;
+
+// MultiNet hit while the turn is still uploading - act locally, cancel the cloud turn
+static void handle_local_command(int id) {
+    const char *name = local_cmd_name(id);
+    if (!name) return;
+    
+    if (!g_local_cmd_ready) return;  // Over budget at boot - cloud path only
+    
+    int64_t latency_ms = (esp_timer_get_time() - g_turn_trigger_time) / 1000;
+    
+    if (local_cmd_execute(id) != ESP_OK) {
+        ESP_LOGW(TAG, "🏠 '%s' not sent, falling back to cloud", name);
+        return;
+    }
+    
+    ESP_LOGI(TAG, "🏠 Local command '%s' (%lld ms after %s)", name, latency_ms,
+             g_turn_followup ? "follow-up open" : "wake");
+    
+    if (id == LOCAL_CMD_STOP) {
+        // Drop reply audio still arriving and cancel the reply server-side -
+        // the ding below only pauses the pipeline, streaming would restart it
+        g_flush = true;
+        if (g_playback_started) {
+            audio_pipeline_stop(g_play_pipe);
+        }
+        if (g_reply_streaming) {
+            esp_websocket_client_send_text(g_ws, "BARGE_IN", 8, pdMS_TO_TICKS(100));
+        }
+    }
+    g_local_cmd = id;
+    set_state(STATE_IDLE);  // Ends stream_task, which reports LOCAL_CMD
+    play_ding();            // Confirmation
+}
+#endif
+
 static esp_err_t recorder_cb(audio_rec_evt_t *event, void *user_data) {
     state_t current = get_state();
     
     // Only respond to wake word in IDLE state
     if (event->type == AUDIO_REC_WAKEUP_START && current == STATE_IDLE) {
         ESP_LOGI(TAG, "🎤 JARVIS!");
+        g_turn_trigger_time = esp_timer_get_time();
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+        core_mark(&g_session_mark);
+        g_wake_count++;
+#endif
+        g_turn_followup = false;
         
         // Check connection
         if (!esp_websocket_client_is_connected(g_ws)) {
@@ -555,6 +1040,7 @@ static esp_err_t recorder_cb(audio_rec_evt_t *event, void *user_data) {
         g_silence_chunks = 0;
         g_speech_chunks = 0;
         g_speech_started = false;
+        g_local_cmd = -1;
         
         // Start streaming
         set_state(STATE_STREAMING);
@@ -568,6 +1054,12 @@ static esp_err_t recorder_cb(audio_rec_evt_t *event, void *user_data) {
             STREAM_TASK_CORE
         );
     }
+#if FEATURE_LOCAL_COMMANDS
+    // MultiNet runs for the rest of the wake session - AUDIO_REC_COMMAND_DECT + id
+    else if (event->type >= AUDIO_REC_COMMAND_DECT && current == STATE_STREAMING) {
+        handle_local_command(event->type - AUDIO_REC_COMMAND_DECT);
+    }
+#endif
     
     return ESP_OK;
 }
@@ -626,8 +1118,10 @@ void app_main(void) {
     // Mutex
     g_mutex = xSemaphoreCreateMutex();
     
-    // Settings
+    // Settings + runtime tuning (before anything reads a tunable)
     settings_init();
+    tuning_init();
+    clip_cache_init(on_clip_evicted);
     
     log_memory("After init");
     
@@ -649,11 +1143,19 @@ void app_main(void) {
     
     log_memory("After pipelines");
     
-    // WebSocket
+    // WebSocket - identify this device so the server keeps a session per room
+    uint8_t mac[6] = {0};
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    snprintf(g_device_id, sizeof(g_device_id), DEVICE_ID_PREFIX "%02x%02x%02x", mac[3], mac[4], mac[5]);
+    
+    static char ws_uri[160];
+    snprintf(ws_uri, sizeof(ws_uri), WS_URI "/?device_id=%s&group=%s", g_device_id, DEVICE_GROUP);
+    ESP_LOGI(TAG, "🆔 Device: %s", g_device_id);
+    
     esp_websocket_client_config_t ws_cfg = {
-        .uri = WS_URI,
+        .uri = ws_uri,
         .buffer_size = WS_BUFFER_SIZE,
-        .ping_interval_sec = WS_PING_INTERVAL_SEC,
+        .ping_interval_sec = tuning_get_int(TUNE_WS_PING_INTERVAL_SEC),
     };
     g_ws = esp_websocket_client_init(&ws_cfg);
     esp_websocket_register_events(g_ws, WEBSOCKET_EVENT_ANY, ws_handler, NULL);
@@ -681,18 +1183,26 @@ void app_main(void) {
     sr_cfg.afe_cfg->vad_init = AFE_ENABLE_VAD;
     sr_cfg.afe_cfg->aec_init = AFE_ENABLE_AEC;
     sr_cfg.afe_cfg->se_init = AFE_ENABLE_SE;
-    sr_cfg.afe_cfg->afe_linear_gain = AFE_LINEAR_GAIN;
+    sr_cfg.afe_cfg->afe_linear_gain = tuning_get_float(TUNE_AFE_LINEAR_GAIN);
     sr_cfg.afe_cfg->afe_ringbuf_size = AFE_RINGBUF_SIZE;
     
 #if AFE_ENABLE_VAD
     sr_cfg.afe_cfg->vad_mode = AFE_VAD_MODE;
 #endif
     
+#if FEATURE_LOCAL_COMMANDS
+    sr_cfg.multinet_init = true;   // Device commands recognized on-device
+#else
     sr_cfg.multinet_init = false;  // No command recognition needed
+#endif
     
     audio_rec_cfg_t rec_cfg = AUDIO_RECORDER_DEFAULT_CFG();
     rec_cfg.task_prio = RECORDER_TASK_PRIORITY;
+#if FEATURE_LOCAL_COMMANDS
+    rec_cfg.task_size = 8 * 1024;  // MultiNet callbacks publish MQTT and play the ding
+#else
     rec_cfg.task_size = 6 * 1024;  // Reduced from 8KB
+#endif
     rec_cfg.read = (recorder_data_read_t)input_cb;
     rec_cfg.sr_handle = recorder_sr_create(&sr_cfg, &rec_cfg.sr_iface);
     rec_cfg.event_cb = recorder_cb;
@@ -702,6 +1212,13 @@ void app_main(void) {
     
     log_memory("After WakeNet");
     
+#if FEATURE_LOCAL_COMMANDS
+    g_local_cmd_ready = (local_cmd_init() == ESP_OK);
+    ESP_LOGI(TAG, "🏠 Local commands %s | Heap: %lu | PSRAM: %lu", g_local_cmd_ready ? "on" : "OFF",
+             (unsigned long)esp_get_free_heap_size(),
+             (unsigned long)heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+#endif
+    
     // Buttons
     esp_periph_config_t periph_cfg = DEFAULT_ESP_PERIPH_SET_CONFIG();
     esp_periph_set_handle_t set = esp_periph_set_init(&periph_cfg);
@@ -725,11 +1242,25 @@ void app_main(void) {
     ESP_LOGI(TAG, "════════════════════════════════════");
     
     // Main loop - periodic status
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    core_mark_t idle_mark;
+    core_mark(&idle_mark);
+    uint32_t wakes = g_wake_count;
+#endif
     while (1) {
         vTaskDelay(pdMS_TO_TICKS(30000));  // Every 30s
         
 #if DEBUG_MEMORY
         log_memory("Periodic");
+#endif
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+        // Baseline for the session figure: a window with no wake word in it
+        if (wakes == g_wake_count && get_state() == STATE_IDLE) {
+            ESP_LOGI(TAG, "📊 Core %d busy %d%% while listening (WakeNet only)", RECORDER_TASK_CORE,
+                     core_busy_pct(&idle_mark));
+        }
+        core_mark(&idle_mark);
+        wakes = g_wake_count;
 #endif
     }
 }
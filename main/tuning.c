@@ -0,0 +1,221 @@
+#include "tuning.h"
+#include "esp_log.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "TUNING";
+static const char *NVS_NAMESPACE = "tuning";
+
+typedef struct {
+    const char *key;
+    tuning_type_t type;
+    float def;
+    float min;
+    float max;
+    tuning_apply_t apply;
+} tuning_def_t;
+
+// Compile-time defaults generated from config.h via TUNING_TABLE
+static const tuning_def_t g_defs[TUNE_COUNT] = {
+#define TUNING_DEF(id, key, type, def, min, max, apply) \
+    [TUNE_##id] = {key, type, (float)(def), (float)(min), (float)(max), apply},
+    TUNING_TABLE(TUNING_DEF)
+#undef TUNING_DEF
+};
+
+typedef union {
+    int32_t i;
+    float f;
+} tuning_value_t;
+
+// In use, and stored (differs only for REBUILD params until the next boot)
+static tuning_value_t g_values[TUNE_COUNT];
+static tuning_value_t g_stored[TUNE_COUNT];
+
+// Mutex for thread-safe updates
+static SemaphoreHandle_t tuning_mutex = NULL;
+
+static tuning_value_t default_value(const tuning_def_t *def) {
+    tuning_value_t v;
+    if (def->type == TUNE_FLOAT) {
+        v.f = def->def;
+    } else {
+        v.i = (int32_t)def->def;
+    }
+    return v;
+}
+
+static int find_key(const char *key) {
+    for (int i = 0; i < TUNE_COUNT; i++) {
+        if (strcmp(g_defs[i].key, key) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static bool in_range(const tuning_def_t *def, tuning_value_t v) {
+    if (def->type == TUNE_FLOAT) {
+        return isfinite(v.f) && v.f >= def->min && v.f <= def->max;
+    }
+    return v.i >= (int32_t)def->min && v.i <= (int32_t)def->max;
+}
+
+static int format_value(char *buf, size_t len, const tuning_def_t *def, tuning_value_t v) {
+    return (def->type == TUNE_FLOAT) ? snprintf(buf, len, "%.3f", v.f) : snprintf(buf, len, "%ld", (long)v.i);
+}
+
+esp_err_t tuning_init(void) {
+    tuning_mutex = xSemaphoreCreateMutex();
+    if (tuning_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create tuning mutex");
+        return ESP_FAIL;
+    }
+    
+    for (int i = 0; i < TUNE_COUNT; i++) {
+        g_values[i] = default_value(&g_defs[i]);
+    }
+    
+    // Overrides - floats are stored as their bit pattern
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    if (err == ESP_OK) {
+        int loaded = 0;
+        for (int i = 0; i < TUNE_COUNT; i++) {
+            tuning_value_t v;
+            if (nvs_get_i32(nvs_handle, g_defs[i].key, &v.i) != ESP_OK) {
+                continue;
+            }
+            // Stale (range changed since) or corrupt - keep the default
+            if (!in_range(&g_defs[i], v)) {
+                ESP_LOGW(TAG, "Ignoring stored %s=%ld (range %.3f..%.3f)", g_defs[i].key,
+                         (long)v.i, g_defs[i].min, g_defs[i].max);
+                continue;
+            }
+            g_values[i] = v;
+            loaded++;
+        }
+        nvs_close(nvs_handle);
+        ESP_LOGI(TAG, "Loaded %d tuning overrides from NVS", loaded);
+    } else if (err != ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGE(TAG, "Error opening NVS handle: %s", esp_err_to_name(err));
+    }
+    
+    memcpy(g_stored, g_values, sizeof(g_values));
+    return ESP_OK;
+}
+
+int tuning_get_int(tuning_id_t id) {
+    return g_values[id].i;
+}
+
+float tuning_get_float(tuning_id_t id) {
+    return g_values[id].f;
+}
+
+esp_err_t tuning_set(const char *key, const char *value) {
+    int id = find_key(key);
+    if (id < 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    
+    const tuning_def_t *def = &g_defs[id];
+    char *end = NULL;
+    tuning_value_t v;
+    if (def->type == TUNE_FLOAT) {
+        v.f = strtof(value, &end);
+    } else {
+        v.i = strtol(value, &end, 10);  // "1.5" stops at '.' and is rejected below
+    }
+    if (end == value || *end != '\0' || !in_range(def, v)) {
+        ESP_LOGW(TAG, "Rejected %s=%s (%s, range %.3f..%.3f)", key, value,
+                 def->type == TUNE_FLOAT ? "float" : "integer", def->min, def->max);
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    if (xSemaphoreTake(tuning_mutex, portMAX_DELAY) != pdTRUE) {
+        return ESP_FAIL;
+    }
+    g_stored[id] = v;
+    if (def->apply == TUNE_LIVE) {
+        g_values[id] = v;
+    }
+    xSemaphoreGive(tuning_mutex);
+    
+    // Save to NVS
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err == ESP_OK) {
+        err = nvs_set_i32(nvs_handle, key, v.i);
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs_handle);
+        }
+        nvs_close(nvs_handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save %s to NVS: %s", key, esp_err_to_name(err));
+        return err;
+    }
+    
+    ESP_LOGI(TAG, "%s=%s%s", key, value, def->apply == TUNE_REBUILD ? " (after reboot)" : "");
+    return ESP_OK;
+}
+
+esp_err_t tuning_reset(void) {
+    ESP_LOGI(TAG, "Resetting tuning to config.h defaults");
+    
+    if (xSemaphoreTake(tuning_mutex, portMAX_DELAY) != pdTRUE) {
+        return ESP_FAIL;
+    }
+    for (int i = 0; i < TUNE_COUNT; i++) {
+        g_stored[i] = default_value(&g_defs[i]);
+        if (g_defs[i].apply == TUNE_LIVE) {
+            g_values[i] = g_stored[i];
+        }
+    }
+    xSemaphoreGive(tuning_mutex);
+    
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS for reset: %s", esp_err_to_name(err));
+        return err;
+    }
+    err = nvs_erase_all(nvs_handle);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    return err;
+}
+
+int tuning_dump(char *buf, size_t len) {
+    size_t pos = 0;
+    buf[0] = '\0';
+    
+    xSemaphoreTake(tuning_mutex, portMAX_DELAY);
+    for (int i = 0; i < TUNE_COUNT && pos < len; i++) {
+        int n = snprintf(buf + pos, len - pos, "%s%s=", pos ? " " : "", g_defs[i].key);
+        if (n < 0 || pos + n >= len) break;
+        pos += n;
+        
+        n = format_value(buf + pos, len - pos, &g_defs[i], g_stored[i]);
+        if (n < 0 || pos + n >= len) break;
+        pos += n;
+        
+        // Stored but not in use yet
+        if (g_stored[i].i != g_values[i].i && pos + 1 < len) {
+            buf[pos++] = '*';
+            buf[pos] = '\0';
+        }
+    }
+    xSemaphoreGive(tuning_mutex);
+    
+    return (int)pos;
+}
@@ -0,0 +1,84 @@
+#ifndef _TUNING_H_
+#define _TUNING_H_
+
+#include "esp_err.h"
+#include "tuning_defs.h"
+#include <stddef.h>
+
+typedef enum {
+    TUNE_INT,
+    TUNE_FLOAT
+} tuning_type_t;
+
+typedef enum {
+    TUNE_LIVE,
+    TUNE_REBUILD
+} tuning_apply_t;
+
+// TUNE_<config.h name>, e.g. TUNE_VAD_RMS_THRESHOLD
+typedef enum {
+#define TUNING_ENUM(id, key, type, def, min, max, apply) TUNE_##id,
+    TUNING_TABLE(TUNING_ENUM)
+#undef TUNING_ENUM
+    TUNE_COUNT
+} tuning_id_t;
+
+/**
+ * @brief Initialize the tuning registry and load overrides from NVS
+ * 
+ * Stored values outside the parameter's range are ignored (default kept).
+ * Call after nvs_flash_init() and before the pipelines are built.
+ * 
+ * @return ESP_OK on success
+ */
+esp_err_t tuning_init(void);
+
+/**
+ * @brief Get an integer parameter
+ * 
+ * Lock-free - single aligned word read.
+ * 
+ * @param id Parameter id
+ * @return Current value
+ */
+int tuning_get_int(tuning_id_t id);
+
+/**
+ * @brief Get a float parameter
+ * 
+ * @param id Parameter id
+ * @return Current value
+ */
+float tuning_get_float(tuning_id_t id);
+
+/**
+ * @brief Set a parameter by name from its text value and persist it
+ * 
+ * @param key Parameter name (NVS key)
+ * @param value Value as text
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND for an unknown key,
+ *         ESP_ERR_INVALID_ARG if unparsable, out of range, or not a whole
+ *         number for an integer parameter
+ */
+esp_err_t tuning_set(const char *key, const char *value);
+
+/**
+ * @brief Reset all parameters to the config.h defaults and clear NVS
+ * 
+ * @return ESP_OK on success
+ */
+esp_err_t tuning_reset(void);
+
+/**
+ * @brief Write all parameters as space-separated key=value pairs
+ * 
+ * REBUILD parameters whose stored value differs from the value in use
+ * are marked with a trailing '*'.
+ * 
+ * @param buf Output buffer
+ * @param len Buffer size
+ * @return Number of characters written
+ */
+int tuning_dump(char *buf, size_t len);
+
+#endif // _TUNING_H_
@@ -0,0 +1,33 @@
+#ifndef _TUNING_DEFS_H_
+#define _TUNING_DEFS_H_
+
+#include "config.h"
+
+// ============================================================================
+// Runtime-tunable parameters - defaults come straight from config.h
+//
+// X(id, nvs_key, type, default, min, max, apply)
+//   nvs_key: also the name used in TUNE commands (max 15 chars)
+//   apply:   TUNE_LIVE    - read at the start of every turn
+//            TUNE_REBUILD - read when the pipeline / recorder / WebSocket
+//                           is built, i.e. after the next REBOOT
+// ============================================================================
+#define TUNING_TABLE(X) \
+    X(VAD_RMS_THRESHOLD,      "vad_rms",       TUNE_INT,   VAD_RMS_THRESHOLD,      50,    20000,        TUNE_LIVE)    \
+    X(VAD_MIN_SPEECH_CHUNKS,  "vad_min_speech", TUNE_INT,  VAD_MIN_SPEECH_CHUNKS,  1,     20,           TUNE_LIVE)    \
+    X(VAD_SILENCE_CHUNKS,     "vad_silence",   TUNE_INT,   VAD_SILENCE_CHUNKS,     1,     50,           TUNE_LIVE)    \
+    X(STREAM_YIELD_MS,        "stream_yield",  TUNE_INT,   STREAM_YIELD_MS,        0,     100,          TUNE_LIVE)    \
+    X(STREAM_MAX_DURATION_MS, "stream_max_ms", TUNE_INT,   STREAM_MAX_DURATION_MS, 1000,  60000,        TUNE_LIVE)    \
+    X(STREAM_BATCH_MIN,       "batch_min",     TUNE_INT,   STREAM_BATCH_MIN,       1,     STREAM_BATCH_MAX, TUNE_LIVE) \
+    X(STREAM_CONGESTED_PCT,   "congest_pct",   TUNE_INT,   STREAM_CONGESTED_PCT,   1,     1000,         TUNE_LIVE)    \
+    X(STREAM_FAST_PCT,        "fast_pct",      TUNE_INT,   STREAM_FAST_PCT,        0,     100,          TUNE_LIVE)    \
+    X(STREAM_FAST_STREAK,     "fast_streak",   TUNE_INT,   STREAM_FAST_STREAK,     1,     100,          TUNE_LIVE)    \
+    X(FOLLOWUP_WINDOW_MS,     "followup_ms",   TUNE_INT,   FOLLOWUP_WINDOW_MS,     0,     30000,        TUNE_LIVE)    \
+    X(FOLLOWUP_TAIL_MS,       "followup_tail", TUNE_INT,   FOLLOWUP_TAIL_MS,       0,     2000,         TUNE_LIVE)    \
+    X(RAW_WRITE_BUFFER_SIZE,  "raw_write_buf", TUNE_INT,   RAW_WRITE_BUFFER_SIZE,  CLIP_MAX_BYTES, 1048576, TUNE_REBUILD) \
+    X(I2S_WRITE_BUFFER_SIZE,  "i2s_write_buf", TUNE_INT,   I2S_WRITE_BUFFER_SIZE,  8192,  262144,       TUNE_REBUILD) \
+    X(RAW_READ_BUFFER_SIZE,   "raw_read_buf",  TUNE_INT,   RAW_READ_BUFFER_SIZE,   8192,  262144,       TUNE_REBUILD) \
+    X(AFE_LINEAR_GAIN,        "afe_gain",      TUNE_FLOAT, AFE_LINEAR_GAIN,        0.1f,  4.0f,         TUNE_REBUILD) \
+    X(WS_PING_INTERVAL_SEC,   "ws_ping_sec",   TUNE_INT,   WS_PING_INTERVAL_SEC,   5,     120,          TUNE_REBUILD)
+
+#endif // _TUNING_DEFS_H_
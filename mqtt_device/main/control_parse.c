@@ -0,0 +1,262 @@
+#include "control_parse.h"
+#include <string.h>
+
+typedef struct {
+    const char *p;
+    const char *end;
+} cursor_t;
+
+static void skip_ws(cursor_t *c) {
+    while (c->p < c->end && (*c->p == ' ' || *c->p == '\t' || *c->p == '\n' || *c->p == '\r')) {
+        c->p++;
+    }
+}
+
+static bool expect(cursor_t *c, char ch) {
+    skip_ws(c);
+    if (c->p < c->end && *c->p == ch) {
+        c->p++;
+        return true;
+    }
+    return false;
+}
+
+// String token - points into the payload, escapes left as-is. Raw control
+// characters (a NUL would cut a device name short) are invalid JSON
+static bool parse_string(cursor_t *c, const char **str, size_t *str_len) {
+    if (!expect(c, '"')) {
+        return false;
+    }
+    const char *start = c->p;
+    while (c->p < c->end && *c->p != '"') {
+        if ((unsigned char)*c->p < 0x20) {
+            return false;
+        }
+        if (*c->p == '\\') {
+            c->p++;  // Skip the escaped char
+        }
+        c->p++;
+    }
+    if (c->p >= c->end) {
+        return false;
+    }
+    *str = start;
+    *str_len = c->p - start;
+    c->p++;
+    return true;
+}
+
+static bool is_digit(const cursor_t *c) {
+    return c->p < c->end && *c->p >= '0' && *c->p <= '9';
+}
+
+// JSON number truncated to int32, like cJSON's valueint: fraction and
+// exponent are honoured (1e3 -> 1000, 2.5e1 -> 25), the result is truncated
+// toward zero and saturates at INT32_MIN/INT32_MAX
+static bool parse_number(cursor_t *c, int32_t *out) {
+    skip_ws(c);
+    bool neg = false;
+    if (c->p < c->end && *c->p == '-') {
+        neg = true;
+        c->p++;
+    }
+    if (!is_digit(c)) {
+        return false;
+    }
+    
+    // Up to 12 significant digits - enough to tell int32 overflow apart,
+    // further integer digits only raise the exponent
+    const int64_t mant_limit = 100000000000LL;
+    int64_t mant = 0;
+    int exp10 = 0;
+    for (; is_digit(c); c->p++) {
+        if (mant < mant_limit) {
+            mant = mant * 10 + (*c->p - '0');
+        } else {
+            exp10++;
+        }
+    }
+    if (c->p < c->end && *c->p == '.') {
+        c->p++;  // "1." is accepted, as strtod does for cJSON
+        for (; is_digit(c); c->p++) {
+            if (mant < mant_limit) {
+                mant = mant * 10 + (*c->p - '0');
+                exp10--;
+            }
+        }
+    }
+    if (c->p < c->end && (*c->p == 'e' || *c->p == 'E')) {
+        c->p++;
+        bool exp_neg = false;
+        if (c->p < c->end && (*c->p == '+' || *c->p == '-')) {
+            exp_neg = *c->p == '-';
+            c->p++;
+        }
+        if (!is_digit(c)) {
+            return false;
+        }
+        int e = 0;
+        for (; is_digit(c); c->p++) {
+            if (e < 1000) {
+                e = e * 10 + (*c->p - '0');
+            }
+        }
+        exp10 += exp_neg ? -e : e;
+    }
+    
+    // Scale; anything past INT32_MAX + 1 saturates either way
+    const int64_t sat = (int64_t)INT32_MAX + 1;
+    for (; exp10 > 0 && mant != 0 && mant <= sat; exp10--) {
+        mant *= 10;
+    }
+    for (; exp10 < 0 && mant != 0; exp10++) {
+        mant /= 10;
+    }
+    if (mant > sat) {
+        mant = sat;
+    }
+    if (neg) {
+        *out = (int32_t)(-mant);
+    } else {
+        *out = (int32_t)(mant > INT32_MAX ? INT32_MAX : mant);
+    }
+    return true;
+}
+
+static bool skip_literal(cursor_t *c, const char *lit) {
+    size_t n = strlen(lit);
+    if ((size_t)(c->end - c->p) < n || memcmp(c->p, lit, n) != 0) {
+        return false;
+    }
+    c->p += n;
+    return true;
+}
+
+// Value of a member we don't use - flat values only
+static bool skip_value(cursor_t *c) {
+    skip_ws(c);
+    if (c->p >= c->end) {
+        return false;
+    }
+    const char *s;
+    size_t n;
+    int32_t num;
+    switch (*c->p) {
+    case '"': return parse_string(c, &s, &n);
+    case 't': return skip_literal(c, "true");
+    case 'f': return skip_literal(c, "false");
+    case 'n': return skip_literal(c, "null");
+    default:  return parse_number(c, &num);
+    }
+}
+
+static control_parse_status_t parse_object(cursor_t *c, control_parsed_op_t *op) {
+    memset(op, 0, sizeof(*op));
+    bool has_device = false;
+    
+    if (!expect(c, '{')) {
+        return CONTROL_PARSE_SYNTAX;
+    }
+    if (expect(c, '}')) {
+        return CONTROL_PARSE_NO_DEVICE;
+    }
+    do {
+        const char *key;
+        size_t key_len;
+        if (!parse_string(c, &key, &key_len) || !expect(c, ':')) {
+            return CONTROL_PARSE_SYNTAX;
+        }
+        
+        if (key_len == 6 && memcmp(key, "device", 6) == 0) {
+            const char *name;
+            size_t name_len;
+            if (!parse_string(c, &name, &name_len)) {
+                return CONTROL_PARSE_NO_DEVICE;
+            }
+            if (name_len == 0 || name_len >= CONTROL_NAME_MAX || memchr(name, '\\', name_len)) {
+                return CONTROL_PARSE_NO_DEVICE;
+            }
+            memcpy(op->device, name, name_len);
+            op->device[name_len] = '\0';
+            has_device = true;
+        } else if (key_len == 5 && memcmp(key, "value", 5) == 0) {
+            if (!parse_number(c, &op->value)) {
+                return CONTROL_PARSE_SYNTAX;
+            }
+            op->has_value = true;
+        } else if (key_len == 7 && memcmp(key, "timeout", 7) == 0) {
+            if (!parse_number(c, &op->timeout)) {
+                return CONTROL_PARSE_SYNTAX;
+            }
+        } else if (key_len == 5 && memcmp(key, "speed", 5) == 0) {
+            if (!parse_number(c, &op->speed)) {
+                return CONTROL_PARSE_SYNTAX;
+            }
+        } else if (!skip_value(c)) {
+            return CONTROL_PARSE_SYNTAX;
+        }
+    } while (expect(c, ','));
+    
+    if (!expect(c, '}')) {
+        return CONTROL_PARSE_SYNTAX;
+    }
+    return has_device ? CONTROL_PARSE_OK : CONTROL_PARSE_NO_DEVICE;
+}
+
+static control_parse_status_t parse_payload(const char *data, size_t len, control_parsed_op_t *ops, int max_ops, int *count) {
+    if (len > CONTROL_PARSE_MAX_LEN) {
+        return CONTROL_PARSE_TOO_LONG;
+    }
+    
+    cursor_t c = { data, data + len };
+    control_parse_status_t status;
+    
+    if (expect(&c, '[')) {
+        do {
+            if (*count >= max_ops) {
+                return CONTROL_PARSE_TOO_MANY;
+            }
+            status = parse_object(&c, &ops[*count]);
+            if (status != CONTROL_PARSE_OK) {
+                return status;
+            }
+            (*count)++;
+        } while (expect(&c, ','));
+        if (!expect(&c, ']')) {
+            return CONTROL_PARSE_SYNTAX;
+        }
+    } else {
+        if (max_ops < 1) {
+            return CONTROL_PARSE_TOO_MANY;
+        }
+        status = parse_object(&c, &ops[0]);
+        if (status != CONTROL_PARSE_OK) {
+            return status;
+        }
+        *count = 1;
+    }
+    
+    // Nothing but whitespace may follow
+    skip_ws(&c);
+    return c.p == c.end ? CONTROL_PARSE_OK : CONTROL_PARSE_SYNTAX;
+}
+
+control_parse_status_t control_parse(const char *data, size_t len, control_parsed_op_t *ops, int max_ops, int *count) {
+    *count = 0;
+    control_parse_status_t status = parse_payload(data, len, ops, max_ops, count);
+    if (status != CONTROL_PARSE_OK) {
+        *count = 0;  // All or nothing
+    }
+    return status;
+}
+
+const char *control_parse_status_name(control_parse_status_t status) {
+    switch (status) {
+    case CONTROL_PARSE_OK:        return "ok";
+    case CONTROL_PARSE_TOO_LONG:  return "too long";
+    case CONTROL_PARSE_SYNTAX:    return "syntax";
+    case CONTROL_PARSE_TOO_MANY:  return "too many ops";
+    case CONTROL_PARSE_NO_DEVICE: return "no device";
+    }
+    return "unknown";
+}
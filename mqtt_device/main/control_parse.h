@@ -0,0 +1,51 @@
+#ifndef _CONTROL_PARSE_H_
+#define _CONTROL_PARSE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CONTROL_PARSE_MAX_LEN   512     // Larger payloads are rejected unread
+#define CONTROL_NAME_MAX        16      // Device name incl. NUL
+
+// One {"device", "value"[, "timeout"][, "speed"]} entry
+typedef struct {
+    char device[CONTROL_NAME_MAX];
+    int32_t value;
+    bool has_value;
+    int32_t timeout;                    // 0 if absent
+    int32_t speed;                      // 0 if absent
+} control_parsed_op_t;
+
+typedef enum {
+    CONTROL_PARSE_OK = 0,
+    CONTROL_PARSE_TOO_LONG,
+    CONTROL_PARSE_SYNTAX,
+    CONTROL_PARSE_TOO_MANY,             // Array longer than max_ops
+    CONTROL_PARSE_NO_DEVICE,            // Entry without a usable "device"
+} control_parse_status_t;
+
+/**
+ * @brief Parse a control payload in place, without allocating
+ * 
+ * Accepts one object or an array of objects. Only flat string/number/
+ * true/false/null members are allowed; unknown keys are skipped, nested
+ * objects or arrays are a syntax error. Numbers follow cJSON's valueint:
+ * fraction and exponent allowed, truncated toward zero, saturated to int32.
+ * Pure function - builds for the host.
+ * 
+ * @param data Payload (not NUL-terminated)
+ * @param len Payload length
+ * @param ops Output entries
+ * @param max_ops Capacity of ops
+ * @param count Number of entries parsed
+ * @return CONTROL_PARSE_OK or the reason the payload was rejected
+ */
+control_parse_status_t control_parse(const char *data, size_t len, control_parsed_op_t *ops, int max_ops, int *count);
+
+/**
+ * @brief Short name for a parse status (for logs)
+ */
+const char *control_parse_status_name(control_parse_status_t status);
+
+#endif // _CONTROL_PARSE_H_
@@ -0,0 +1,137 @@
+#include "devices.h"
+
+#include <string.h>
+#include "esp_log.h"
+
+static const char *TAG = "DEVICES";
+
+#define STATE_FIELD(f) offsetof(device_state_t, f), sizeof(((device_state_t *)0)->f)
+
+const device_desc_t devices[DEVICE_COUNT] = {
+    {"servo",  DEV_SERVO,  PIN_SERVO,  0, 120, 180, STATE_FIELD(servo_angle)},  // Limit servo range 120-180 as requested
+    {"light1", DEV_LIGHT,  -1,         0, LIGHT_OFF, LIGHT_BLINKING, STATE_FIELD(light1)},
+    {"light2", DEV_LIGHT,  -1,         1, LIGHT_OFF, LIGHT_BLINKING, STATE_FIELD(light2)},
+    {"light3", DEV_LIGHT,  -1,         2, LIGHT_OFF, LIGHT_BLINKING, STATE_FIELD(light3)},
+    {"fan1",   DEV_SWITCH, PIN_FAN1,   0, 0, 1, STATE_FIELD(fan1)},
+    {"fan2",   DEV_SWITCH, PIN_FAN2,   0, 0, 1, STATE_FIELD(fan2)},
+    {"buzzer", DEV_BUZZER, PIN_BUZZER, 0, BUZZER_OFF, BUZZER_CONTINUOUS, STATE_FIELD(buzzer_mode)},
+    {"sensor", DEV_SENSOR, PIN_DHT11,  0, 0, 0, 0, 0},
+};
+
+static uint32_t device_hashes[DEVICE_COUNT];
+
+// FNV-1a - compared before strcmp so a miss costs one integer compare per entry
+static uint32_t name_hash(const char *name) {
+    uint32_t h = 2166136261u;
+    while (*name) {
+        h = (h ^ (uint8_t)*name++) * 16777619u;
+    }
+    return h;
+}
+
+void devices_init(void) {
+    for (int i = 0; i < DEVICE_COUNT; i++) {
+        device_hashes[i] = name_hash(devices[i].name);
+    }
+}
+
+int devices_find(const char *name) {
+    uint32_t h = name_hash(name);
+    for (int i = 0; i < DEVICE_COUNT; i++) {
+        if (device_hashes[i] == h && strcmp(devices[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int devices_clamp(const device_desc_t *desc, int val) {
+    if (desc->kind == DEV_SWITCH) {
+        return val ? 1 : 0;
+    }
+    if (val < desc->min) return desc->min;
+    if (val > desc->max) return desc->max;
+    return val;
+}
+
+int devices_state_get(const device_state_t *st, const device_desc_t *desc) {
+    const uint8_t *field = (const uint8_t *)st + desc->offset;
+    return desc->size == 1 ? *field : *(const int32_t *)field;
+}
+
+void devices_state_set(device_state_t *st, const device_desc_t *desc, int val) {
+    uint8_t *field = (uint8_t *)st + desc->offset;
+    if (desc->size == 1) {
+        *field = (uint8_t)val;
+    } else if (desc->size == 4) {
+        *(int32_t *)field = val;
+    }
+}
+
+bool devices_resolve(const control_parsed_op_t *parsed, int count, control_op_t *ops, int *bad) {
+    for (int i = 0; i < count; i++) {
+        int dev = devices_find(parsed[i].device);
+        if (dev < 0 || (devices[dev].kind != DEV_SENSOR && !parsed[i].has_value)) {
+            *bad = i;
+            return false;
+        }
+        ops[i] = (control_op_t){
+            .device = dev,
+            .value = parsed[i].value,
+            .timeout = parsed[i].timeout,
+            .speed = parsed[i].speed,
+        };
+    }
+    return true;
+}
+
+int devices_apply(device_state_t *st, const control_op_t *ops, int count, const devices_hooks_t *hooks) {
+    uint32_t set_mask = 0;
+    uint32_t clr_mask = 0;
+    int applied = 0;
+
+    for (int i = 0; i < count; i++) {
+        const device_desc_t *desc = &devices[ops[i].device];
+        int val = devices_clamp(desc, ops[i].value);
+
+        switch (desc->kind) {
+        case DEV_SERVO:
+            // Non-blocking - a move in progress is replaced from where it is
+            devices_state_set(st, desc, val);
+            hooks->servo_move(val, ops[i].speed);
+            break;
+        case DEV_LIGHT:
+            devices_state_set(st, desc, val);
+            hooks->set_light(desc->index, val);
+            ESP_LOGI(TAG, "%s set to mode %d (0=off, 1=on, 2=blink)", desc->name, val);
+            break;
+        case DEV_SWITCH:
+            devices_state_set(st, desc, val);
+            if (val) {
+                set_mask |= 1UL << desc->pin;
+            } else {
+                clr_mask |= 1UL << desc->pin;
+            }
+            break;
+        case DEV_BUZZER:
+            // Buzzer modes: 0=off, 1=alarm (nháy), 2=continuous (liên tục)
+            // Optional "timeout" for auto-off (in seconds)
+            devices_state_set(st, desc, val);
+            hooks->set_buzzer(val, ops[i].timeout);
+            ESP_LOGI(TAG, "Buzzer mode %d (timeout: %d sec)", val, ops[i].timeout);
+            break;
+        case DEV_SENSOR:
+            continue;
+        }
+        applied++;
+    }
+
+    if (set_mask || clr_mask) {
+        hooks->write_switches(set_mask, clr_mask);
+    }
+    // Persist after any device change - coalesced by the state store
+    if (applied) {
+        hooks->state_changed();
+    }
+    return applied;
+}
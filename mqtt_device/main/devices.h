@@ -0,0 +1,119 @@
+#ifndef _DEVICES_H_
+#define _DEVICES_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "control_parse.h"
+#include "outputs.h"
+
+// --- PIN DEFINITIONS ---
+// Board wiring, shared by the device table and init_hardware()
+#define PIN_SERVO      18
+#define PIN_LIGHT1     19
+#define PIN_LIGHT2     21
+#define PIN_LIGHT3     17
+#define PIN_FAN1       22  // Fan 1
+#define PIN_FAN2       23
+#define PIN_BUZZER     25
+#define PIN_DHT11      26
+
+#define DEVICE_COUNT    8
+#define CONTROL_MAX_OPS 8  // Operations accepted in one batched message
+
+// --- DEVICE STATE STRUCTURE ---
+typedef struct {
+    uint8_t light1;       // 0=off, 1=on, 2=blinking
+    uint8_t light2;       // 0=off, 1=on, 2=blinking
+    uint8_t light3;       // 0=off, 1=on, 2=blinking
+    uint8_t fan1;
+    uint8_t fan2;
+    int32_t servo_angle;
+    int32_t buzzer_mode;
+} device_state_t;
+
+typedef enum {
+    DEV_SERVO,
+    DEV_LIGHT,
+    DEV_SWITCH,
+    DEV_BUZZER,
+    DEV_SENSOR,     // Query only - no state
+} device_kind_t;
+
+typedef struct {
+    const char *name;
+    device_kind_t kind;
+    int pin;        // Switch GPIO (< 32, written through the W1TS/W1TC registers)
+    int index;      // Light index
+    int min, max;   // Value clamp range
+    uint8_t offset; // Field in device_state_t
+    uint8_t size;   // 1 (uint8_t) or 4 (int32_t), 0 = no state
+} device_desc_t;
+
+// One {device, value[, timeout][, speed]} operation, device resolved to a table index
+typedef struct {
+    int device;
+    int value;
+    int timeout;
+    int speed;      // Servo degrees per second, 0 = default
+} control_op_t;
+
+// Where an applied batch goes. Every hook is required.
+typedef struct {
+    void (*servo_move)(int angle, int speed);
+    void (*set_light)(int index, int mode);
+    void (*set_buzzer)(int mode, int timeout_sec);
+    void (*write_switches)(uint32_t set_mask, uint32_t clr_mask);   // Once per batch, if any switch
+    void (*state_changed)(void);                                    // Once per batch, if any state was set
+} devices_hooks_t;
+
+extern const device_desc_t devices[DEVICE_COUNT];
+
+/**
+ * @brief Hash the device names for devices_find()
+ */
+void devices_init(void);
+
+/**
+ * @brief Table index for a device name, -1 if unknown
+ */
+int devices_find(const char *name);
+
+/**
+ * @brief Clamp a value into the device's range (switches: any non-zero is 1)
+ */
+int devices_clamp(const device_desc_t *desc, int val);
+
+/**
+ * @brief Read / write a device's field in a state struct
+ */
+int devices_state_get(const device_state_t *st, const device_desc_t *desc);
+void devices_state_set(device_state_t *st, const device_desc_t *desc, int val);
+
+/**
+ * @brief Resolve parsed entries to table operations, all or nothing
+ *
+ * An unknown device, or a missing value for anything but the sensor,
+ * rejects the whole batch.
+ *
+ * @param parsed Entries from control_parse()
+ * @param count Number of entries
+ * @param ops Filled with count operations
+ * @param bad Index of the rejected entry on failure
+ * @return true if every entry resolved
+ */
+bool devices_resolve(const control_parsed_op_t *parsed, int count, control_op_t *ops, int *bad);
+
+/**
+ * @brief Apply a resolved batch to a state struct and the hardware hooks
+ *
+ * Values are clamped. Switches are collected into one set/clear mask
+ * pair, and state_changed fires once for the whole batch, so a scene of
+ * eight operations costs one register write pair and one store update.
+ * No locking - the caller serialises access to st.
+ *
+ * @return Number of operations that set state (sensor queries don't)
+ */
+int devices_apply(device_state_t *st, const control_op_t *ops, int count, const devices_hooks_t *hooks);
+
+#endif // _DEVICES_H_
@@ -0,0 +1,205 @@
+#include "dht11.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "driver/gpio.h"
+#include "driver/rmt_rx.h"
+#include <string.h>
+
+static const char *TAG = "DHT11";
+
+#define RMT_RESOLUTION_HZ   1000000     // 1 tick = 1us
+#define RMT_SYMBOLS         64          // Response + 40 bits + trailer fit in 43
+#define START_LOW_MS        20          // Host start signal (>= 18ms)
+#define FRAME_TIMEOUT_MS    30          // 40 bits take ~5ms
+#define SAMPLE_TASK_STACK   4096        // Headroom for the new-reading callback
+
+static int g_gpio = -1;
+static rmt_channel_handle_t g_rx_chan = NULL;
+static QueueHandle_t g_rx_queue = NULL;
+static rmt_symbol_word_t g_symbols[RMT_SYMBOLS];
+
+// Cache - written by the sampling task, read from the MQTT task
+static SemaphoreHandle_t cache_mutex = NULL;
+static dht11_sample_t g_cache;
+static bool g_cache_valid = false;
+static dht11_sample_cb_t g_callback = NULL;
+
+// Counters
+static uint32_t g_reads = 0;
+static uint32_t g_failures[DHT11_ERR_CHECKSUM + 1];
+static uint32_t g_timeouts = 0;
+
+static bool IRAM_ATTR rx_done_cb(rmt_channel_handle_t channel, const rmt_rx_done_event_data_t *edata, void *user_ctx) {
+    BaseType_t woken = pdFALSE;
+    xQueueSendFromISR((QueueHandle_t)user_ctx, edata, &woken);
+    return woken == pdTRUE;
+}
+
+// RMT symbols hold two level/duration halves - flatten them for the decoder
+static size_t flatten_symbols(const rmt_symbol_word_t *symbols, size_t count, dht11_pulse_t *pulses) {
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (symbols[i].duration0) {
+            pulses[n++] = (dht11_pulse_t){ symbols[i].level0, symbols[i].duration0 };
+        }
+        if (symbols[i].duration1) {
+            pulses[n++] = (dht11_pulse_t){ symbols[i].level1, symbols[i].duration1 };
+        }
+    }
+    return n;
+}
+
+static esp_err_t capture_frame(dht11_reading_t *out, dht11_status_t *status) {
+    rmt_receive_config_t rx_cfg = {
+        .signal_range_min_ns = 1000,        // Glitch filter
+        .signal_range_max_ns = 200 * 1000,  // Line idle high this long = frame done
+    };
+    
+    // Start signal: hold the line low, then release it and let RMT capture the reply
+    gpio_set_level(g_gpio, 0);
+    vTaskDelay(pdMS_TO_TICKS(START_LOW_MS));
+    xQueueReset(g_rx_queue);
+    esp_err_t err = rmt_receive(g_rx_chan, g_symbols, sizeof(g_symbols), &rx_cfg);
+    gpio_set_level(g_gpio, 1);
+    if (err != ESP_OK) {
+        return err;
+    }
+    
+    rmt_rx_done_event_data_t rx_data;
+    if (xQueueReceive(g_rx_queue, &rx_data, pdMS_TO_TICKS(FRAME_TIMEOUT_MS)) != pdTRUE) {
+        // Sensor never answered - the receive is still armed, disable/enable cancels it
+        rmt_disable(g_rx_chan);
+        rmt_enable(g_rx_chan);
+        return ESP_ERR_TIMEOUT;
+    }
+    
+    dht11_pulse_t pulses[RMT_SYMBOLS * 2];
+    size_t count = flatten_symbols(rx_data.received_symbols, rx_data.num_symbols, pulses);
+    *status = dht11_decode(pulses, count, out);
+    return ESP_OK;
+}
+
+static void sample_task(void *pvParameters) {
+    TickType_t last_wake = xTaskGetTickCount();
+    
+    while (1) {
+        dht11_reading_t reading;
+        dht11_status_t status = DHT11_OK;
+        esp_err_t err = capture_frame(&reading, &status);
+        g_reads++;
+        
+        if (err == ESP_ERR_TIMEOUT) {
+            g_timeouts++;
+            ESP_LOGW(TAG, "No frame from sensor");
+        } else if (err != ESP_OK) {
+            ESP_LOGE(TAG, "RMT receive failed: %s", esp_err_to_name(err));
+        } else if (status != DHT11_OK) {
+            g_failures[status]++;
+            ESP_LOGW(TAG, "Frame rejected: %s", dht11_status_name(status));
+        } else {
+            dht11_sample_t sample = {
+                .reading = reading,
+                .timestamp_us = esp_timer_get_time(),
+                .age_ms = 0,
+            };
+            xSemaphoreTake(cache_mutex, portMAX_DELAY);
+            g_cache = sample;
+            g_cache_valid = true;
+            xSemaphoreGive(cache_mutex);
+            ESP_LOGD(TAG, "Temp: %d C, Hum: %d %%", reading.temperature, reading.humidity);
+            
+            if (g_callback) {
+                g_callback(&sample);
+            }
+        }
+        
+        if (g_reads % 100 == 0) {
+            dht11_log_stats();
+        }
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(DHT11_SAMPLE_PERIOD_MS));
+    }
+}
+
+esp_err_t dht11_start(int gpio_num) {
+    g_gpio = gpio_num;
+    
+    cache_mutex = xSemaphoreCreateMutex();
+    g_rx_queue = xQueueCreate(1, sizeof(rmt_rx_done_event_data_t));
+    if (cache_mutex == NULL || g_rx_queue == NULL) {
+        ESP_LOGE(TAG, "Failed to create mutex/queue");
+        return ESP_ERR_NO_MEM;
+    }
+    
+    rmt_rx_channel_config_t chan_cfg = {
+        .gpio_num = gpio_num,
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = RMT_RESOLUTION_HZ,
+        .mem_block_symbols = RMT_SYMBOLS,
+    };
+    esp_err_t err = rmt_new_rx_channel(&chan_cfg, &g_rx_chan);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create RMT RX channel: %s", esp_err_to_name(err));
+        return err;
+    }
+    
+    rmt_rx_event_callbacks_t cbs = {
+        .on_recv_done = rx_done_cb,
+    };
+    err = rmt_rx_register_event_callbacks(g_rx_chan, &cbs, g_rx_queue);
+    if (err == ESP_OK) {
+        err = rmt_enable(g_rx_chan);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to enable RMT RX channel: %s", esp_err_to_name(err));
+        return err;
+    }
+    
+    // Open-drain so the pin can pull the line low for the start signal
+    // while RMT keeps reading it; idle released (pulled high)
+    gpio_set_direction(gpio_num, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_set_pull_mode(gpio_num, GPIO_PULLUP_ONLY);
+    gpio_set_level(gpio_num, 1);
+    
+    if (xTaskCreate(sample_task, "dht11_task", SAMPLE_TASK_STACK, NULL, 4, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create sampling task");
+        return ESP_ERR_NO_MEM;
+    }
+    
+    ESP_LOGI(TAG, "RMT sampling on GPIO %d every %d ms", gpio_num, DHT11_SAMPLE_PERIOD_MS);
+    return ESP_OK;
+}
+
+bool dht11_get_cached(dht11_sample_t *out) {
+    if (cache_mutex == NULL) {
+        return false;
+    }
+    
+    bool valid;
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    valid = g_cache_valid;
+    memcpy(out, &g_cache, sizeof(dht11_sample_t));
+    xSemaphoreGive(cache_mutex);
+    
+    if (!valid) {
+        return false;
+    }
+    int64_t age_us = esp_timer_get_time() - out->timestamp_us;
+    out->age_ms = (uint32_t)(age_us / 1000);
+    return out->age_ms <= DHT11_STALE_MS;
+}
+
+void dht11_set_callback(dht11_sample_cb_t cb) {
+    g_callback = cb;
+}
+
+void dht11_log_stats(void) {
+    ESP_LOGI(TAG, "Reads: %lu, timeouts: %lu, no response: %lu, short: %lu, timing: %lu, checksum: %lu",
+             (unsigned long)g_reads, (unsigned long)g_timeouts,
+             (unsigned long)g_failures[DHT11_ERR_NO_RESPONSE], (unsigned long)g_failures[DHT11_ERR_SHORT],
+             (unsigned long)g_failures[DHT11_ERR_TIMING], (unsigned long)g_failures[DHT11_ERR_CHECKSUM]);
+}
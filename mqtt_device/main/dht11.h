@@ -0,0 +1,56 @@
+#ifndef _DHT11_H_
+#define _DHT11_H_
+
+#include "esp_err.h"
+#include "dht11_decode.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DHT11_SAMPLE_PERIOD_MS  2000    // Sensor needs >= 1s between reads
+#define DHT11_STALE_MS          30000   // Cached reading older than this is not served
+
+// Latest validated reading
+typedef struct {
+    dht11_reading_t reading;
+    int64_t timestamp_us;   // esp_timer time of the capture
+    uint32_t age_ms;        // Filled by dht11_get_cached()
+} dht11_sample_t;
+
+/**
+ * @brief Set up the RMT receiver on the data pin and start the sampling task
+ * 
+ * The task captures one frame every DHT11_SAMPLE_PERIOD_MS through RMT
+ * (no busy-wait, unaffected by WiFi interrupts) and keeps the last reading
+ * that passed the checksum.
+ * 
+ * @param gpio_num DHT11 data pin
+ * @return ESP_OK on success
+ */
+esp_err_t dht11_start(int gpio_num);
+
+/**
+ * @brief Get the cached reading without touching the sensor
+ * 
+ * @param out Filled with the latest reading and its age
+ * @return true if a reading newer than DHT11_STALE_MS is available
+ */
+bool dht11_get_cached(dht11_sample_t *out);
+
+/**
+ * @brief Called from the sampling task after each validated reading
+ */
+typedef void (*dht11_sample_cb_t)(const dht11_sample_t *sample);
+
+/**
+ * @brief Register a callback for new readings (one, NULL to clear)
+ * 
+ * Runs on the sampling task - keep it short and non-blocking.
+ */
+void dht11_set_callback(dht11_sample_cb_t cb);
+
+/**
+ * @brief Log capture/decode counters
+ */
+void dht11_log_stats(void);
+
+#endif // _DHT11_H_
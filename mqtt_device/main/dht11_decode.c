@@ -0,0 +1,67 @@
+#include "dht11_decode.h"
+
+// Datasheet timings with margin for RMT glitch filtering and sensor spread
+#define RESPONSE_MIN_US   60
+#define RESPONSE_MAX_US   110
+#define BIT_LOW_MIN_US    30
+#define BIT_LOW_MAX_US    80
+#define BIT_HIGH_MIN_US   10
+#define BIT_HIGH_MAX_US   100
+#define BIT_ONE_US        45    // High longer than this is a 1
+
+static int in_range(uint16_t v, uint16_t min, uint16_t max) {
+    return v >= min && v <= max;
+}
+
+dht11_status_t dht11_decode(const dht11_pulse_t *pulses, size_t count, dht11_reading_t *out) {
+    // Find the response: ~80us low followed by ~80us high
+    size_t i = 0;
+    for (; i + 1 < count; i++) {
+        if (pulses[i].level == 0 && pulses[i + 1].level == 1 &&
+            in_range(pulses[i].duration_us, RESPONSE_MIN_US, RESPONSE_MAX_US) &&
+            in_range(pulses[i + 1].duration_us, RESPONSE_MIN_US, RESPONSE_MAX_US)) {
+            break;
+        }
+    }
+    if (i + 1 >= count) {
+        return DHT11_ERR_NO_RESPONSE;
+    }
+    i += 2;
+    
+    // 40 bits, each a low/high pair
+    uint8_t data[5] = {0};
+    for (int bit = 0; bit < 40; bit++, i += 2) {
+        if (i + 1 >= count) {
+            return DHT11_ERR_SHORT;
+        }
+        const dht11_pulse_t *low = &pulses[i];
+        const dht11_pulse_t *high = &pulses[i + 1];
+        if (low->level != 0 || high->level != 1 ||
+            !in_range(low->duration_us, BIT_LOW_MIN_US, BIT_LOW_MAX_US) ||
+            !in_range(high->duration_us, BIT_HIGH_MIN_US, BIT_HIGH_MAX_US)) {
+            return DHT11_ERR_TIMING;
+        }
+        if (high->duration_us > BIT_ONE_US) {
+            data[bit / 8] |= 1 << (7 - (bit % 8));
+        }
+    }
+    
+    if (data[4] != ((data[0] + data[1] + data[2] + data[3]) & 0xFF)) {
+        return DHT11_ERR_CHECKSUM;
+    }
+    
+    out->humidity = data[0];
+    out->temperature = data[2];
+    return DHT11_OK;
+}
+
+const char *dht11_status_name(dht11_status_t status) {
+    switch (status) {
+    case DHT11_OK:              return "ok";
+    case DHT11_ERR_NO_RESPONSE: return "no response";
+    case DHT11_ERR_SHORT:       return "short frame";
+    case DHT11_ERR_TIMING:      return "bad timing";
+    case DHT11_ERR_CHECKSUM:    return "checksum";
+    }
+    return "unknown";
+}
@@ -0,0 +1,46 @@
+#ifndef _DHT11_DECODE_H_
+#define _DHT11_DECODE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// One captured level and how long it lasted (RMT symbols flattened)
+typedef struct {
+    uint8_t level;
+    uint16_t duration_us;
+} dht11_pulse_t;
+
+typedef enum {
+    DHT11_OK = 0,
+    DHT11_ERR_NO_RESPONSE,  // No 80us low/high response from the sensor
+    DHT11_ERR_SHORT,        // Fewer than 40 data bits captured
+    DHT11_ERR_TIMING,       // A bit pulse outside the datasheet window
+    DHT11_ERR_CHECKSUM,
+} dht11_status_t;
+
+typedef struct {
+    int temperature;
+    int humidity;
+} dht11_reading_t;
+
+/**
+ * @brief Decode a DHT11 frame from captured pulse timings
+ * 
+ * Pure function - no hardware access, safe to build for the host.
+ * Expects the capture to start at or before the sensor's response
+ * (80us low, 80us high) followed by 40 bits of ~50us low + 26-28us
+ * high (0) or ~70us high (1).
+ * 
+ * @param pulses Captured pulses in order
+ * @param count Number of pulses
+ * @param out Filled on DHT11_OK
+ * @return DHT11_OK or the reason the frame was rejected
+ */
+dht11_status_t dht11_decode(const dht11_pulse_t *pulses, size_t count, dht11_reading_t *out);
+
+/**
+ * @brief Short name for a decode status (for logs)
+ */
+const char *dht11_status_name(dht11_status_t status);
+
+#endif // _DHT11_DECODE_H_
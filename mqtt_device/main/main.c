@@ -17,21 +17,57 @@
 #include "esp_log.h"
 #include "mqtt_client.h"
 #include "driver/gpio.h"
-#include "driver/ledc.h"
-#include "cJSON.h"
-#include "rom/ets_sys.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_mac.h"
+#include "soc/gpio_reg.h"
+#include "dht11.h"
+#include "outputs.h"
+#include "state_store.h"
+#include "control_parse.h"
+#include "devices.h"
+#include "sensor_log.h"
+#include "rules.h"
+#include "servo.h"
 
 static const char *TAG = "MQTT_DEVICE";
 
 // --- CONFIGURATION ---
 #define MQTT_BROKER    "mqtt://laihieu2714.ddns.net"
 
+// --- MQTT TOPICS ---
+// Every topic is namespaced by node id so the broker only delivers a board
+// its own commands:   home/<node>/control, home/<node>/state, ...
+// Scenes:             home/group/<group>/control, home/all/control
+// Consumers watch all boards with wildcards, e.g. home/+/state
+#define TOPIC_ROOT              "home"
+#define NODE_ID_PREFIX          "node-"         // + last 3 bytes of the STA MAC
+#define DEFAULT_NODE_GROUP      "living_room"
+#define MQTT_SUBSCRIBE_LEGACY   1               // Also take device/control while publishers (n8n) migrate -
+                                                // every board on it gets every command; set 0 once they have.
+                                                // Readings and sensor replies are mirrored to the old topics too
+#define LEGACY_TOPIC_SENSOR     "device/sensor"
+#define LEGACY_TOPIC_STATUS     "device/status"
+#define NODE_NAME_MAX           24
+
+// --- SENSOR PUBLISHING ---
+// Sampling rate is DHT11_SAMPLE_PERIOD_MS (dht11.h); these set the publish rate
+#define SENSOR_CHECK_MS         2000    // How often the cached reading is examined
+#define SENSOR_DEADBAND_TEMP    1       // Publish on a change of >= 1 C ...
+#define SENSOR_DEADBAND_HUM     2       // ... or >= 2 % humidity
+#define SENSOR_MIN_PUBLISH_MS   10000   // At most one on-change publish per 10s
+#define SENSOR_HEARTBEAT_MS     300000  // At least one publish per 5 min
+#define SENSOR_BACKFILL_BATCH   20      // Offline readings per backlog message
+#define STATS_LOG_INTERVAL_MS   60000
+
 // --- NVS KEYS ---
 #define NVS_NAMESPACE  "wifi_config"
 #define NVS_SSID_KEY   "ssid"
 #define NVS_PASS_KEY   "password"
 
 #define NVS_DEVICE_NAMESPACE "device_state"
+#define DEVICE_STATE_VERSION 1  // Bump when device_state_t changes
+// Per-key layout used before the state blob - read once to migrate
 #define NVS_LIGHT1_KEY      "light1"
 #define NVS_LIGHT2_KEY      "light2"
 #define NVS_LIGHT3_KEY      "light3"
@@ -39,124 +75,39 @@ static const char *TAG = "MQTT_DEVICE";
 #define NVS_FAN2_KEY        "fan2"
 #define NVS_SERVO_KEY       "servo"
 #define NVS_BUZZER_MODE_KEY "buzzer_mode"
-
-// --- PIN DEFINITIONS ---
-#define PIN_SERVO      18
-#define PIN_LIGHT1     19
-#define PIN_LIGHT2     21
-#define PIN_LIGHT3     17
-#define PIN_FAN1       22  // Fan 1
-#define PIN_FAN2       23
-#define PIN_BUZZER     25
-#define PIN_DHT11      26
+#define NVS_NODE_ID_KEY     "node_id"   // Overrides the MAC-derived id (serial: node <id>)
+#define NVS_GROUP_KEY       "group"     // Scene group (serial: group <name>)
+#define NVS_RULES_KEY       "rules"     // Rule set text as last pushed
 
 // --- WIFI STATUS LED ---
 #define LED_WIFI_STATUS 2  // GPIO 2 for WiFi status indicator
 
-// --- LIGHT MODES ---
-#define LIGHT_OFF      0  // Tắt
-#define LIGHT_ON       1  // Bật
-#define LIGHT_BLINKING 2  // Nhấp nháy
-
-// --- BUZZER MODES ---
-#define BUZZER_OFF        0  // Tắt
-#define BUZZER_ALARM      1  // Nháy (báo động)
-#define BUZZER_CONTINUOUS 2  // Liên tục
-
-// --- SERVO CONFIG ---
-#define SERVO_MIN_PULSEWIDTH_US 500  // Minimum pulse width in microsecond
-#define SERVO_MAX_PULSEWIDTH_US 2500 // Maximum pulse width in microsecond
-#define SERVO_MIN_DEGREE        0    // Minimum angle
-#define SERVO_MAX_DEGREE        180  // Maximum angle
-#define SERVO_TIMER             LEDC_TIMER_0
-#define SERVO_MODE              LEDC_LOW_SPEED_MODE
-#define SERVO_CHANNEL           LEDC_CHANNEL_0
-#define SERVO_DUTY_RES          LEDC_TIMER_13_BIT // Resolution of PWM duty
-#define SERVO_FREQUENCY         50                // Frequency in Hertz. Set frequency at 50Hz
-
 // --- GLOBAL VARIABLES ---
 static esp_mqtt_client_handle_t client;
 static bool wifi_connected = false;
+static volatile bool mqtt_connected = false;
 static bool config_mode = false;
 
-// --- DEVICE STATE STRUCTURE ---
-typedef struct {
-    uint8_t light1;       // 0=off, 1=on, 2=blinking
-    uint8_t light2;       // 0=off, 1=on, 2=blinking
-    uint8_t light3;       // 0=off, 1=on, 2=blinking
-    uint8_t fan1;
-    uint8_t fan2;
-    int32_t servo_angle;
-    int32_t buzzer_mode;
-} device_state_t;
+// Node identity and the topics built from it (init_topics)
+static char node_id[NODE_NAME_MAX];
+static char node_group[NODE_NAME_MAX];
+static char topic_control[64];
+static char topic_group_control[64];
+static char topic_state[64];
+static char topic_state_events[64];
+static char topic_sensor[64];
+static char topic_sensor_backlog[64];
+static char topic_status[64];
+static char topic_rules[64];
+static char topic_rules_status[64];
 
 static device_state_t device_state = {LIGHT_OFF, LIGHT_OFF, LIGHT_OFF, 0, 0, 120, BUZZER_OFF};
 
-// --- BUZZER STATE ---
-static int buzzer_timeout_sec = 0;  // 0 = no timeout
-static TaskHandle_t buzzer_task_handle = NULL;
-
-// --- LIGHT BLINKING TASK ---
-static TaskHandle_t light_blink_task_handle = NULL;
-
 // --- FORWARD DECLARATIONS ---
 static void mqtt_app_start(void);
 static void sensor_task(void *pvParameters);
-static void buzzer_task(void *pvParameters);
-static void light_blink_task(void *pvParameters);
-
-// --- DHT11 READER (Simple Bit-Banging) ---
-typedef struct {
-    int temperature;
-    int humidity;
-} dht11_reading_t;
-
-static int wait_for_state(int state, int timeout_us) {
-    int count = 0;
-    while (gpio_get_level(PIN_DHT11) == state) {
-        if (count++ > timeout_us) return -1;
-        ets_delay_us(1);
-    }
-    return count;
-}
-
-dht11_reading_t read_dht11() {
-    dht11_reading_t reading = {0, 0};
-    uint8_t data[5] = {0, 0, 0, 0, 0};
-
-    // Start signal
-    gpio_set_direction(PIN_DHT11, GPIO_MODE_OUTPUT);
-    gpio_set_level(PIN_DHT11, 0);
-    vTaskDelay(pdMS_TO_TICKS(20)); // Pull low for 20ms
-    gpio_set_level(PIN_DHT11, 1);
-    ets_delay_us(40);
-    gpio_set_direction(PIN_DHT11, GPIO_MODE_INPUT);
-
-    // Response
-    if (wait_for_state(0, 80) == -1) return reading;
-    if (wait_for_state(1, 80) == -1) return reading;
-
-    // Read 40 bits
-    for (int i = 0; i < 40; i++) {
-        if (wait_for_state(0, 50) == -1) return reading;
-        int duration = wait_for_state(1, 70);
-        if (duration == -1) return reading;
-        
-        if (duration > 28) {
-            data[i / 8] |= (1 << (7 - (i % 8)));
-        }
-    }
-
-    // Verify Checksum
-    if (data[4] == ((data[0] + data[1] + data[2] + data[3]) & 0xFF)) {
-        reading.humidity = data[0];
-        reading.temperature = data[2];
-    } else {
-        ESP_LOGW(TAG, "DHT11 Checksum Error");
-    }
-    
-    return reading;
-}
+static void buzzer_timed_out(void);
+static void servo_reached(int angle);
 
 // --- HARDWARE INIT ---
 void init_hardware() {
@@ -164,56 +115,28 @@ void init_hardware() {
     gpio_config_t io_conf = {};
     io_conf.intr_type = GPIO_INTR_DISABLE;
     io_conf.mode = GPIO_MODE_OUTPUT;
-    io_conf.pin_bit_mask = (1ULL << PIN_LIGHT1) | (1ULL << PIN_LIGHT2) | (1ULL << PIN_LIGHT3) |
-                           (1ULL << PIN_FAN1) | (1ULL << PIN_FAN2) |
+    io_conf.pin_bit_mask = (1ULL << PIN_FAN1) | (1ULL << PIN_FAN2) |
                            (1ULL << PIN_BUZZER) | (1ULL << LED_WIFI_STATUS);
     io_conf.pull_down_en = 0;
     io_conf.pull_up_en = 0;
     gpio_config(&io_conf);
 
     // Turn all off initially
-    gpio_set_level(PIN_LIGHT1, 0);
-    gpio_set_level(PIN_LIGHT2, 0);
-    gpio_set_level(PIN_LIGHT3, 0);
     gpio_set_level(PIN_FAN1, 0);
     gpio_set_level(PIN_FAN2, 0);
     gpio_set_level(PIN_BUZZER, 0);
     gpio_set_level(LED_WIFI_STATUS, 0);  // LED off initially
 
-    // Servo PWM Init
-    ledc_timer_config_t ledc_timer = {
-        .duty_resolution = SERVO_DUTY_RES,
-        .freq_hz = SERVO_FREQUENCY,
-        .speed_mode = SERVO_MODE,
-        .timer_num = SERVO_TIMER,
-        .clk_cfg = LEDC_AUTO_CLK,
-    };
-    ledc_timer_config(&ledc_timer);
-
-    ledc_channel_config_t ledc_channel = {
-        .channel = SERVO_CHANNEL,
-        .duty = 0,
-        .gpio_num = PIN_SERVO,
-        .speed_mode = SERVO_MODE,
-        .hpoint = 0,
-        .timer_sel = SERVO_TIMER,
-    };
-    ledc_channel_config(&ledc_channel);
-}
-
-// --- SERVO CONTROL ---
-void set_servo_angle(int angle) {
-    if (angle < 0) angle = 0;
-    if (angle > 180) angle = 180;
-
-    uint32_t duty = (angle * (SERVO_MAX_PULSEWIDTH_US - SERVO_MIN_PULSEWIDTH_US) / SERVO_MAX_DEGREE) + SERVO_MIN_PULSEWIDTH_US;
-    // Convert to duty cycle (resolution 13 bit = 8192)
-    // Period = 20000us (50Hz)
-    uint32_t duty_cycle = (duty * 8192) / 20000;
+    // Servo on LEDC timer 0 - moves are hardware fades, see servo.c
+    if (servo_init(PIN_SERVO, servo_reached) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to init servo fades");
+    }
 
-    ledc_set_duty(SERVO_MODE, SERVO_CHANNEL, duty_cycle);
-    ledc_update_duty(SERVO_MODE, SERVO_CHANNEL);
-    ESP_LOGI(TAG, "Servo set to %d degrees", angle);
+    // Lights on LEDC (blink in hardware), buzzer patterns on esp_timer
+    const int light_pins[LIGHT_COUNT] = {PIN_LIGHT1, PIN_LIGHT2, PIN_LIGHT3};
+    if (outputs_init(light_pins, PIN_BUZZER, buzzer_timed_out) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to init light/buzzer outputs");
+    }
 }
 
 // --- WIFI HELPER ---
@@ -308,37 +231,96 @@ static bool save_wifi_credentials(const char *ssid, const char *password) {
     return false;
 }
 
-// --- DEVICE STATE NVS FUNCTIONS ---
-// Save device state to NVS
-static bool save_device_state(void) {
+// --- NODE IDENTITY ---
+static void load_node_string(nvs_handle_t nvs_handle, const char *key, char *out, size_t size) {
+    size_t len = size;
+    if (nvs_get_str(nvs_handle, key, out, &len) != ESP_OK) {
+        out[0] = '\0';
+    }
+}
+
+static bool save_node_string(const char *key, const char *value) {
     nvs_handle_t nvs_handle;
     esp_err_t err = nvs_open(NVS_DEVICE_NAMESPACE, NVS_READWRITE, &nvs_handle);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS for device state");
         return false;
     }
-
-    // Save each device state
-    nvs_set_u8(nvs_handle, NVS_LIGHT1_KEY, device_state.light1);
-    nvs_set_u8(nvs_handle, NVS_LIGHT2_KEY, device_state.light2);
-    nvs_set_u8(nvs_handle, NVS_LIGHT3_KEY, device_state.light3);
-    nvs_set_u8(nvs_handle, NVS_FAN1_KEY, device_state.fan1);
-    nvs_set_u8(nvs_handle, NVS_FAN2_KEY, device_state.fan2);
-    nvs_set_i32(nvs_handle, NVS_SERVO_KEY, device_state.servo_angle);
-    nvs_set_i32(nvs_handle, NVS_BUZZER_MODE_KEY, device_state.buzzer_mode);
-
-    err = nvs_commit(nvs_handle);
+    err = nvs_set_str(nvs_handle, key, value);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
     nvs_close(nvs_handle);
+    return err == ESP_OK;
+}
 
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Device state saved to NVS");
-        return true;
+// Node id and group from NVS, falling back to the MAC and DEFAULT_NODE_GROUP
+static void init_topics(void) {
+    node_id[0] = '\0';
+    node_group[0] = '\0';
+    nvs_handle_t nvs_handle;
+    if (nvs_open(NVS_DEVICE_NAMESPACE, NVS_READONLY, &nvs_handle) == ESP_OK) {
+        load_node_string(nvs_handle, NVS_NODE_ID_KEY, node_id, sizeof(node_id));
+        load_node_string(nvs_handle, NVS_GROUP_KEY, node_group, sizeof(node_group));
+        nvs_close(nvs_handle);
     }
-    return false;
+    if (node_id[0] == '\0') {
+        uint8_t mac[6] = {0};
+        esp_read_mac(mac, ESP_MAC_WIFI_STA);
+        snprintf(node_id, sizeof(node_id), NODE_ID_PREFIX "%02x%02x%02x", mac[3], mac[4], mac[5]);
+    }
+    if (node_group[0] == '\0') {
+        snprintf(node_group, sizeof(node_group), "%s", DEFAULT_NODE_GROUP);
+    }
+    
+    snprintf(topic_control, sizeof(topic_control), TOPIC_ROOT "/%s/control", node_id);
+    snprintf(topic_group_control, sizeof(topic_group_control), TOPIC_ROOT "/group/%s/control", node_group);
+    snprintf(topic_state, sizeof(topic_state), TOPIC_ROOT "/%s/state", node_id);
+    snprintf(topic_state_events, sizeof(topic_state_events), TOPIC_ROOT "/%s/state/events", node_id);
+    snprintf(topic_sensor, sizeof(topic_sensor), TOPIC_ROOT "/%s/sensor", node_id);
+    snprintf(topic_sensor_backlog, sizeof(topic_sensor_backlog), TOPIC_ROOT "/%s/sensor/backlog", node_id);
+    snprintf(topic_status, sizeof(topic_status), TOPIC_ROOT "/%s/status", node_id);
+    snprintf(topic_rules, sizeof(topic_rules), TOPIC_ROOT "/%s/rules", node_id);
+    snprintf(topic_rules_status, sizeof(topic_rules_status), TOPIC_ROOT "/%s/rules/status", node_id);
+    ESP_LOGI(TAG, "Node: %s (group %s), control topic: %s", node_id, node_group, topic_control);
+    ESP_LOGI(TAG, "Rename over serial at any time: node <id> / group <name>, then restart");
+#if MQTT_SUBSCRIBE_LEGACY
+    ESP_LOGW(TAG, "*** Legacy device/control still subscribed - move publishers to %s ***", topic_control);
+    ESP_LOGW(TAG, "*** Readings also go to " LEGACY_TOPIC_SENSOR " and " LEGACY_TOPIC_STATUS " ***");
+#else
+    ESP_LOGW(TAG, "*** device/control is NOT subscribed - commands published there are ignored ***");
+#endif
+}
+
+// Topic-safe name: letters, digits, '-' and '_' only
+static bool valid_node_name(const char *name) {
+    size_t len = strlen(name);
+    if (len == 0 || len >= NODE_NAME_MAX) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        char c = name[i];
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// --- DEVICE STATE NVS FUNCTIONS ---
+static void log_device_state(void) {
+    ESP_LOGI(TAG, "  Light1=%d, Light2=%d, Light3=%d", device_state.light1, device_state.light2, device_state.light3);
+    ESP_LOGI(TAG, "  Fan1=%d, Fan2=%d", device_state.fan1, device_state.fan2);
+    ESP_LOGI(TAG, "  Servo=%ld, Buzzer=%ld", (long)device_state.servo_angle, (long)device_state.buzzer_mode);
 }
 
 // Load device state from NVS
 static bool load_device_state(void) {
+    if (state_store_load()) {
+        ESP_LOGI(TAG, "Device state loaded from NVS");
+        log_device_state();
+        return true;
+    }
+
     nvs_handle_t nvs_handle;
     esp_err_t err = nvs_open(NVS_DEVICE_NAMESPACE, NVS_READONLY, &nvs_handle);
     if (err != ESP_OK) {
@@ -346,7 +328,7 @@ static bool load_device_state(void) {
         return false;
     }
 
-    // Load each device state (use current value as default if not found)
+    // No blob yet - read the old per-key layout (use current value as default if not found)
     nvs_get_u8(nvs_handle, NVS_LIGHT1_KEY, &device_state.light1);
     nvs_get_u8(nvs_handle, NVS_LIGHT2_KEY, &device_state.light2);
     nvs_get_u8(nvs_handle, NVS_LIGHT3_KEY, &device_state.light3);
@@ -356,30 +338,22 @@ static bool load_device_state(void) {
     nvs_get_i32(nvs_handle, NVS_BUZZER_MODE_KEY, &device_state.buzzer_mode);
 
     nvs_close(nvs_handle);
-    ESP_LOGI(TAG, "Device state loaded from NVS");
-    ESP_LOGI(TAG, "  Light1=%d, Light2=%d, Light3=%d", device_state.light1, device_state.light2, device_state.light3);
-    ESP_LOGI(TAG, "  Fan1=%d, Fan2=%d", device_state.fan1, device_state.fan2);
-    ESP_LOGI(TAG, "  Servo=%ld, Buzzer=%ld", (long)device_state.servo_angle, (long)device_state.buzzer_mode);
+    state_store_mark_dirty();  // Rewrite as a blob
+    ESP_LOGI(TAG, "Device state migrated from per-key NVS layout");
+    log_device_state();
     return true;
 }
 
 // Apply loaded device state to hardware
 static void apply_device_state(void) {
-    // Lights will be controlled by light_blink_task based on their mode
-    // Only set static states here (OFF or ON), blinking is handled by task
-    if (device_state.light1 == LIGHT_OFF) gpio_set_level(PIN_LIGHT1, 0);
-    else if (device_state.light1 == LIGHT_ON) gpio_set_level(PIN_LIGHT1, 1);
-    
-    if (device_state.light2 == LIGHT_OFF) gpio_set_level(PIN_LIGHT2, 0);
-    else if (device_state.light2 == LIGHT_ON) gpio_set_level(PIN_LIGHT2, 1);
-    
-    if (device_state.light3 == LIGHT_OFF) gpio_set_level(PIN_LIGHT3, 0);
-    else if (device_state.light3 == LIGHT_ON) gpio_set_level(PIN_LIGHT3, 1);
+    outputs_set_light(0, device_state.light1);
+    outputs_set_light(1, device_state.light2);
+    outputs_set_light(2, device_state.light3);
     
     gpio_set_level(PIN_FAN1, device_state.fan1);
     gpio_set_level(PIN_FAN2, device_state.fan2);
-    set_servo_angle(device_state.servo_angle);
-    // Note: buzzer_mode will be applied by buzzer_task
+    servo_set_immediate(device_state.servo_angle);  // Position unknown at boot
+    outputs_set_buzzer(device_state.buzzer_mode, 0);  // Timeout is not persisted
     ESP_LOGI(TAG, "Device state applied to hardware");
 }
 
@@ -419,83 +393,343 @@ void wifi_init_sta(void) {
     esp_wifi_start();
 }
 
-// --- LIGHT BLINKING TASK ---
-static void light_blink_task(void *pvParameters) {
-    bool blink_state = false;
-    
-    while (1) {
-        // Toggle blink state every 500ms
-        blink_state = !blink_state;
-        
-        // Light 1
-        if (device_state.light1 == LIGHT_OFF) {
-            gpio_set_level(PIN_LIGHT1, 0);
-        } else if (device_state.light1 == LIGHT_ON) {
-            gpio_set_level(PIN_LIGHT1, 1);
-        } else if (device_state.light1 == LIGHT_BLINKING) {
-            gpio_set_level(PIN_LIGHT1, blink_state ? 1 : 0);
-        }
-        
-        // Light 2
-        if (device_state.light2 == LIGHT_OFF) {
-            gpio_set_level(PIN_LIGHT2, 0);
-        } else if (device_state.light2 == LIGHT_ON) {
-            gpio_set_level(PIN_LIGHT2, 1);
-        } else if (device_state.light2 == LIGHT_BLINKING) {
-            gpio_set_level(PIN_LIGHT2, blink_state ? 1 : 0);
+// --- DEVICE CONTROL ---
+// Device table, resolve and batched apply live in devices.c (host-tested)
+static SemaphoreHandle_t control_mutex = NULL;
+
+// Device state events: retained full snapshot + per-change diffs, both
+// stamped with seq so consumers can spot a missed diff and resync
+static uint32_t state_seq = 0;
+static uint32_t boot_id = 0;    // Random per boot - seq restarts at 0
+
+// Dispatch cost, parse through apply (logged once a minute)
+static uint32_t dispatch_messages = 0;
+static uint32_t dispatch_ops = 0;
+static uint32_t dispatch_rejected = 0;
+static int64_t dispatch_total_us = 0;
+static int64_t dispatch_max_us = 0;
+
+static void control_init(void) {
+    devices_init();
+    control_mutex = xSemaphoreCreateMutex();
+    boot_id = esp_random();
+}
+
+// {"seq":N,"boot":B,<name>:<value>...} - all devices, or only those that
+// differ from `before`. Returns the number of devices written.
+static int format_state(char *buf, size_t size, const device_state_t *st, const device_state_t *before) {
+    int len = snprintf(buf, size, "{\"seq\":%lu,\"boot\":%lu", (unsigned long)state_seq, (unsigned long)boot_id);
+    int written = 0;
+    for (int i = 0; i < DEVICE_COUNT; i++) {
+        const device_desc_t *desc = &devices[i];
+        if (desc->size == 0) {
+            continue;
         }
-        
-        // Light 3
-        if (device_state.light3 == LIGHT_OFF) {
-            gpio_set_level(PIN_LIGHT3, 0);
-        } else if (device_state.light3 == LIGHT_ON) {
-            gpio_set_level(PIN_LIGHT3, 1);
-        } else if (device_state.light3 == LIGHT_BLINKING) {
-            gpio_set_level(PIN_LIGHT3, blink_state ? 1 : 0);
+        int val = devices_state_get(st, desc);
+        if (before && devices_state_get(before, desc) == val) {
+            continue;
         }
-        
-        vTaskDelay(pdMS_TO_TICKS(500));  // Blink every 500ms
+        len += snprintf(buf + len, size - len, ",\"%s\":%d", desc->name, val);
+        written++;
+    }
+    // "servo" is the target; servo_pos is where the fade has got to
+    if (before == NULL || st->servo_angle != before->servo_angle) {
+        len += snprintf(buf + len, size - len, ",\"servo_pos\":%d,\"servo_moving\":%s",
+                        servo_get_angle(), servo_is_moving() ? "true" : "false");
+    }
+    snprintf(buf + len, size - len, "}");
+    return written;
+}
+
+// Caller holds control_mutex. Enqueued, not published - this runs on the
+// MQTT task and the esp_timer task, neither of which should block on the socket.
+static void publish_snapshot_locked(void) {
+    char payload[256];
+    format_state(payload, sizeof(payload), &device_state, NULL);
+    if (client != NULL) {
+        esp_mqtt_client_enqueue(client, topic_state, payload, 0, 1, 1, true);
+    }
+}
+
+static void publish_state_change_locked(const device_state_t *before) {
+    if (memcmp(before, &device_state, sizeof(device_state_t)) == 0) {
+        return;  // Re-sent value, nothing changed
+    }
+    state_seq++;
+    if (client == NULL || !mqtt_connected) {
+        return;  // Consumers resync from the snapshot sent on connect
+    }
+    char payload[256];
+    format_state(payload, sizeof(payload), &device_state, before);
+    esp_mqtt_client_enqueue(client, topic_state_events, payload, 0, 0, 0, true);
+    publish_snapshot_locked();
+}
+
+static void publish_snapshot(void) {
+    xSemaphoreTake(control_mutex, portMAX_DELAY);
+    publish_snapshot_locked();
+    xSemaphoreGive(control_mutex);
+}
+
+// Hardware side of devices_apply()
+static void write_switches(uint32_t set_mask, uint32_t clr_mask) {
+    if (set_mask) {
+        REG_WRITE(GPIO_OUT_W1TS_REG, set_mask);
+    }
+    if (clr_mask) {
+        REG_WRITE(GPIO_OUT_W1TC_REG, clr_mask);
+    }
+}
+
+static const devices_hooks_t device_hooks = {
+    .servo_move = servo_move,
+    .set_light = outputs_set_light,
+    .set_buzzer = outputs_set_buzzer,
+    .write_switches = write_switches,
+    .state_changed = state_store_mark_dirty,
+};
+
+// Apply a validated batch under one lock: switches land in a single
+// register write pair, and the state store sees one change
+static void apply_ops(const control_op_t *ops, int count) {
+    xSemaphoreTake(control_mutex, portMAX_DELAY);
+    device_state_t before = device_state;
+    devices_apply(&device_state, ops, count, &device_hooks);
+    publish_state_change_locked(&before);
+    xSemaphoreGive(control_mutex);
+}
+
+// Servo move finished (servo task) - report the final position. The
+// target is already in device_state, so this is an event without a diff.
+static void servo_reached(int angle) {
+    if (control_mutex == NULL) {
+        return;
+    }
+    xSemaphoreTake(control_mutex, portMAX_DELAY);
+    state_seq++;
+    if (client != NULL && mqtt_connected) {
+        char payload[96];
+        snprintf(payload, sizeof(payload), "{\"seq\":%lu,\"boot\":%lu,\"servo_pos\":%d,\"servo_moving\":false}",
+                 (unsigned long)state_seq, (unsigned long)boot_id, angle);
+        esp_mqtt_client_enqueue(client, topic_state_events, payload, 0, 0, 0, true);
+        publish_snapshot_locked();
+    }
+    xSemaphoreGive(control_mutex);
+}
+
+// Buzzer auto-off fired (esp_timer task) - persist and report the new mode
+static void buzzer_timed_out(void) {
+    xSemaphoreTake(control_mutex, portMAX_DELAY);
+    device_state_t before = device_state;
+    device_state.buzzer_mode = BUZZER_OFF;
+    publish_state_change_locked(&before);
+    xSemaphoreGive(control_mutex);
+    state_store_mark_dirty();
+}
+
+// Answer from the sampling task's cache - never block the MQTT task on the sensor
+static void publish_sensor_reply(void) {
+    dht11_sample_t sample;
+    if (dht11_get_cached(&sample)) {
+        char payload[100];
+        ESP_LOGI(TAG, "Temp: %d C, Hum: %d %% (age %lu ms)", sample.reading.temperature,
+                 sample.reading.humidity, (unsigned long)sample.age_ms);
+        snprintf(payload, sizeof(payload), "{\"temp\": %d, \"hum\": %d, \"age_ms\": %lu}",
+                 sample.reading.temperature, sample.reading.humidity, (unsigned long)sample.age_ms);
+        esp_mqtt_client_publish(client, topic_status, payload, 0, 0, 0);
+#if MQTT_SUBSCRIBE_LEGACY
+        esp_mqtt_client_publish(client, LEGACY_TOPIC_STATUS, payload, 0, 0, 0);  // n8n {"device":"sensor"} reply
+#endif
+    } else {
+        ESP_LOGW(TAG, "No recent DHT11 reading");
     }
 }
 
-// --- BUZZER TASK ---
-static void buzzer_task(void *pvParameters) {
-    int elapsed_sec = 0;
+// --- LOCAL RULES ---
+// Threshold/hysteresis/hold rules over the DHT11 reading and device state,
+// evaluated on the board the moment a reading or command arrives - no
+// broker or n8n round trip. Pushed as text to home/<node>/rules (see rules.h),
+// kept in NVS, result reported on home/<node>/rules/status.
+#define RULE_INPUT_TEMP     0
+#define RULE_INPUT_HUM      1
+#define RULE_INPUT_DEVICE   2           // + device table index
+#define RULE_INPUTS         (RULE_INPUT_DEVICE + DEVICE_COUNT)
+
+static rule_set_t rule_set;
+static rule_set_t rule_scratch;         // Parse target for pushed rules (MQTT task)
+static char rules_text[RULES_TEXT_MAX + 1];
+static SemaphoreHandle_t rules_mutex = NULL;
+static uint32_t rules_fired = 0;
+static int64_t rules_last_reaction_us = 0;
+static int64_t rules_max_reaction_us = 0;
+
+static int resolve_rule_source(const char *name) {
+    if (strcmp(name, "temp") == 0) return RULE_INPUT_TEMP;
+    if (strcmp(name, "hum") == 0) return RULE_INPUT_HUM;
+    int dev = devices_find(name);
+    return (dev >= 0 && devices[dev].size) ? RULE_INPUT_DEVICE + dev : -1;
+}
+
+static int resolve_rule_target(const char *name) {
+    int dev = devices_find(name);
+    return (dev >= 0 && devices[dev].size) ? dev : -1;
+}
+
+// trigger_us: when the input that caused this pass arrived, for reaction time.
+// Rule actions go through apply_ops() but don't re-run the rules.
+static void run_rules(const dht11_sample_t *sample, int64_t trigger_us) {
+    int inputs[RULE_INPUTS];
+    bool valid[RULE_INPUTS] = {false};
+    rule_action_t actions[RULES_MAX];
+    control_op_t ops[RULES_MAX];
     
-    while (1) {
-        if (device_state.buzzer_mode == BUZZER_OFF) {
-            gpio_set_level(PIN_BUZZER, 0);
-            elapsed_sec = 0;
-            vTaskDelay(pdMS_TO_TICKS(100));
-            continue;
+    if (rule_set.count == 0) {
+        return;
+    }
+    
+    dht11_sample_t cached;
+    if (sample == NULL && dht11_get_cached(&cached)) {
+        sample = &cached;
+    }
+    if (sample) {
+        inputs[RULE_INPUT_TEMP] = sample->reading.temperature;
+        inputs[RULE_INPUT_HUM] = sample->reading.humidity;
+        valid[RULE_INPUT_TEMP] = valid[RULE_INPUT_HUM] = true;
+    }
+    
+    xSemaphoreTake(control_mutex, portMAX_DELAY);
+    for (int i = 0; i < DEVICE_COUNT; i++) {
+        if (devices[i].size) {
+            inputs[RULE_INPUT_DEVICE + i] = devices_state_get(&device_state, &devices[i]);
+            valid[RULE_INPUT_DEVICE + i] = true;
         }
-        
-        // Check timeout
-        if (buzzer_timeout_sec > 0 && elapsed_sec >= buzzer_timeout_sec) {
-            ESP_LOGI(TAG, "Buzzer timeout reached (%d sec)", buzzer_timeout_sec);
-            device_state.buzzer_mode = BUZZER_OFF;
-            gpio_set_level(PIN_BUZZER, 0);
-            elapsed_sec = 0;
-            save_device_state();  // Save state after timeout
-            continue;
+    }
+    xSemaphoreGive(control_mutex);
+    
+    xSemaphoreTake(rules_mutex, portMAX_DELAY);
+    int n = rules_evaluate(&rule_set, inputs, RULE_INPUTS, valid, esp_timer_get_time(), actions, RULES_MAX);
+    for (int i = 0; i < n; i++) {
+        ops[i] = (control_op_t){ .device = actions[i].target, .value = actions[i].value, .timeout = 0, .speed = 0 };
+        ESP_LOGI(TAG, "Rule %s -> %s = %d", rule_set.rules[actions[i].rule].id,
+                 devices[actions[i].target].name, actions[i].value);
+    }
+    xSemaphoreGive(rules_mutex);
+    
+    if (n > 0) {
+        apply_ops(ops, n);
+        rules_fired += n;
+        rules_last_reaction_us = esp_timer_get_time() - trigger_us;
+        if (rules_last_reaction_us > rules_max_reaction_us) {
+            rules_max_reaction_us = rules_last_reaction_us;
         }
+    }
+}
+
+// DHT11 sampling task - a fresh reading is evaluated immediately
+static void on_sensor_sample(const dht11_sample_t *sample) {
+    run_rules(sample, sample->timestamp_us);
+}
+
+static void handle_rules(const char *data, int len) {
+    char status[48];
+    int bad_line = 0;
+    int count = rules_parse(data, len, &rule_scratch, resolve_rule_source, resolve_rule_target, &bad_line);
+    
+    if (count < 0) {
+        snprintf(status, sizeof(status), "error line %d", bad_line);
+        ESP_LOGW(TAG, "Rules rejected (line %d)", bad_line);
+    } else {
+        xSemaphoreTake(rules_mutex, portMAX_DELAY);
+        rule_set = rule_scratch;
+        xSemaphoreGive(rules_mutex);
         
-        if (device_state.buzzer_mode == BUZZER_ALARM) {
-            // Nháy: 200ms ON, 200ms OFF
-            gpio_set_level(PIN_BUZZER, 1);
-            vTaskDelay(pdMS_TO_TICKS(200));
-            gpio_set_level(PIN_BUZZER, 0);
-            vTaskDelay(pdMS_TO_TICKS(200));
-            elapsed_sec++;  // ~400ms per cycle, approximate
-        } else if (device_state.buzzer_mode == BUZZER_CONTINUOUS) {
-            // Liên tục
-            gpio_set_level(PIN_BUZZER, 1);
-            vTaskDelay(pdMS_TO_TICKS(1000));
-            elapsed_sec++;
+        memcpy(rules_text, data, len);
+        rules_text[len] = '\0';
+        if (!save_node_string(NVS_RULES_KEY, rules_text)) {
+            ESP_LOGE(TAG, "Failed to save rules to NVS");
+        }
+        snprintf(status, sizeof(status), "ok %d", count);
+        ESP_LOGI(TAG, "Loaded %d rules", count);
+        run_rules(NULL, esp_timer_get_time());
+    }
+    esp_mqtt_client_enqueue(client, topic_rules_status, status, 0, 1, 0, true);
+}
+
+static void rules_init(void) {
+    rules_mutex = xSemaphoreCreateMutex();
+    
+    nvs_handle_t nvs_handle;
+    if (nvs_open(NVS_DEVICE_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return;
+    }
+    load_node_string(nvs_handle, NVS_RULES_KEY, rules_text, sizeof(rules_text));
+    nvs_close(nvs_handle);
+    
+    int bad_line = 0;
+    int count = rules_parse(rules_text, strlen(rules_text), &rule_set, resolve_rule_source, resolve_rule_target, &bad_line);
+    if (count < 0) {
+        ESP_LOGW(TAG, "Stored rules invalid (line %d), none active", bad_line);
+        rule_set.count = 0;
+    } else if (count > 0) {
+        ESP_LOGI(TAG, "Loaded %d rules from NVS", count);
+    }
+}
+
+static void rules_log_stats(void) {
+    ESP_LOGI(TAG, "Rules: %d active, %lu fired, reaction last %lld us, max %lld us",
+             rule_set.count, (unsigned long)rules_fired,
+             (long long)rules_last_reaction_us, (long long)rules_max_reaction_us);
+}
+
+// Control payload: one {"device", "value"[, "timeout"]} object, or an array of
+// them applied together (e.g. a scene: all lights off + fan on in one message).
+// Any invalid entry rejects the whole batch.
+static void handle_control(const char *data, int len) {
+    int64_t start = esp_timer_get_time();
+    control_parsed_op_t parsed[CONTROL_MAX_OPS];
+    control_op_t ops[CONTROL_MAX_OPS];
+    int count = 0;
+    
+    // Fixed-schema tokenizer on the stack - no heap per message
+    control_parse_status_t status = control_parse(data, len, parsed, CONTROL_MAX_OPS, &count);
+    if (status != CONTROL_PARSE_OK) {
+        dispatch_rejected++;
+        ESP_LOGW(TAG, "Rejected control message: %s", control_parse_status_name(status));
+        return;
+    }
+    int bad = 0;
+    if (!devices_resolve(parsed, count, ops, &bad)) {
+        dispatch_rejected++;
+        ESP_LOGW(TAG, "Rejected control message: bad entry %d (%s)", bad, parsed[bad].device);
+        return;
+    }
+    
+    apply_ops(ops, count);
+    run_rules(NULL, start);  // Rules may watch device state
+    
+    int64_t elapsed = esp_timer_get_time() - start;
+    dispatch_messages++;
+    dispatch_ops += count;
+    dispatch_total_us += elapsed;
+    if (elapsed > dispatch_max_us) {
+        dispatch_max_us = elapsed;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        if (devices[ops[i].device].kind == DEV_SENSOR) {
+            publish_sensor_reply();
+            break;
         }
     }
 }
 
+static void dispatch_log_stats(void) {
+    ESP_LOGI(TAG, "Dispatch: %lu messages, %lu ops, %lu rejected, avg %lld us, max %lld us",
+             (unsigned long)dispatch_messages, (unsigned long)dispatch_ops, (unsigned long)dispatch_rejected,
+             dispatch_messages ? (long long)(dispatch_total_us / dispatch_messages) : 0LL,
+             (long long)dispatch_max_us);
+}
+
 // --- MQTT HANDLER ---
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data) {
     esp_mqtt_event_handle_t event = event_data;
@@ -504,102 +738,35 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     switch ((esp_mqtt_event_id_t)event_id) {
     case MQTT_EVENT_CONNECTED:
         ESP_LOGI(TAG, "MQTT Connected");
+        mqtt_connected = true;
+        esp_mqtt_client_subscribe(client, topic_control, 0);
+        esp_mqtt_client_subscribe(client, topic_group_control, 0);
+        esp_mqtt_client_subscribe(client, TOPIC_ROOT "/all/control", 0);
+        esp_mqtt_client_subscribe(client, topic_rules, 1);
+#if MQTT_SUBSCRIBE_LEGACY
         esp_mqtt_client_subscribe(client, "device/control", 0);
+#endif
+        publish_snapshot();
+        break;
+    case MQTT_EVENT_DISCONNECTED:
+        ESP_LOGW(TAG, "MQTT Disconnected - buffering sensor readings");
+        mqtt_connected = false;
         break;
     case MQTT_EVENT_DATA:
         ESP_LOGI(TAG, "MQTT Data received");
         printf("TOPIC=%.*s\r\n", event->topic_len, event->topic);
         printf("DATA=%.*s\r\n", event->data_len, event->data);
 
-        // Parse JSON
-        cJSON *root = cJSON_ParseWithLength(event->data, event->data_len);
-        if (root) {
-            cJSON *device = cJSON_GetObjectItem(root, "device");
-            cJSON *value = cJSON_GetObjectItem(root, "value");
-
-            if (cJSON_IsString(device) && cJSON_IsNumber(value)) {
-                const char *dev_name = device->valuestring;
-                int val = value->valueint;
-                bool state_changed = false;
-
-                if (strcmp(dev_name, "servo") == 0) {
-                    // Limit servo range 120-180 as requested
-                    if (val < 120) val = 120;
-                    if (val > 180) val = 180;
-                    device_state.servo_angle = val;
-                    set_servo_angle(val);
-                    state_changed = true;
-                } 
-                else if (strcmp(dev_name, "light1") == 0) {
-                    // Light modes: 0=off, 1=on, 2=blinking
-                    if (val < 0) val = 0;
-                    if (val > 2) val = 2;
-                    device_state.light1 = val;
-                    state_changed = true;
-                    ESP_LOGI(TAG, "Light1 set to mode %d (0=off, 1=on, 2=blink)", val);
-                }
-                else if (strcmp(dev_name, "light2") == 0) {
-                    // Light modes: 0=off, 1=on, 2=blinking
-                    if (val < 0) val = 0;
-                    if (val > 2) val = 2;
-                    device_state.light2 = val;
-                    state_changed = true;
-                    ESP_LOGI(TAG, "Light2 set to mode %d (0=off, 1=on, 2=blink)", val);
-                }
-                else if (strcmp(dev_name, "light3") == 0) {
-                    // Light modes: 0=off, 1=on, 2=blinking
-                    if (val < 0) val = 0;
-                    if (val > 2) val = 2;
-                    device_state.light3 = val;
-                    state_changed = true;
-                    ESP_LOGI(TAG, "Light3 set to mode %d (0=off, 1=on, 2=blink)", val);
-                }
-                else if (strcmp(dev_name, "fan1") == 0) {
-                    device_state.fan1 = val ? 1 : 0;
-                    gpio_set_level(PIN_FAN1, device_state.fan1);
-                    state_changed = true;
-                }
-                else if (strcmp(dev_name, "fan2") == 0) {
-                    device_state.fan2 = val ? 1 : 0;
-                    gpio_set_level(PIN_FAN2, device_state.fan2);
-                    state_changed = true;
-                }
-                else if (strcmp(dev_name, "buzzer") == 0) {
-                    // Buzzer modes: 0=off, 1=alarm (nháy), 2=continuous (liên tục)
-                    // Optional "timeout" field for auto-off (in seconds)
-                    cJSON *timeout = cJSON_GetObjectItem(root, "timeout");
-                    
-                    device_state.buzzer_mode = val;
-                    buzzer_timeout_sec = (timeout && cJSON_IsNumber(timeout)) ? timeout->valueint : 0;
-                    state_changed = true;
-                    
-                    if (device_state.buzzer_mode == BUZZER_OFF) {
-                        ESP_LOGI(TAG, "Buzzer OFF");
-                    } else if (device_state.buzzer_mode == BUZZER_ALARM) {
-                        ESP_LOGI(TAG, "Buzzer ALARM mode (timeout: %d sec)", buzzer_timeout_sec);
-                    } else if (device_state.buzzer_mode == BUZZER_CONTINUOUS) {
-                        ESP_LOGI(TAG, "Buzzer CONTINUOUS mode (timeout: %d sec)", buzzer_timeout_sec);
-                    }
-                }
-                
-                // Save state to NVS after any device change
-                if (state_changed) {
-                    save_device_state();
-                }
-                else if (strcmp(dev_name, "sensor") == 0) {
-                    // Read DHT11 on demand
-                    dht11_reading_t reading = read_dht11();
-                    if (reading.temperature > 0 && reading.humidity > 0) {
-                        char payload[100];
-                        ESP_LOGI(TAG, "Temp: %d C, Hum: %d %%", reading.temperature, reading.humidity);
-                        snprintf(payload, sizeof(payload), "{\"temp\": %d, \"hum\": %d}", reading.temperature, reading.humidity);
-                        esp_mqtt_client_publish(client, "device/status", payload, 0, 0, 0);
-                    } else {
-                        ESP_LOGW(TAG, "Failed to read DHT11");
-                    }
-                }
+        if (event->topic_len == (int)strlen(topic_rules) &&
+            memcmp(event->topic, topic_rules, event->topic_len) == 0) {
+            handle_rules(event->data, event->data_len);
+        } else {
+#if MQTT_SUBSCRIBE_LEGACY
+            if (event->topic_len == 14 && memcmp(event->topic, "device/control", 14) == 0) {
+                ESP_LOGW(TAG, "Command on legacy device/control - publish to %s instead", topic_control);
             }
-            cJSON_Delete(root);
+#endif
+            handle_control(event->data, event->data_len);
         }
         break;
     default:
@@ -614,13 +781,9 @@ static void serial_config_task(void *pvParameters) {
     
     ESP_LOGI(TAG, "Serial config task started");
     
+    // Always listening - node/group are set on boards that are already
+    // online, and wifi can be re-entered without waiting for config mode
     while (1) {
-        // Only listen when in config mode
-        if (!config_mode) {
-            vTaskDelay(pdMS_TO_TICKS(1000));
-            continue;
-        }
-        
         int c = fgetc(stdin);
         if (c == EOF) {
             vTaskDelay(pdMS_TO_TICKS(10));
@@ -754,7 +917,6 @@ static void serial_config_task(void *pvParameters) {
                                 if (wifi_connected && client == NULL) {
                                     ESP_LOGI(TAG, "WiFi connected! Starting MQTT and sensors...");
                                     mqtt_app_start();
-                                    xTaskCreate(sensor_task, "sensor_task", 4096, NULL, 5, NULL);
                                 }
                             } else {
                                 ESP_LOGE(TAG, "Failed to save WiFi credentials");
@@ -762,8 +924,21 @@ static void serial_config_task(void *pvParameters) {
                     } else {
                         ESP_LOGW(TAG, "Invalid credentials. SSID or password is empty");
                     }
+                } else if (strncmp(line, "node ", 5) == 0 || strncmp(line, "group ", 6) == 0) {
+                    // node <id> / group <name> - takes effect on the next boot
+                    bool is_node = line[0] == 'n';
+                    char *name = line + (is_node ? 5 : 6);
+                    while (*name == ' ') name++;
+                    
+                    if (!valid_node_name(name)) {
+                        ESP_LOGW(TAG, "Invalid name. Use letters, digits, '-' or '_' (max %d)", NODE_NAME_MAX - 1);
+                    } else if (save_node_string(is_node ? NVS_NODE_ID_KEY : NVS_GROUP_KEY, name)) {
+                        ESP_LOGI(TAG, "%s saved: %s (restart to apply)", is_node ? "Node id" : "Group", name);
+                    } else {
+                        ESP_LOGE(TAG, "Failed to save %s", is_node ? "node id" : "group");
+                    }
                 } else {
-                    ESP_LOGW(TAG, "Unknown command. Use: wifi \"ssid\" password or wifi ssid password");
+                    ESP_LOGW(TAG, "Unknown command. Use: wifi \"ssid\" password, node <id> or group <name>");
                 }
                 
                 pos = 0;
@@ -775,27 +950,103 @@ static void serial_config_task(void *pvParameters) {
 }
 
 // --- SENSOR READING TASK ---
+static sensor_filter_t sensor_filter = {
+    .deadband_temp = SENSOR_DEADBAND_TEMP,
+    .deadband_hum = SENSOR_DEADBAND_HUM,
+    .min_interval_us = SENSOR_MIN_PUBLISH_MS * 1000LL,
+    .heartbeat_us = SENSOR_HEARTBEAT_MS * 1000LL,
+};
+static sensor_ring_t sensor_backlog;
+static uint32_t sensor_published = 0;
+static uint32_t sensor_suppressed = 0;
+static uint32_t sensor_backfilled = 0;
+
+static bool publish_reading(const sensor_record_t *rec) {
+    char payload[100];
+    snprintf(payload, sizeof(payload), "{\"temp\": %d, \"hum\": %d}", rec->temperature, rec->humidity);
+#if MQTT_SUBSCRIBE_LEGACY
+    esp_mqtt_client_publish(client, LEGACY_TOPIC_SENSOR, payload, 0, 0, 0);
+#endif
+    return esp_mqtt_client_publish(client, topic_sensor, payload, 0, 0, 0) >= 0;
+}
+
+// Send buffered readings oldest first, SENSOR_BACKFILL_BATCH per message.
+// ago_ms lets the consumer place each reading in time without SNTP.
+static void backfill_readings(void) {
+    sensor_record_t batch[SENSOR_BACKFILL_BATCH];
+    char payload[32 + SENSOR_BACKFILL_BATCH * 72];  // 72 >= longest formatted entry
+    
+    while (mqtt_connected && sensor_backlog.count > 0) {
+        int n = sensor_ring_peek(&sensor_backlog, batch, SENSOR_BACKFILL_BATCH);
+        int64_t now = esp_timer_get_time();
+        int len = snprintf(payload, sizeof(payload), "{\"readings\": [");
+        for (int i = 0; i < n; i++) {
+            len += snprintf(payload + len, sizeof(payload) - len, "%s{\"temp\": %d, \"hum\": %d, \"ago_ms\": %lld}",
+                            i ? ", " : "", batch[i].temperature, batch[i].humidity,
+                            (long long)((now - batch[i].timestamp_us) / 1000));
+        }
+        snprintf(payload + len, sizeof(payload) - len, "]}");
+        
+        // QoS 1 - popped once the client has it in its outbox
+        if (esp_mqtt_client_publish(client, topic_sensor_backlog, payload, 0, 1, 0) < 0) {
+            break;
+        }
+        sensor_ring_pop(&sensor_backlog, n);
+        sensor_backfilled += n;
+        ESP_LOGI(TAG, "Backfilled %d readings, %d left", n, sensor_backlog.count);
+    }
+}
+
 static void sensor_task(void *pvParameters) {
     TickType_t xLastWakeTime = xTaskGetTickCount();
-    const TickType_t xFrequency = pdMS_TO_TICKS(10000); // 10 seconds
-    
-    // Wait for MQTT to connect first
-    vTaskDelay(pdMS_TO_TICKS(5000));
+    int64_t last_seen_us = 0;
+    int64_t last_stats_us = esp_timer_get_time();
     
     while (1) {
-        if (client != NULL && wifi_connected) {
-            dht11_reading_t reading = read_dht11();
-            if (reading.temperature > 0 && reading.humidity > 0) {
-                char payload[100];
-                ESP_LOGI(TAG, "Auto-reading: Temp: %d C, Hum: %d %%", reading.temperature, reading.humidity);
-                snprintf(payload, sizeof(payload), "{\"temp\": %d, \"hum\": %d}", reading.temperature, reading.humidity);
-                esp_mqtt_client_publish(client, "device/sensor", payload, 0, 0, 0);
+        int64_t now = esp_timer_get_time();
+        
+        // Once a minute: output timer wakeups (0 while all outputs are static),
+        // servo moves, how many state changes the NVS writer coalesced, dispatch cost
+        if (now - last_stats_us >= STATS_LOG_INTERVAL_MS * 1000LL) {
+            last_stats_us = now;
+            outputs_log_stats();
+            servo_log_stats();
+            state_store_log_stats();
+            dispatch_log_stats();
+            rules_log_stats();
+            ESP_LOGI(TAG, "Sensor: %lu published, %lu suppressed, %lu backfilled, %u buffered, %lu dropped",
+                     (unsigned long)sensor_published, (unsigned long)sensor_suppressed,
+                     (unsigned long)sensor_backfilled, sensor_backlog.count, (unsigned long)sensor_backlog.dropped);
+        }
+        
+        bool online = client != NULL && mqtt_connected;
+        if (online && sensor_backlog.count > 0) {
+            backfill_readings();
+        }
+        
+        // Each new reading goes through the dead-band once
+        dht11_sample_t sample;
+        if (dht11_get_cached(&sample) && sample.timestamp_us != last_seen_us) {
+            last_seen_us = sample.timestamp_us;
+            if (sensor_filter_accept(&sensor_filter, sample.reading.temperature, sample.reading.humidity, now)) {
+                sensor_record_t rec = {
+                    .temperature = sample.reading.temperature,
+                    .humidity = sample.reading.humidity,
+                    .timestamp_us = sample.timestamp_us,
+                };
+                // Keep ordering: nothing goes live while older readings are still queued
+                if (online && sensor_backlog.count == 0 && publish_reading(&rec)) {
+                    sensor_published++;
+                    ESP_LOGI(TAG, "Auto-reading: Temp: %d C, Hum: %d %%", rec.temperature, rec.humidity);
+                } else {
+                    sensor_ring_push(&sensor_backlog, &rec);
+                }
             } else {
-                ESP_LOGW(TAG, "Failed to read DHT11");
+                sensor_suppressed++;
             }
         }
         
-        vTaskDelayUntil(&xLastWakeTime, xFrequency);
+        vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(SENSOR_CHECK_MS));
     }
 }
 
@@ -820,23 +1071,35 @@ void app_main(void) {
     ESP_ERROR_CHECK(ret);
 
     init_hardware();
+    init_topics();
+    
+    // DHT11 sampling runs independently of WiFi/MQTT; readers use the cache
+    if (dht11_start(PIN_DHT11) != ESP_OK) {
+        ESP_LOGE(TAG, "DHT11 sampling not started");
+    }
+    
+    // Sensor publishing - buffers readings until MQTT is up
+    xTaskCreate(sensor_task, "sensor_task", 4096, NULL, 5, NULL);
+    
+    control_init();
+    rules_init();
     
     // Load and apply saved device state from NVS
     ESP_LOGI(TAG, "Loading device state from NVS...");
+    if (state_store_init(NVS_DEVICE_NAMESPACE, &device_state, sizeof(device_state), DEVICE_STATE_VERSION) != ESP_OK) {
+        ESP_LOGE(TAG, "Device state store not started");
+    }
     if (load_device_state()) {
         apply_device_state();
     } else {
         ESP_LOGI(TAG, "Using default device state");
     }
     
+    // Rules see readings only once the restored state is in place - an
+    // earlier pass would act on the defaults and be overwritten by NVS
+    dht11_set_callback(on_sensor_sample);
     
-    // Start light blinking task
-    xTaskCreate(light_blink_task, "light_blink_task", 2048, NULL, 5, &light_blink_task_handle);
-    
-    // Start buzzer task
-    xTaskCreate(buzzer_task, "buzzer_task", 2048, NULL, 5, &buzzer_task_handle);
-    
-    // Start serial config task (always running, but only active in config mode)
+    // Start serial config task (wifi, node and group commands at any time)
     xTaskCreate(serial_config_task, "serial_config", 4096, NULL, 5, NULL);
     
     // Initialize WiFi
@@ -859,9 +1122,6 @@ void app_main(void) {
     if (wifi_connected) {
         ESP_LOGI(TAG, "WiFi connected! Starting MQTT and sensors...");
         mqtt_app_start();
-        
-        // Start sensor reading task
-        xTaskCreate(sensor_task, "sensor_task", 4096, NULL, 5, NULL);
     } else {
         ESP_LOGW(TAG, "Failed to connect to WiFi. MQTT and sensors not started.");
         ESP_LOGW(TAG, "Please configure WiFi via serial: wifi <ssid> <password>");
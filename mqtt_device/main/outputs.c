@@ -0,0 +1,151 @@
+#include "outputs.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+
+static const char *TAG = "OUTPUTS";
+
+// LEDC timer 0 / channel 0 belong to the servo
+#define BLINK_TIMER         LEDC_TIMER_1
+#define BLINK_MODE          LEDC_LOW_SPEED_MODE
+#define BLINK_DUTY_RES      LEDC_TIMER_10_BIT
+#define BLINK_DUTY_FULL     (1 << 10)          // 100% - pin held high
+#define BLINK_DUTY_HALF     (1 << 9)
+
+static const ledc_channel_t light_channels[LIGHT_COUNT] = {LEDC_CHANNEL_1, LEDC_CHANNEL_2, LEDC_CHANNEL_3};
+
+static int g_buzzer_pin = -1;
+static int g_buzzer_level = 0;
+static int g_buzzer_mode = BUZZER_OFF;
+static esp_timer_handle_t alarm_timer = NULL;
+static esp_timer_handle_t timeout_timer = NULL;
+static buzzer_timeout_cb_t g_on_timeout = NULL;
+
+// Wakeup accounting - every timer callback is one CPU wakeup
+static uint32_t g_wakeups = 0;
+static int64_t g_stats_since_us = 0;
+static int64_t g_timeout_due_us = 0;
+static int32_t g_last_timeout_error_us = 0;
+
+static void alarm_toggle_cb(void *arg) {
+    g_wakeups++;
+    g_buzzer_level = !g_buzzer_level;
+    gpio_set_level(g_buzzer_pin, g_buzzer_level);
+}
+
+static void buzzer_timeout_cb(void *arg) {
+    g_wakeups++;
+    g_last_timeout_error_us = (int32_t)(esp_timer_get_time() - g_timeout_due_us);
+    ESP_LOGI(TAG, "Buzzer timeout reached (error %ld us)", (long)g_last_timeout_error_us);
+    outputs_set_buzzer(BUZZER_OFF, 0);
+    if (g_on_timeout) {
+        g_on_timeout();
+    }
+}
+
+esp_err_t outputs_init(const int light_pins[LIGHT_COUNT], int buzzer_pin, buzzer_timeout_cb_t on_timeout) {
+    g_buzzer_pin = buzzer_pin;
+    g_on_timeout = on_timeout;
+    g_stats_since_us = esp_timer_get_time();
+    
+    ledc_timer_config_t blink_timer = {
+        .duty_resolution = BLINK_DUTY_RES,
+        .freq_hz = LIGHT_BLINK_HZ,
+        .speed_mode = BLINK_MODE,
+        .timer_num = BLINK_TIMER,
+        .clk_cfg = LEDC_AUTO_CLK,
+    };
+    esp_err_t err = ledc_timer_config(&blink_timer);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Blink timer config failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    
+    // Same timer and hpoint - blinking lights stay in phase
+    for (int i = 0; i < LIGHT_COUNT; i++) {
+        ledc_channel_config_t channel = {
+            .channel = light_channels[i],
+            .duty = 0,
+            .gpio_num = light_pins[i],
+            .speed_mode = BLINK_MODE,
+            .hpoint = 0,
+            .timer_sel = BLINK_TIMER,
+        };
+        err = ledc_channel_config(&channel);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Light %d channel config failed: %s", i + 1, esp_err_to_name(err));
+            return err;
+        }
+    }
+    
+    const esp_timer_create_args_t alarm_args = {
+        .callback = alarm_toggle_cb,
+        .name = "buzzer_alarm",
+    };
+    const esp_timer_create_args_t timeout_args = {
+        .callback = buzzer_timeout_cb,
+        .name = "buzzer_timeout",
+    };
+    err = esp_timer_create(&alarm_args, &alarm_timer);
+    if (err == ESP_OK) {
+        err = esp_timer_create(&timeout_args, &timeout_timer);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Buzzer timer create failed: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+void outputs_set_light(int index, int mode) {
+    if (index < 0 || index >= LIGHT_COUNT) {
+        return;
+    }
+    uint32_t duty = 0;
+    if (mode == LIGHT_ON) {
+        duty = BLINK_DUTY_FULL;
+    } else if (mode == LIGHT_BLINKING) {
+        duty = BLINK_DUTY_HALF;
+    }
+    ledc_set_duty(BLINK_MODE, light_channels[index], duty);
+    ledc_update_duty(BLINK_MODE, light_channels[index]);
+}
+
+void outputs_set_buzzer(int mode, int timeout_sec) {
+    // esp_timer_stop on an idle timer just returns ESP_ERR_INVALID_STATE
+    esp_timer_stop(alarm_timer);
+    esp_timer_stop(timeout_timer);
+    g_buzzer_mode = mode;
+    
+    if (mode == BUZZER_ALARM) {
+        g_buzzer_level = 1;
+        gpio_set_level(g_buzzer_pin, 1);
+        esp_timer_start_periodic(alarm_timer, BUZZER_ALARM_MS * 1000);
+    } else if (mode == BUZZER_CONTINUOUS) {
+        g_buzzer_level = 1;
+        gpio_set_level(g_buzzer_pin, 1);
+    } else {
+        g_buzzer_level = 0;
+        gpio_set_level(g_buzzer_pin, 0);
+        return;
+    }
+    
+    if (timeout_sec > 0) {
+        uint64_t timeout_us = (uint64_t)timeout_sec * 1000000ULL;
+        g_timeout_due_us = esp_timer_get_time() + (int64_t)timeout_us;
+        esp_timer_start_once(timeout_timer, timeout_us);
+    }
+}
+
+void outputs_log_stats(void) {
+    int64_t now = esp_timer_get_time();
+    int64_t span_us = now - g_stats_since_us;
+    uint32_t wakeups = g_wakeups;
+    g_wakeups = 0;
+    g_stats_since_us = now;
+    
+    uint32_t per_min = span_us > 0 ? (uint32_t)((uint64_t)wakeups * 60000000ULL / (uint64_t)span_us) : 0;
+    ESP_LOGI(TAG, "Timer wakeups: %lu in %lld ms (%lu/min), buzzer mode %d, last timeout error %ld us",
+             (unsigned long)wakeups, (long long)(span_us / 1000), (unsigned long)per_min,
+             g_buzzer_mode, (long)g_last_timeout_error_us);
+}
@@ -0,0 +1,62 @@
+#ifndef _OUTPUTS_H_
+#define _OUTPUTS_H_
+
+#include "esp_err.h"
+#include <stdint.h>
+
+// --- LIGHT MODES ---
+#define LIGHT_OFF      0  // Tắt
+#define LIGHT_ON       1  // Bật
+#define LIGHT_BLINKING 2  // Nhấp nháy
+
+// --- BUZZER MODES ---
+#define BUZZER_OFF        0  // Tắt
+#define BUZZER_ALARM      1  // Nháy (báo động)
+#define BUZZER_CONTINUOUS 2  // Liên tục
+
+#define LIGHT_COUNT       3
+#define LIGHT_BLINK_HZ    1    // 500ms on / 500ms off
+#define BUZZER_ALARM_MS   200  // 200ms on / 200ms off
+
+/**
+ * @brief Called from the esp_timer task when a buzzer timeout turns it off
+ */
+typedef void (*buzzer_timeout_cb_t)(void);
+
+/**
+ * @brief Attach the lights to LEDC and create the buzzer timers
+ * 
+ * Blinking runs entirely in LEDC hardware (1Hz, 50% duty on a shared
+ * timer), so static or blinking lights need no CPU at all. The buzzer
+ * alarm pattern and its timeout use esp_timer - nothing runs while
+ * the buzzer is off.
+ * 
+ * @param light_pins GPIOs for light 1..3
+ * @param buzzer_pin Buzzer GPIO
+ * @param on_timeout Called after a buzzer timeout (may be NULL)
+ * @return ESP_OK on success
+ */
+esp_err_t outputs_init(const int light_pins[LIGHT_COUNT], int buzzer_pin, buzzer_timeout_cb_t on_timeout);
+
+/**
+ * @brief Set a light mode (LIGHT_OFF / LIGHT_ON / LIGHT_BLINKING)
+ * 
+ * @param index Light index 0..LIGHT_COUNT-1
+ * @param mode Light mode
+ */
+void outputs_set_light(int index, int mode);
+
+/**
+ * @brief Set the buzzer mode with an optional auto-off
+ * 
+ * @param mode BUZZER_OFF / BUZZER_ALARM / BUZZER_CONTINUOUS
+ * @param timeout_sec Seconds until auto-off, 0 = no timeout
+ */
+void outputs_set_buzzer(int mode, int timeout_sec);
+
+/**
+ * @brief Log timer callback rate and the last buzzer timeout error
+ */
+void outputs_log_stats(void);
+
+#endif // _OUTPUTS_H_
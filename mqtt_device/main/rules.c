@@ -0,0 +1,128 @@
+#include "rules.h"
+#include <stdio.h>
+#include <string.h>
+
+static bool parse_line(const char *line, rule_t *rule, rule_resolve_fn source, rule_resolve_fn target) {
+    char id[RULE_ID_MAX];
+    char src[RULE_NAME_MAX];
+    char cmp[8];
+    char dst[RULE_NAME_MAX];
+    int threshold, hysteresis, hold_s, on_value, off_value;
+    int used = 0;
+    
+    // Anything left after the last number is an error - an over-long name
+    // split by the field widths would otherwise shift into the numbers
+    int n = sscanf(line, "%11s %15s %7s %d %d %d %15s %d%n %d%n",
+                   id, src, cmp, &threshold, &hysteresis, &hold_s, dst, &on_value, &used, &off_value, &used);
+    if (n < 8 || hysteresis < 0 || hold_s < 0 || line[used + strspn(line + used, " \t\r")] != '\0') {
+        return false;
+    }
+    
+    memset(rule, 0, sizeof(*rule));
+    if (strcmp(cmp, "above") == 0 || strcmp(cmp, ">") == 0) {
+        rule->cmp = RULE_ABOVE;
+    } else if (strcmp(cmp, "below") == 0 || strcmp(cmp, "<") == 0) {
+        rule->cmp = RULE_BELOW;
+    } else {
+        return false;
+    }
+    rule->source = source(src);
+    rule->target = target(dst);
+    if (rule->source < 0 || rule->target < 0) {
+        return false;
+    }
+    
+    memcpy(rule->id, id, sizeof(rule->id));
+    rule->threshold = threshold;
+    rule->hysteresis = hysteresis;
+    rule->hold_us = (int64_t)hold_s * 1000000;
+    rule->on_value = on_value;
+    rule->off_value = off_value;
+    rule->has_off = (n == 9);
+    return true;
+}
+
+int rules_parse(const char *text, size_t len, rule_set_t *set,
+                rule_resolve_fn source, rule_resolve_fn target, int *bad_line) {
+    memset(set, 0, sizeof(*set));
+    *bad_line = 0;
+    if (len > RULES_TEXT_MAX) {
+        return -1;
+    }
+    
+    const char *p = text;
+    const char *end = text + len;
+    int line_no = 0;
+    while (p < end) {
+        const char *eol = p;
+        while (eol < end && *eol != '\n' && *eol != ';') {
+            eol++;
+        }
+        line_no++;
+        
+        char line[96];
+        size_t n = eol - p;
+        if (n >= sizeof(line)) {
+            *bad_line = line_no;
+            return -1;
+        }
+        memcpy(line, p, n);
+        line[n] = '\0';
+        p = eol + 1;
+        
+        const char *s = line;
+        while (*s == ' ' || *s == '\t' || *s == '\r') {
+            s++;
+        }
+        if (*s == '\0' || *s == '#') {
+            continue;
+        }
+        if (set->count >= RULES_MAX || !parse_line(s, &set->rules[set->count], source, target)) {
+            *bad_line = line_no;
+            return -1;
+        }
+        set->count++;
+    }
+    return set->count;
+}
+
+int rules_evaluate(rule_set_t *set, const int *inputs, int num_inputs, const bool *valid,
+                   int64_t now_us, rule_action_t *actions, int max_actions) {
+    int count = 0;
+    
+    for (int i = 0; i < set->count; i++) {
+        rule_t *r = &set->rules[i];
+        if (r->source >= num_inputs || (valid && !valid[r->source])) {
+            continue;
+        }
+        int v = inputs[r->source];
+        bool met = (r->cmp == RULE_ABOVE) ? v > r->threshold : v < r->threshold;
+        bool released = (r->cmp == RULE_ABOVE) ? v < r->threshold - r->hysteresis
+                                               : v > r->threshold + r->hysteresis;
+        
+        if (!r->active) {
+            if (!met) {
+                r->pending = false;
+                continue;
+            }
+            if (!r->pending) {
+                r->pending = true;
+                r->pending_since_us = now_us;
+            }
+            if (now_us - r->pending_since_us < r->hold_us) {
+                continue;
+            }
+            r->active = true;
+            if (count < max_actions) {
+                actions[count++] = (rule_action_t){ i, r->target, r->on_value };
+            }
+        } else if (released) {
+            r->active = false;
+            r->pending = false;
+            if (r->has_off && count < max_actions) {
+                actions[count++] = (rule_action_t){ i, r->target, r->off_value };
+            }
+        }
+    }
+    return count;
+}
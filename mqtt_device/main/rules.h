@@ -0,0 +1,88 @@
+#ifndef _RULES_H_
+#define _RULES_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RULES_MAX           8
+#define RULE_ID_MAX         12
+#define RULE_NAME_MAX       16
+#define RULES_TEXT_MAX      512     // Whole rule set as pushed/stored
+
+typedef enum {
+    RULE_ABOVE,     // Active while input > threshold
+    RULE_BELOW,     // Active while input < threshold
+} rule_cmp_t;
+
+typedef struct {
+    char id[RULE_ID_MAX];
+    int source;             // Input index (resolved by the caller)
+    rule_cmp_t cmp;
+    int threshold;
+    int hysteresis;         // Releases only once back past threshold -/+ this
+    int64_t hold_us;        // Condition must hold this long before firing
+    int target;             // Output index (resolved by the caller)
+    int on_value;
+    int off_value;
+    bool has_off;           // Send off_value on release
+    
+    // Runtime
+    bool active;
+    bool pending;               // Condition met, hold running
+    int64_t pending_since_us;
+} rule_t;
+
+typedef struct {
+    rule_t rules[RULES_MAX];
+    int count;
+} rule_set_t;
+
+// Output of an evaluation pass
+typedef struct {
+    int rule;
+    int target;
+    int value;
+} rule_action_t;
+
+/**
+ * @brief Map a source/target name to an index, -1 if unknown
+ */
+typedef int (*rule_resolve_fn)(const char *name);
+
+/**
+ * @brief Parse a rule set from text, one rule per line (or ';')
+ * 
+ *   <id> <source> <above|below> <threshold> <hysteresis> <hold_s> <target> <on> [off]
+ * 
+ * e.g. "hot temp above 30 1 10 fan1 1 0" turns fan1 on once temp has
+ * stayed above 30 for 10s and off again below 29. Lines starting with
+ * '#' are ignored. Pure function - builds for the host.
+ * 
+ * @param text Rule text (not NUL-terminated)
+ * @param len Text length
+ * @param set Filled on success (runtime state cleared)
+ * @param source Resolves source names to input indexes
+ * @param target Resolves target names to output indexes
+ * @param bad_line Set to the 1-based failing line on error
+ * @return Number of rules, or -1 on error
+ */
+int rules_parse(const char *text, size_t len, rule_set_t *set,
+                rule_resolve_fn source, rule_resolve_fn target, int *bad_line);
+
+/**
+ * @brief Evaluate every rule against the current inputs
+ * 
+ * @param set Rule set (runtime state updated)
+ * @param inputs Input values by index
+ * @param num_inputs Size of inputs
+ * @param valid Per-input validity (NULL = all valid)
+ * @param now_us Current time
+ * @param actions Filled with the actions to apply
+ * @param max_actions Capacity of actions
+ * @return Number of actions
+ */
+int rules_evaluate(rule_set_t *set, const int *inputs, int num_inputs, const bool *valid,
+                   int64_t now_us, rule_action_t *actions, int max_actions);
+
+#endif // _RULES_H_
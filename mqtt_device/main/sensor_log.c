@@ -0,0 +1,49 @@
+#include "sensor_log.h"
+
+bool sensor_filter_accept(sensor_filter_t *f, int temperature, int humidity, int64_t now_us) {
+    bool accept;
+    if (!f->have_last) {
+        accept = true;
+    } else {
+        int64_t since = now_us - f->last_us;
+        int dt = temperature - f->last_temp;
+        int dh = humidity - f->last_hum;
+        bool moved = (dt >= f->deadband_temp || -dt >= f->deadband_temp ||
+                      dh >= f->deadband_hum || -dh >= f->deadband_hum);
+        accept = (moved && since >= f->min_interval_us) || since >= f->heartbeat_us;
+    }
+    
+    if (accept) {
+        f->have_last = true;
+        f->last_temp = temperature;
+        f->last_hum = humidity;
+        f->last_us = now_us;
+    }
+    return accept;
+}
+
+void sensor_ring_push(sensor_ring_t *r, const sensor_record_t *rec) {
+    if (r->count == SENSOR_LOG_SIZE) {
+        r->head = (r->head + 1) % SENSOR_LOG_SIZE;
+        r->count--;
+        r->dropped++;
+    }
+    r->buf[(r->head + r->count) % SENSOR_LOG_SIZE] = *rec;
+    r->count++;
+}
+
+int sensor_ring_peek(const sensor_ring_t *r, sensor_record_t *out, int max) {
+    int n = r->count < max ? r->count : max;
+    for (int i = 0; i < n; i++) {
+        out[i] = r->buf[(r->head + i) % SENSOR_LOG_SIZE];
+    }
+    return n;
+}
+
+void sensor_ring_pop(sensor_ring_t *r, int n) {
+    if (n > r->count) {
+        n = r->count;
+    }
+    r->head = (r->head + n) % SENSOR_LOG_SIZE;
+    r->count -= n;
+}
@@ -0,0 +1,63 @@
+#ifndef _SENSOR_LOG_H_
+#define _SENSOR_LOG_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SENSOR_LOG_SIZE 256     // Dead-band filtered readings kept while offline
+
+// One reading as published (or held back while offline)
+typedef struct {
+    int16_t temperature;
+    int16_t humidity;
+    int64_t timestamp_us;       // esp_timer time of the capture
+} sensor_record_t;
+
+// Dead-band / heartbeat decision state
+typedef struct {
+    int deadband_temp;          // Publish when |delta| >= this (C)
+    int deadband_hum;           // ... or >= this (%)
+    int64_t min_interval_us;    // Never publish more often than this
+    int64_t heartbeat_us;       // Always publish at least this often
+    bool have_last;
+    int last_temp;
+    int last_hum;
+    int64_t last_us;
+} sensor_filter_t;
+
+// Ring of unsent readings - oldest overwritten when full
+typedef struct {
+    sensor_record_t buf[SENSOR_LOG_SIZE];
+    uint16_t head;              // Oldest entry
+    uint16_t count;
+    uint32_t dropped;
+} sensor_ring_t;
+
+/**
+ * @brief Decide whether a reading is worth publishing
+ * 
+ * True if it leaves the dead-band around the last accepted reading
+ * (after min_interval_us) or the heartbeat is due. Accepted readings
+ * become the new reference. Pure function of its inputs - builds for
+ * the host.
+ */
+bool sensor_filter_accept(sensor_filter_t *f, int temperature, int humidity, int64_t now_us);
+
+/**
+ * @brief Append a reading, overwriting the oldest if full
+ */
+void sensor_ring_push(sensor_ring_t *r, const sensor_record_t *rec);
+
+/**
+ * @brief Copy up to max oldest readings without removing them
+ * 
+ * @return Number copied
+ */
+int sensor_ring_peek(const sensor_ring_t *r, sensor_record_t *out, int max);
+
+/**
+ * @brief Drop the n oldest readings (after they were sent)
+ */
+void sensor_ring_pop(sensor_ring_t *r, int n);
+
+#endif // _SENSOR_LOG_H_
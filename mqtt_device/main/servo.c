@@ -0,0 +1,224 @@
+#include "servo.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "driver/ledc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "SERVO";
+
+// --- SERVO CONFIG ---
+#define SERVO_MIN_PULSEWIDTH_US 500  // Minimum pulse width in microsecond
+#define SERVO_MAX_PULSEWIDTH_US 2500 // Maximum pulse width in microsecond
+#define SERVO_MIN_DEGREE        0    // Minimum angle
+#define SERVO_MAX_DEGREE        180  // Maximum angle
+#define SERVO_TIMER             LEDC_TIMER_0
+#define SERVO_MODE              LEDC_LOW_SPEED_MODE
+#define SERVO_CHANNEL           LEDC_CHANNEL_0
+#define SERVO_DUTY_RES          LEDC_TIMER_13_BIT // Resolution of PWM duty
+#define SERVO_FREQUENCY         50                // Frequency in Hertz. Set frequency at 50Hz
+#define SERVO_PERIOD_US         20000
+#define SERVO_DUTY_MAX          8192
+#define SERVO_MIN_SEGMENT_MS    20                // One PWM period
+
+#define SERVO_TASK_STACK        3072
+#define SERVO_TASK_PRIO         6
+
+// Current trajectory: fade through duty[0..count-1], segment_ms each
+typedef struct {
+    uint32_t duty[SERVO_EASE_SEGMENTS];
+    int count;
+    int next;
+    int segment_ms;
+    int target;
+    uint32_t gen;           // Bumped per move - stale fade-end events are ignored
+} servo_plan_t;
+
+static servo_plan_t g_plan;
+static SemaphoreHandle_t servo_mutex = NULL;
+static TaskHandle_t servo_task_handle = NULL;
+static servo_done_cb_t g_done_cb = NULL;
+static volatile bool g_moving = false;
+
+// Move counters (logged once a minute)
+static uint32_t stat_moves = 0;
+static uint32_t stat_preempted = 0;
+static uint32_t stat_completed = 0;
+
+static uint32_t angle_to_duty(int angle) {
+    if (angle < SERVO_MIN_DEGREE) angle = SERVO_MIN_DEGREE;
+    if (angle > SERVO_MAX_DEGREE) angle = SERVO_MAX_DEGREE;
+    uint32_t pulse = (angle * (SERVO_MAX_PULSEWIDTH_US - SERVO_MIN_PULSEWIDTH_US) / SERVO_MAX_DEGREE) + SERVO_MIN_PULSEWIDTH_US;
+    return (pulse * SERVO_DUTY_MAX) / SERVO_PERIOD_US;
+}
+
+static int duty_to_angle(uint32_t duty) {
+    int pulse = (int)(duty * SERVO_PERIOD_US / SERVO_DUTY_MAX);
+    int angle = (pulse - SERVO_MIN_PULSEWIDTH_US) * SERVO_MAX_DEGREE / (SERVO_MAX_PULSEWIDTH_US - SERVO_MIN_PULSEWIDTH_US);
+    if (angle < SERVO_MIN_DEGREE) angle = SERVO_MIN_DEGREE;
+    if (angle > SERVO_MAX_DEGREE) angle = SERVO_MAX_DEGREE;
+    return angle;
+}
+
+// Caller holds servo_mutex
+static void start_segment_locked(void) {
+    ledc_set_fade_with_time(SERVO_MODE, SERVO_CHANNEL, g_plan.duty[g_plan.next], g_plan.segment_ms);
+    ledc_fade_start(SERVO_MODE, SERVO_CHANNEL, LEDC_FADE_NO_WAIT);
+    g_plan.next++;
+}
+
+static bool IRAM_ATTR fade_end_cb(const ledc_cb_param_t *param, void *user_arg) {
+    BaseType_t woken = pdFALSE;
+    if (param->event == LEDC_FADE_END_EVT) {
+        xTaskNotifyFromISR(servo_task_handle, g_plan.gen, eSetValueWithOverwrite, &woken);
+    }
+    return woken == pdTRUE;
+}
+
+// Chains the next fade of an eased move, reports the end of the move
+static void servo_task(void *pvParameters) {
+    uint32_t gen;
+    while (1) {
+        xTaskNotifyWait(0, UINT32_MAX, &gen, portMAX_DELAY);
+        
+        int done_angle = -1;
+        xSemaphoreTake(servo_mutex, portMAX_DELAY);
+        if (gen == g_plan.gen && g_moving) {
+            if (g_plan.next < g_plan.count) {
+                start_segment_locked();
+            } else {
+                g_moving = false;
+                done_angle = g_plan.target;
+                stat_completed++;
+            }
+        }
+        xSemaphoreGive(servo_mutex);
+        
+        if (done_angle >= 0) {
+            ESP_LOGI(TAG, "Servo reached %d degrees", done_angle);
+            if (g_done_cb) {
+                g_done_cb(done_angle);
+            }
+        }
+    }
+}
+
+esp_err_t servo_init(int pin, servo_done_cb_t done_cb) {
+    g_done_cb = done_cb;
+    
+    ledc_timer_config_t ledc_timer = {
+        .duty_resolution = SERVO_DUTY_RES,
+        .freq_hz = SERVO_FREQUENCY,
+        .speed_mode = SERVO_MODE,
+        .timer_num = SERVO_TIMER,
+        .clk_cfg = LEDC_AUTO_CLK,
+    };
+    ledc_timer_config(&ledc_timer);
+
+    ledc_channel_config_t ledc_channel = {
+        .channel = SERVO_CHANNEL,
+        .duty = 0,
+        .gpio_num = pin,
+        .speed_mode = SERVO_MODE,
+        .hpoint = 0,
+        .timer_sel = SERVO_TIMER,
+    };
+    ledc_channel_config(&ledc_channel);
+    
+    servo_mutex = xSemaphoreCreateMutex();
+    if (servo_mutex == NULL ||
+        xTaskCreate(servo_task, "servo_task", SERVO_TASK_STACK, NULL, SERVO_TASK_PRIO, &servo_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create servo task");
+        return ESP_ERR_NO_MEM;
+    }
+    
+    esp_err_t err = ledc_fade_func_install(0);
+    if (err == ESP_OK) {
+        ledc_cbs_t cbs = {
+            .fade_cb = fade_end_cb,
+        };
+        err = ledc_cb_register(SERVO_MODE, SERVO_CHANNEL, &cbs, NULL);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "LEDC fade setup failed: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+void servo_set_immediate(int angle) {
+    xSemaphoreTake(servo_mutex, portMAX_DELAY);
+    if (g_moving) {
+        ledc_fade_stop(SERVO_MODE, SERVO_CHANNEL);
+        g_moving = false;
+    }
+    g_plan.gen++;
+    ledc_set_duty(SERVO_MODE, SERVO_CHANNEL, angle_to_duty(angle));
+    ledc_update_duty(SERVO_MODE, SERVO_CHANNEL);
+    xSemaphoreGive(servo_mutex);
+    ESP_LOGI(TAG, "Servo set to %d degrees", angle);
+}
+
+void servo_move(int angle, int speed_dps) {
+    if (speed_dps <= 0) speed_dps = SERVO_DEFAULT_SPEED_DPS;
+    if (speed_dps > SERVO_MAX_SPEED_DPS) speed_dps = SERVO_MAX_SPEED_DPS;
+    
+    xSemaphoreTake(servo_mutex, portMAX_DELAY);
+    
+    // Pre-empt: freeze wherever the running fade has got to and plan from there
+    if (g_moving) {
+        ledc_fade_stop(SERVO_MODE, SERVO_CHANNEL);
+        stat_preempted++;
+    }
+    uint32_t from = ledc_get_duty(SERVO_MODE, SERVO_CHANNEL);
+    uint32_t to = angle_to_duty(angle);
+    int delta = angle - duty_to_angle(from);
+    if (delta < 0) delta = -delta;
+    int total_ms = delta * 1000 / speed_dps;
+    
+    g_plan.gen++;
+    g_plan.target = angle;
+    g_plan.next = 0;
+#if SERVO_EASE
+    // Smoothstep s(t) = t^2 (3 - 2t) sampled into linear hardware fades
+    g_plan.count = SERVO_EASE_SEGMENTS;
+    for (int i = 1; i <= SERVO_EASE_SEGMENTS; i++) {
+        int64_t t = i * 1000 / SERVO_EASE_SEGMENTS;                 // 0..1000
+        int64_t s = t * t * (3000 - 2 * t) / 1000000;              // 0..1000
+        g_plan.duty[i - 1] = (uint32_t)((int64_t)from + ((int64_t)to - (int64_t)from) * s / 1000);
+    }
+#else
+    g_plan.count = 1;
+    g_plan.duty[0] = to;
+#endif
+    g_plan.segment_ms = total_ms / g_plan.count;
+    if (g_plan.segment_ms < SERVO_MIN_SEGMENT_MS) {
+        g_plan.segment_ms = SERVO_MIN_SEGMENT_MS;
+    }
+    
+    if (from == to) {
+        g_moving = false;
+        xSemaphoreGive(servo_mutex);
+        return;
+    }
+    g_moving = true;
+    stat_moves++;
+    start_segment_locked();
+    xSemaphoreGive(servo_mutex);
+    
+    ESP_LOGI(TAG, "Servo moving to %d degrees (%d dps, ~%d ms)", angle, speed_dps, g_plan.segment_ms * g_plan.count);
+}
+
+int servo_get_angle(void) {
+    return duty_to_angle(ledc_get_duty(SERVO_MODE, SERVO_CHANNEL));
+}
+
+bool servo_is_moving(void) {
+    return g_moving;
+}
+
+void servo_log_stats(void) {
+    ESP_LOGI(TAG, "Servo: %lu moves, %lu completed, %lu pre-empted, at %d degrees%s",
+             (unsigned long)stat_moves, (unsigned long)stat_completed, (unsigned long)stat_preempted,
+             servo_get_angle(), g_moving ? " (moving)" : "");
+}
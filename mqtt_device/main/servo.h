@@ -0,0 +1,58 @@
+#ifndef _SERVO_H_
+#define _SERVO_H_
+
+#include "esp_err.h"
+#include <stdbool.h>
+
+#define SERVO_DEFAULT_SPEED_DPS 90      // Degrees per second when a move gives no speed
+#define SERVO_MAX_SPEED_DPS     360
+#define SERVO_EASE              1       // 1 = ease in/out, 0 = constant speed
+#define SERVO_EASE_SEGMENTS     8       // Hardware fades chained per eased move
+
+/**
+ * @brief Called on the servo task when a move reaches its target
+ */
+typedef void (*servo_done_cb_t)(int angle);
+
+/**
+ * @brief Set up LEDC timer 0 / channel 0 for the servo and the fade service
+ * 
+ * @param pin Servo signal GPIO
+ * @param done_cb Called when a move completes (may be NULL)
+ * @return ESP_OK on success
+ */
+esp_err_t servo_init(int pin, servo_done_cb_t done_cb);
+
+/**
+ * @brief Jump to an angle without a trajectory (boot, unknown position)
+ */
+void servo_set_immediate(int angle);
+
+/**
+ * @brief Move to an angle with LEDC hardware fades, non-blocking
+ * 
+ * The move starts from wherever the servo is now - a move in progress
+ * is stopped and replaced. Limiting speed keeps the motor's current draw
+ * down while WiFi is transmitting.
+ * 
+ * @param angle Target angle (0-180)
+ * @param speed_dps Degrees per second, 0 = SERVO_DEFAULT_SPEED_DPS
+ */
+void servo_move(int angle, int speed_dps);
+
+/**
+ * @brief Current angle, read back from the LEDC duty (valid mid-move)
+ */
+int servo_get_angle(void);
+
+/**
+ * @brief true while a move is in progress
+ */
+bool servo_is_moving(void);
+
+/**
+ * @brief Log move counters and the current position
+ */
+void servo_log_stats(void);
+
+#endif // _SERVO_H_
@@ -0,0 +1,196 @@
+#include "state_store.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <string.h>
+
+static const char *TAG = "STATE_STORE";
+
+#define WRITER_TASK_STACK   3072
+#define WRITER_TASK_PRIO    3           // Below MQTT - flash writes are never urgent
+
+typedef struct {
+    uint16_t version;
+    uint16_t size;
+    uint32_t crc;
+} blob_header_t;
+
+static const char *g_namespace = NULL;
+static void *g_state = NULL;
+static size_t g_size = 0;
+static uint16_t g_version = 0;
+
+static SemaphoreHandle_t store_mutex = NULL;
+static TaskHandle_t writer_task_handle = NULL;
+static volatile bool g_dirty = false;
+static int64_t g_last_commit_us = 0;
+static uint8_t g_committed[STATE_STORE_MAX_SIZE];  // Last payload on flash
+static bool g_have_committed = false;
+
+// Counters
+static uint32_t g_changes = 0;
+static uint32_t g_commits = 0;
+static uint32_t g_skipped = 0;      // Dirty but identical to flash
+
+static esp_err_t commit_locked(void) {
+    uint8_t buf[sizeof(blob_header_t) + STATE_STORE_MAX_SIZE];
+    blob_header_t *hdr = (blob_header_t *)buf;
+    uint8_t *payload = buf + sizeof(blob_header_t);
+    
+    // Clear first - a change landing during the copy marks it dirty again
+    g_dirty = false;
+    memcpy(payload, g_state, g_size);
+    
+    if (g_have_committed && memcmp(payload, g_committed, g_size) == 0) {
+        g_skipped++;
+        return ESP_OK;
+    }
+    
+    hdr->version = g_version;
+    hdr->size = (uint16_t)g_size;
+    hdr->crc = esp_rom_crc32_le(0, payload, g_size);
+    
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(g_namespace, NVS_READWRITE, &nvs_handle);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(nvs_handle, STATE_STORE_KEY, buf, sizeof(blob_header_t) + g_size);
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs_handle);
+        }
+        nvs_close(nvs_handle);
+    }
+    
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to commit state: %s", esp_err_to_name(err));
+        g_dirty = true;  // Retry on the next pass
+        return err;
+    }
+    
+    memcpy(g_committed, payload, g_size);
+    g_have_committed = true;
+    g_commits++;
+    g_last_commit_us = esp_timer_get_time();
+    ESP_LOGI(TAG, "State committed (%u changes -> %u commits)", (unsigned)g_changes, (unsigned)g_commits);
+    return ESP_OK;
+}
+
+esp_err_t state_store_flush(void) {
+    if (store_mutex == NULL || !g_dirty) {
+        return ESP_OK;
+    }
+    if (xSemaphoreTake(store_mutex, pdMS_TO_TICKS(1000)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    esp_err_t err = g_dirty ? commit_locked() : ESP_OK;
+    xSemaphoreGive(store_mutex);
+    return err;
+}
+
+static void writer_task(void *pvParameters) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        
+        // Debounce: let the burst settle and hold off until the interval since
+        // the last commit has passed - changes arriving meanwhile ride along
+        int64_t wait_ms = STATE_STORE_SETTLE_MS;
+        if (g_commits > 0) {
+            int64_t since_ms = (esp_timer_get_time() - g_last_commit_us) / 1000;
+            if (STATE_STORE_MIN_INTERVAL_MS - since_ms > wait_ms) {
+                wait_ms = STATE_STORE_MIN_INTERVAL_MS - since_ms;
+            }
+        }
+        vTaskDelay(pdMS_TO_TICKS(wait_ms));
+        
+        // This flush covers the changes notified during the wait - drop
+        // their notifications so the task doesn't wake again for nothing
+        ulTaskNotifyTake(pdTRUE, 0);
+        if (state_store_flush() != ESP_OK) {
+            // Back off a full interval before retrying a failed write
+            vTaskDelay(pdMS_TO_TICKS(STATE_STORE_MIN_INTERVAL_MS));
+            xTaskNotifyGive(writer_task_handle);
+        }
+    }
+}
+
+static void shutdown_flush(void) {
+    if (g_dirty) {
+        ESP_LOGI(TAG, "Flushing state before restart");
+        state_store_flush();
+    }
+}
+
+esp_err_t state_store_init(const char *nvs_namespace, void *state, size_t size, uint16_t version) {
+    if (state == NULL || size == 0 || size > STATE_STORE_MAX_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    g_namespace = nvs_namespace;
+    g_state = state;
+    g_size = size;
+    g_version = version;
+    
+    store_mutex = xSemaphoreCreateMutex();
+    if (store_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create store mutex");
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(writer_task, "state_writer", WRITER_TASK_STACK, NULL, WRITER_TASK_PRIO, &writer_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create writer task");
+        return ESP_ERR_NO_MEM;
+    }
+    esp_register_shutdown_handler(shutdown_flush);
+    return ESP_OK;
+}
+
+bool state_store_load(void) {
+    uint8_t buf[sizeof(blob_header_t) + STATE_STORE_MAX_SIZE];
+    size_t len = sizeof(buf);
+    
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(g_namespace, NVS_READONLY, &nvs_handle);
+    if (err != ESP_OK) {
+        return false;
+    }
+    err = nvs_get_blob(nvs_handle, STATE_STORE_KEY, buf, &len);
+    nvs_close(nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGI(TAG, "No state blob (%s)", esp_err_to_name(err));
+        return false;
+    }
+    
+    const blob_header_t *hdr = (const blob_header_t *)buf;
+    const uint8_t *payload = buf + sizeof(blob_header_t);
+    if (len != sizeof(blob_header_t) + g_size || hdr->version != g_version || hdr->size != g_size) {
+        ESP_LOGW(TAG, "State blob layout mismatch (version %u, size %u), ignoring",
+                 (unsigned)hdr->version, (unsigned)hdr->size);
+        return false;
+    }
+    if (hdr->crc != esp_rom_crc32_le(0, payload, g_size)) {
+        ESP_LOGW(TAG, "State blob CRC mismatch, ignoring");
+        return false;
+    }
+    
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+    memcpy(g_state, payload, g_size);
+    memcpy(g_committed, payload, g_size);
+    g_have_committed = true;
+    xSemaphoreGive(store_mutex);
+    return true;
+}
+
+void state_store_mark_dirty(void) {
+    g_changes++;
+    g_dirty = true;
+    if (writer_task_handle) {
+        xTaskNotifyGive(writer_task_handle);
+    }
+}
+
+void state_store_log_stats(void) {
+    ESP_LOGI(TAG, "Changes: %u, commits: %u, unchanged skips: %u, pending: %s",
+             (unsigned)g_changes, (unsigned)g_commits, (unsigned)g_skipped, g_dirty ? "yes" : "no");
+}
@@ -0,0 +1,55 @@
+#ifndef _STATE_STORE_H_
+#define _STATE_STORE_H_
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define STATE_STORE_KEY             "state"     // Blob key inside the namespace
+#define STATE_STORE_MAX_SIZE        64          // Largest state struct accepted
+#define STATE_STORE_MIN_INTERVAL_MS 5000        // At most one commit per interval
+#define STATE_STORE_SETTLE_MS       500         // Quiet time before the first commit of a burst
+
+/**
+ * @brief Bind a state struct to a single CRC-protected NVS blob
+ * 
+ * The blob is {version, size, crc32, payload}. Changes are marked dirty
+ * and committed by a background task at most every
+ * STATE_STORE_MIN_INTERVAL_MS, so a burst of commands costs one flash
+ * write. Pending changes are flushed from a shutdown handler on
+ * esp_restart().
+ * 
+ * @param nvs_namespace NVS namespace holding the blob
+ * @param state Live state struct (read when committing)
+ * @param size sizeof the state struct
+ * @param version Layout version - bump when the struct changes
+ * @return ESP_OK on success
+ */
+esp_err_t state_store_init(const char *nvs_namespace, void *state, size_t size, uint16_t version);
+
+/**
+ * @brief Load the blob into the bound state struct
+ * 
+ * @return true if a blob with matching version, size and CRC was loaded
+ */
+bool state_store_load(void);
+
+/**
+ * @brief Schedule a commit of the current state (non-blocking)
+ */
+void state_store_mark_dirty(void);
+
+/**
+ * @brief Commit now if dirty (blocking)
+ * 
+ * @return ESP_OK on success or if nothing was pending
+ */
+esp_err_t state_store_flush(void);
+
+/**
+ * @brief Log change/commit counters
+ */
+void state_store_log_stats(void);
+
+#endif // _STATE_STORE_H_
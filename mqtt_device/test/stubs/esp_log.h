@@ -0,0 +1,12 @@
+#ifndef _ESP_LOG_H_
+#define _ESP_LOG_H_
+
+#include <stdio.h>
+
+// Errors and warnings only - info chatter would bury the check failures
+#define ESP_LOGE(tag, fmt, ...) printf("E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) printf("W %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) do { (void)(tag); } while (0)
+#define ESP_LOGD(tag, fmt, ...) do { (void)(tag); } while (0)
+
+#endif // _ESP_LOG_H_
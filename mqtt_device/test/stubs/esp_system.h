@@ -0,0 +1,10 @@
+#ifndef _ESP_SYSTEM_H_
+#define _ESP_SYSTEM_H_
+
+#include "esp_err.h"
+
+typedef void (*shutdown_handler_t)(void);
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handle);
+
+#endif // _ESP_SYSTEM_H_
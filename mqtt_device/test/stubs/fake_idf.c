@@ -0,0 +1,279 @@
+#include "fake_idf.h"
+#include "esp_err.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <setjmp.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_EVENTS  64
+#define MAX_BLOBS   8
+#define MAX_BLOB    256
+
+typedef struct {
+    int64_t at_ms;
+    void (*fn)(void);
+} event_t;
+
+typedef struct {
+    char ns[16];
+    char key[16];
+    uint8_t data[MAX_BLOB];
+    size_t len;
+} blob_t;
+
+static int64_t now_ms;
+static int64_t run_until_ms;
+static event_t events[MAX_EVENTS];
+static int event_count;
+
+static TaskFunction_t task_fn;
+static void *task_param;
+static uint32_t task_notify;
+static jmp_buf task_idle;
+
+static shutdown_handler_t shutdown_handler;
+
+static blob_t blobs[MAX_BLOBS];
+static int blob_count;
+static const char *open_ns[4];
+static int open_count;
+int fake_nvs_commits;
+int64_t fake_nvs_last_commit_ms;
+int fake_nvs_fail_commits;
+
+void fake_reset(void) {
+    now_ms = 0;
+    event_count = 0;
+    task_fn = NULL;
+    task_notify = 0;
+    shutdown_handler = NULL;
+    blob_count = 0;
+    open_count = 0;
+    fake_nvs_commits = 0;
+    fake_nvs_last_commit_ms = -1;
+    fake_nvs_fail_commits = 0;
+}
+
+int64_t fake_now_ms(void) {
+    return now_ms;
+}
+
+void fake_schedule(int64_t at_ms, void (*fn)(void)) {
+    // Keep sorted by time, stable for equal times
+    int i = event_count++;
+    while (i > 0 && events[i - 1].at_ms > at_ms) {
+        events[i] = events[i - 1];
+        i--;
+    }
+    events[i].at_ms = at_ms;
+    events[i].fn = fn;
+}
+
+// Fire the earliest event if it is due by limit_ms
+static int fire_next(int64_t limit_ms) {
+    if (event_count == 0 || events[0].at_ms > limit_ms) {
+        return 0;
+    }
+    event_t ev = events[0];
+    memmove(&events[0], &events[1], (size_t)(--event_count) * sizeof(event_t));
+    if (ev.at_ms > now_ms) {
+        now_ms = ev.at_ms;
+    }
+    ev.fn();
+    return 1;
+}
+
+void fake_run(int64_t until_ms) {
+    run_until_ms = until_ms;
+    if (task_fn == NULL) {
+        while (fire_next(until_ms)) {}
+    } else if (setjmp(task_idle) == 0) {
+        // The task only blocks at the top of its loop, so restarting it is
+        // the same as resuming it from ulTaskNotifyTake()
+        task_fn(task_param);
+    }
+    if (now_ms < until_ms) {
+        now_ms = until_ms;
+    }
+}
+
+void fake_shutdown(void) {
+    if (shutdown_handler) {
+        shutdown_handler();
+    }
+}
+
+// ---- esp_* ----
+
+const char *esp_err_to_name(esp_err_t code) {
+    switch (code) {
+    case ESP_OK:                return "ESP_OK";
+    case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+    case ESP_ERR_TIMEOUT:       return "ESP_ERR_TIMEOUT";
+    default:                    return "ESP_FAIL";
+    }
+}
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handle) {
+    shutdown_handler = handle;
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time(void) {
+    return now_ms * 1000;
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+// ---- FreeRTOS ----
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *param,
+                       unsigned prio, TaskHandle_t *out_handle) {
+    task_fn = fn;
+    task_param = param;
+    if (out_handle) {
+        *out_handle = (TaskHandle_t)&task_fn;
+    }
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait) {
+    while (task_notify == 0) {
+        if (ticks_to_wait == 0) {
+            return 0;
+        }
+        if (!fire_next(run_until_ms)) {
+            longjmp(task_idle, 1);
+        }
+    }
+    uint32_t value = task_notify;
+    task_notify = clear_on_exit ? 0 : value - 1;
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    task_notify++;
+    return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    int64_t wake_ms = now_ms + (int64_t)ticks;
+    while (fire_next(wake_ms)) {}
+    now_ms = wake_ms;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    static int mutex;
+    return &mutex;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks_to_wait) {
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    return pdTRUE;
+}
+
+// ---- NVS ----
+
+static blob_t *find_blob(const char *ns, const char *key) {
+    for (int i = 0; i < blob_count; i++) {
+        if (strcmp(blobs[i].ns, ns) == 0 && strcmp(blobs[i].key, key) == 0) {
+            return &blobs[i];
+        }
+    }
+    return NULL;
+}
+
+static int namespace_exists(const char *ns) {
+    for (int i = 0; i < blob_count; i++) {
+        if (strcmp(blobs[i].ns, ns) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+size_t fake_nvs_get(const char *ns, const char *key, void *out, size_t max) {
+    blob_t *b = find_blob(ns, key);
+    if (b == NULL) {
+        return 0;
+    }
+    size_t len = b->len < max ? b->len : max;
+    memcpy(out, b->data, len);
+    return len;
+}
+
+void fake_nvs_put(const char *ns, const char *key, const void *data, size_t len) {
+    blob_t *b = find_blob(ns, key);
+    if (b == NULL) {
+        if (blob_count == MAX_BLOBS || len > MAX_BLOB) {
+            abort();
+        }
+        b = &blobs[blob_count++];
+        strncpy(b->ns, ns, sizeof(b->ns) - 1);
+        strncpy(b->key, key, sizeof(b->key) - 1);
+    }
+    memcpy(b->data, data, len);
+    b->len = len;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle) {
+    if (open_mode == NVS_READONLY && !namespace_exists(name)) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (open_count == 4) {
+        abort();
+    }
+    open_ns[open_count] = name;
+    *out_handle = (nvs_handle_t)open_count++;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length) {
+    fake_nvs_put(open_ns[handle], key, value, length);
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length) {
+    blob_t *b = find_blob(open_ns[handle], key);
+    if (b == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (b->len > *length) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(out_value, b->data, b->len);
+    *length = b->len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    if (fake_nvs_fail_commits > 0) {
+        fake_nvs_fail_commits--;
+        return ESP_FAIL;
+    }
+    fake_nvs_commits++;
+    fake_nvs_last_commit_ms = now_ms;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+    open_count--;
+}
@@ -0,0 +1,36 @@
+#ifndef _FAKE_IDF_H_
+#define _FAKE_IDF_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Host fakes for the ESP-IDF/FreeRTOS calls the stateful modules use.
+ *
+ * Time is virtual: it only moves in vTaskDelay() or when the single fake
+ * task blocks on a notification and a scheduled event is due. fake_run()
+ * runs the task until it blocks with nothing left to do before until_ms.
+ */
+
+void fake_reset(void);
+
+// Virtual clock
+int64_t fake_now_ms(void);
+
+// Run fn at virtual time at_ms (between task steps)
+void fake_schedule(int64_t at_ms, void (*fn)(void));
+
+// Run the task created with xTaskCreate until it idles past until_ms
+void fake_run(int64_t until_ms);
+
+// Call the handler registered with esp_register_shutdown_handler
+void fake_shutdown(void);
+
+// NVS: one blob per namespace/key, writes counted per nvs_commit
+extern int fake_nvs_commits;
+extern int64_t fake_nvs_last_commit_ms;
+extern int fake_nvs_fail_commits;   // Fail this many upcoming nvs_commit calls
+size_t fake_nvs_get(const char *ns, const char *key, void *out, size_t max);
+void fake_nvs_put(const char *ns, const char *key, const void *data, size_t len);
+
+#endif // _FAKE_IDF_H_
@@ -0,0 +1,15 @@
+#ifndef _FREERTOS_H_
+#define _FREERTOS_H_
+
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE          1
+#define pdFALSE         0
+#define pdPASS          pdTRUE
+#define portMAX_DELAY   0xFFFFFFFFu
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))    // 1 ms tick on the host
+
+#endif // _FREERTOS_H_
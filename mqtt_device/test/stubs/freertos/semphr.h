@@ -0,0 +1,12 @@
+#ifndef _SEMPHR_H_
+#define _SEMPHR_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef void *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks_to_wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+
+#endif // _SEMPHR_H_
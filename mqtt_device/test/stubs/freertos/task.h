@@ -0,0 +1,15 @@
+#ifndef _TASK_H_
+#define _TASK_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+typedef void *TaskHandle_t;
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *param,
+                       unsigned prio, TaskHandle_t *out_handle);
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+
+#endif // _TASK_H_
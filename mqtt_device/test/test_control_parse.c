@@ -0,0 +1,222 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "control_parse.h"
+#include "test_util.h"
+
+#define MAX_OPS 4
+
+typedef struct {
+    const char *json;
+    control_parse_status_t status;
+    int count;
+    int32_t value;      // ops[0] when OK
+} parse_case_t;
+
+static const parse_case_t cases[] = {
+    // Shapes
+    {"{\"device\":\"light1\",\"value\":1}",                     CONTROL_PARSE_OK, 1, 1},
+    {" \r\n{ \"value\" : 2 , \"device\" : \"fan1\" }\t\n",      CONTROL_PARSE_OK, 1, 2},
+    {"[{\"device\":\"a\",\"value\":1},{\"device\":\"b\"}]",     CONTROL_PARSE_OK, 2, 1},
+    {"{\"device\":\"light1\",\"value\":1,\"x\":\"y\",\"t\":true,\"f\":false,\"n\":null,\"k\":-3.5}",
+                                                                CONTROL_PARSE_OK, 1, 1},
+    {"[]",                                                      CONTROL_PARSE_SYNTAX, 0, 0},
+    {"{}",                                                      CONTROL_PARSE_NO_DEVICE, 0, 0},
+    {"{\"value\":1}",                                           CONTROL_PARSE_NO_DEVICE, 0, 0},
+    {"{\"device\":\"\"}",                                       CONTROL_PARSE_NO_DEVICE, 0, 0},
+    {"{\"device\":\"0123456789abcdef\"}",                       CONTROL_PARSE_NO_DEVICE, 0, 0},
+    {"{\"device\":1}",                                          CONTROL_PARSE_NO_DEVICE, 0, 0},
+    {"[{\"device\":\"a\"},{\"value\":1}]",                      CONTROL_PARSE_NO_DEVICE, 0, 0},
+    {"[{\"device\":\"a\"},{\"device\":\"b\"},{\"device\":\"c\"},{\"device\":\"d\"},{\"device\":\"e\"}]",
+                                                                CONTROL_PARSE_TOO_MANY, 0, 0},
+    {"{\"device\":\"a\"} x",                                    CONTROL_PARSE_SYNTAX, 0, 0},
+    {"{\"device\":\"a\"}{\"device\":\"b\"}",                    CONTROL_PARSE_SYNTAX, 0, 0},
+    {"{\"device\":\"a\",}",                                     CONTROL_PARSE_SYNTAX, 0, 0},
+    {"{\"device\" \"a\"}",                                      CONTROL_PARSE_SYNTAX, 0, 0},
+    {"{\"device\":\"a\",\"t\":tru}",                            CONTROL_PARSE_SYNTAX, 0, 0},
+    
+    // Nesting is rejected, not skipped
+    {"{\"device\":\"a\",\"x\":{\"y\":1}}",                      CONTROL_PARSE_SYNTAX, 0, 0},
+    {"{\"device\":\"a\",\"x\":[1,2]}",                          CONTROL_PARSE_SYNTAX, 0, 0},
+    {"{\"device\":\"a\",\"value\":{\"v\":1}}",                  CONTROL_PARSE_SYNTAX, 0, 0},
+    {"[[{\"device\":\"a\"}]]",                                  CONTROL_PARSE_SYNTAX, 0, 0},
+    {"[{\"device\":\"a\"}",                                     CONTROL_PARSE_SYNTAX, 0, 0},
+    
+    // Escapes: skipped in unknown strings, never in device names
+    {"{\"device\":\"a\",\"note\":\"say \\\"hi\\\" \\\\ \\u00e9\"}", CONTROL_PARSE_OK, 1, 0},
+    {"{\"de\\u0076ice\":\"a\"}",                                CONTROL_PARSE_NO_DEVICE, 0, 0},
+    {"{\"device\":\"li\\\"ght\"}",                              CONTROL_PARSE_NO_DEVICE, 0, 0},
+    {"{\"device\":\"a\",\"note\":\"\\",                         CONTROL_PARSE_SYNTAX, 0, 0},
+    {"{\"device\":\"a\",\"note\":\"\\\"}",                      CONTROL_PARSE_SYNTAX, 0, 0},
+    {"{\"device\":\"a\\",                                       CONTROL_PARSE_NO_DEVICE, 0, 0},
+    {"{\"\\",                                                   CONTROL_PARSE_SYNTAX, 0, 0},
+    {"{\"device\":\"light1\x01\"}",                          CONTROL_PARSE_NO_DEVICE, 0, 0},
+    {"{\"device\":\"a\",\"note\":\"line\nbreak\"}",              CONTROL_PARSE_SYNTAX, 0, 0},
+    
+    // Numbers, as cJSON's valueint would give them
+    {"{\"device\":\"a\",\"value\":-7}",                         CONTROL_PARSE_OK, 1, -7},
+    {"{\"device\":\"a\",\"value\":-0}",                         CONTROL_PARSE_OK, 1, 0},
+    {"{\"device\":\"a\",\"value\":2.9}",                        CONTROL_PARSE_OK, 1, 2},
+    {"{\"device\":\"a\",\"value\":-2.9}",                       CONTROL_PARSE_OK, 1, -2},
+    {"{\"device\":\"a\",\"value\":1.}",                         CONTROL_PARSE_OK, 1, 1},
+    {"{\"device\":\"a\",\"value\":1e3}",                        CONTROL_PARSE_OK, 1, 1000},
+    {"{\"device\":\"a\",\"value\":1E+3}",                       CONTROL_PARSE_OK, 1, 1000},
+    {"{\"device\":\"a\",\"value\":2.5e1}",                      CONTROL_PARSE_OK, 1, 25},
+    {"{\"device\":\"a\",\"value\":15e-1}",                      CONTROL_PARSE_OK, 1, 1},
+    {"{\"device\":\"a\",\"value\":1e-400}",                     CONTROL_PARSE_OK, 1, 0},
+    {"{\"device\":\"a\",\"value\":0e999999}",                   CONTROL_PARSE_OK, 1, 0},
+    {"{\"device\":\"a\",\"value\":2147483647}",                 CONTROL_PARSE_OK, 1, INT32_MAX},
+    {"{\"device\":\"a\",\"value\":2147483648}",                 CONTROL_PARSE_OK, 1, INT32_MAX},
+    {"{\"device\":\"a\",\"value\":-2147483648}",                CONTROL_PARSE_OK, 1, INT32_MIN},
+    {"{\"device\":\"a\",\"value\":-99999999999999999999999}",   CONTROL_PARSE_OK, 1, INT32_MIN},
+    {"{\"device\":\"a\",\"value\":123456789012345678901234567890}", CONTROL_PARSE_OK, 1, INT32_MAX},
+    {"{\"device\":\"a\",\"value\":0.000000000000000000000001e30}", CONTROL_PARSE_OK, 1, 1000000},
+    {"{\"device\":\"a\",\"value\":1e99999999999}",              CONTROL_PARSE_OK, 1, INT32_MAX},
+    {"{\"device\":\"a\",\"value\":1e}",                         CONTROL_PARSE_SYNTAX, 0, 0},
+    {"{\"device\":\"a\",\"value\":1e+}",                        CONTROL_PARSE_SYNTAX, 0, 0},
+    {"{\"device\":\"a\",\"value\":-}",                          CONTROL_PARSE_SYNTAX, 0, 0},
+    {"{\"device\":\"a\",\"value\":.5}",                         CONTROL_PARSE_SYNTAX, 0, 0},
+    {"{\"device\":\"a\",\"value\":+1}",                         CONTROL_PARSE_SYNTAX, 0, 0},
+    {"{\"device\":\"a\",\"value\":\"1\"}",                      CONTROL_PARSE_SYNTAX, 0, 0},
+    {"{\"device\":\"a\",\"value\":0x10}",                       CONTROL_PARSE_SYNTAX, 0, 0},
+};
+
+// Exact-size heap copy so the sanitizer catches reads past len
+static control_parse_status_t parse(const char *data, size_t len, control_parsed_op_t *ops, int *count) {
+    char *buf = malloc(len ? len : 1);
+    memcpy(buf, data, len);
+    control_parse_status_t status = control_parse(buf, len, ops, MAX_OPS, count);
+    free(buf);
+    
+    // Invariants for any input
+    if (status == CONTROL_PARSE_OK) {
+        CHECK(*count >= 1 && *count <= MAX_OPS);
+        for (int i = 0; i < *count; i++) {
+            size_t n = strnlen(ops[i].device, CONTROL_NAME_MAX);
+            CHECK(n > 0 && n < CONTROL_NAME_MAX);
+        }
+    } else {
+        CHECK_INT(*count, 0);
+    }
+    return status;
+}
+
+static void test_table(void) {
+    control_parsed_op_t ops[MAX_OPS];
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const parse_case_t *tc = &cases[i];
+        int count = -1;
+        control_parse_status_t status = parse(tc->json, strlen(tc->json), ops, &count);
+        if (status != tc->status || count != tc->count ||
+            (status == CONTROL_PARSE_OK && ops[0].value != tc->value)) {
+            printf("case %zu %s: got %s count %d value %d\n", i, tc->json,
+                   control_parse_status_name(status), count, status == CONTROL_PARSE_OK ? (int)ops[0].value : 0);
+            test_failures++;
+        }
+    }
+}
+
+static void test_fields(void) {
+    control_parsed_op_t ops[MAX_OPS];
+    int count;
+    const char *json = "[{\"device\":\"fan1\",\"value\":1,\"timeout\":30,\"speed\":2.0},{\"device\":\"light2\"}]";
+    CHECK_INT(parse(json, strlen(json), ops, &count), CONTROL_PARSE_OK);
+    CHECK_STR(ops[0].device, "fan1");
+    CHECK(ops[0].has_value);
+    CHECK_INT(ops[0].timeout, 30);
+    CHECK_INT(ops[0].speed, 2);
+    CHECK_STR(ops[1].device, "light2");
+    CHECK(!ops[1].has_value);
+    CHECK_INT(ops[1].timeout, 0);
+}
+
+static void test_limits(void) {
+    control_parsed_op_t ops[MAX_OPS];
+    int count;
+    char big[CONTROL_PARSE_MAX_LEN + 2];
+    
+    // Exactly at the limit is parsed, one byte over is not read at all
+    const char *head = "{\"device\":\"a\",\"pad\":\"";
+    memset(big, 'x', sizeof(big));
+    memcpy(big, head, strlen(head));
+    memcpy(big + CONTROL_PARSE_MAX_LEN - 2, "\"}", 2);
+    CHECK_INT(parse(big, CONTROL_PARSE_MAX_LEN, ops, &count), CONTROL_PARSE_OK);
+    CHECK_INT(parse(big, CONTROL_PARSE_MAX_LEN + 1, ops, &count), CONTROL_PARSE_TOO_LONG);
+    
+    // A number filling the whole payload
+    memcpy(big, "{\"device\":\"a\",\"value\":", 22);
+    memset(big + 22, '9', CONTROL_PARSE_MAX_LEN - 23);
+    big[CONTROL_PARSE_MAX_LEN - 1] = '}';
+    CHECK_INT(parse(big, CONTROL_PARSE_MAX_LEN, ops, &count), CONTROL_PARSE_OK);
+    CHECK_INT(ops[0].value, INT32_MAX);
+    
+    CHECK_INT(parse("", 0, ops, &count), CONTROL_PARSE_SYNTAX);
+    CHECK_INT(control_parse("{\"device\":\"a\"}", 14, ops, 0, &count), CONTROL_PARSE_TOO_MANY);
+}
+
+static void test_truncated(void) {
+    // No proper prefix of a valid payload is valid
+    control_parsed_op_t ops[MAX_OPS];
+    int count;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (cases[i].status != CONTROL_PARSE_OK) {
+            continue;
+        }
+        const char *json = cases[i].json;
+        size_t len = strlen(json);
+        while (len > 0 && strchr(" \t\r\n", json[len - 1])) {
+            len--;
+        }
+        for (size_t n = 0; n < len; n++) {
+            if (parse(json, n, ops, &count) == CONTROL_PARSE_OK) {
+                printf("case %zu truncated to %zu bytes parsed\n", i, n);
+                test_failures++;
+            }
+        }
+    }
+}
+
+static void test_fuzz(void) {
+    // Random mutations of the table - only the invariants in parse() and
+    // the sanitizer are checked, the status is whatever it is
+    control_parsed_op_t ops[MAX_OPS];
+    const char alphabet[] = "{}[]\":,\\-+.eE0123456789 tfnul\x00\xff";
+    char buf[CONTROL_PARSE_MAX_LEN];
+    int count;
+    srand(1234);
+    for (int iter = 0; iter < 200000; iter++) {
+        const char *seed = cases[rand() % (sizeof(cases) / sizeof(cases[0]))].json;
+        size_t len = strlen(seed);
+        memcpy(buf, seed, len);
+        int edits = 1 + rand() % 4;
+        for (int e = 0; e < edits && len > 0; e++) {
+            size_t at = rand() % len;
+            switch (rand() % 3) {
+            case 0:     // Replace
+                buf[at] = alphabet[rand() % (sizeof(alphabet) - 1)];
+                break;
+            case 1:     // Delete
+                memmove(buf + at, buf + at + 1, len - at - 1);
+                len--;
+                break;
+            default:    // Duplicate a span (deeper nesting, longer numbers)
+                if (len < sizeof(buf) / 2) {
+                    size_t span = 1 + rand() % (len - at);
+                    memmove(buf + at + span, buf + at, len - at);
+                    len += span;
+                }
+                break;
+            }
+        }
+        parse(buf, len, ops, &count);
+    }
+}
+
+int main(void) {
+    test_table();
+    test_fields();
+    test_limits();
+    test_truncated();
+    test_fuzz();
+    CHECK_STR(control_parse_status_name(CONTROL_PARSE_TOO_MANY), "too many ops");
+    return TEST_RESULT();
+}
@@ -0,0 +1,196 @@
+#include <stdint.h>
+#include <time.h>
+#include "control_parse.h"
+#include "devices.h"
+#include "test_util.h"
+
+// Fake hardware - records what a batch did
+static int servo_calls, servo_angle, servo_speed;
+static int light_calls, light_mode[LIGHT_COUNT];
+static int buzzer_calls, buzzer_mode, buzzer_timeout;
+static int switch_calls;
+static uint32_t switch_set, switch_clr;
+static int changed_calls;
+
+static void fake_servo_move(int angle, int speed) { servo_calls++; servo_angle = angle; servo_speed = speed; }
+static void fake_set_light(int index, int mode) { light_calls++; light_mode[index] = mode; }
+static void fake_set_buzzer(int mode, int timeout) { buzzer_calls++; buzzer_mode = mode; buzzer_timeout = timeout; }
+static void fake_write_switches(uint32_t set, uint32_t clr) { switch_calls++; switch_set = set; switch_clr = clr; }
+static void fake_state_changed(void) { changed_calls++; }
+
+static const devices_hooks_t hooks = {
+    .servo_move = fake_servo_move,
+    .set_light = fake_set_light,
+    .set_buzzer = fake_set_buzzer,
+    .write_switches = fake_write_switches,
+    .state_changed = fake_state_changed,
+};
+
+static void reset_fakes(void) {
+    servo_calls = light_calls = buzzer_calls = switch_calls = changed_calls = 0;
+    switch_set = switch_clr = 0;
+}
+
+static const device_state_t initial = {LIGHT_OFF, LIGHT_OFF, LIGHT_OFF, 0, 0, 120, BUZZER_OFF};
+
+// handle_control() in main.c: parse, resolve all or nothing, apply.
+// Returns ops applied, -1 if rejected.
+static int dispatch(const char *json, device_state_t *st) {
+    control_parsed_op_t parsed[CONTROL_MAX_OPS];
+    control_op_t ops[CONTROL_MAX_OPS];
+    int count = 0;
+    int bad = 0;
+
+    if (control_parse(json, strlen(json), parsed, CONTROL_MAX_OPS, &count) != CONTROL_PARSE_OK) {
+        return -1;
+    }
+    if (!devices_resolve(parsed, count, ops, &bad)) {
+        return -1;
+    }
+    return devices_apply(st, ops, count, &hooks);
+}
+
+static void test_table(void) {
+    for (int i = 0; i < DEVICE_COUNT; i++) {
+        CHECK(devices[i].name != NULL);
+        CHECK_INT(devices_find(devices[i].name), i);
+        CHECK(devices[i].kind == DEV_SWITCH ? devices[i].pin >= 0 && devices[i].pin < 32 : 1);
+        CHECK(devices[i].offset + devices[i].size <= sizeof(device_state_t));
+    }
+    CHECK_INT(devices_find("light4"), -1);
+    CHECK_INT(devices_find(""), -1);
+    CHECK_INT(devices_find("Light1"), -1);
+
+    const device_desc_t *servo = &devices[devices_find("servo")];
+    const device_desc_t *fan = &devices[devices_find("fan1")];
+    CHECK_INT(devices_clamp(servo, 0), 120);
+    CHECK_INT(devices_clamp(servo, 150), 150);
+    CHECK_INT(devices_clamp(servo, 999), 180);
+    CHECK_INT(devices_clamp(fan, 7), 1);
+    CHECK_INT(devices_clamp(fan, -1), 1);
+    CHECK_INT(devices_clamp(fan, 0), 0);
+}
+
+static void test_single(void) {
+    device_state_t st = initial;
+    reset_fakes();
+    CHECK_INT(dispatch("{\"device\":\"light2\",\"value\":2}", &st), 1);
+    CHECK_INT(st.light2, LIGHT_BLINKING);
+    CHECK_INT(light_calls, 1);
+    CHECK_INT(light_mode[1], LIGHT_BLINKING);
+    CHECK_INT(switch_calls, 0);
+    CHECK_INT(changed_calls, 1);
+
+    reset_fakes();
+    CHECK_INT(dispatch("{\"device\":\"servo\",\"value\":400,\"speed\":30}", &st), 1);
+    CHECK_INT(st.servo_angle, 180);
+    CHECK_INT(servo_angle, 180);
+    CHECK_INT(servo_speed, 30);
+
+    reset_fakes();
+    CHECK_INT(dispatch("{\"device\":\"buzzer\",\"value\":1,\"timeout\":5}", &st), 1);
+    CHECK_INT(st.buzzer_mode, BUZZER_ALARM);
+    CHECK_INT(buzzer_timeout, 5);
+
+    // Query only: no state, no store update
+    reset_fakes();
+    device_state_t before = st;
+    CHECK_INT(dispatch("{\"device\":\"sensor\"}", &st), 0);
+    CHECK(memcmp(&before, &st, sizeof(st)) == 0);
+    CHECK_INT(changed_calls, 0);
+}
+
+static void test_batch(void) {
+    device_state_t st = initial;
+    st.fan2 = 1;
+    reset_fakes();
+
+    // A scene: every output in one message
+    int n = dispatch("[{\"device\":\"light1\",\"value\":1},{\"device\":\"light2\",\"value\":1},"
+                     "{\"device\":\"light3\",\"value\":9},{\"device\":\"fan1\",\"value\":1},"
+                     "{\"device\":\"fan2\",\"value\":0},{\"device\":\"servo\",\"value\":150},"
+                     "{\"device\":\"buzzer\",\"value\":0},{\"device\":\"sensor\"}]", &st);
+    CHECK_INT(n, 7);
+    CHECK_INT(st.light1, LIGHT_ON);
+    CHECK_INT(st.light3, LIGHT_BLINKING);
+    CHECK_INT(st.fan1, 1);
+    CHECK_INT(st.fan2, 0);
+    CHECK_INT(st.servo_angle, 150);
+    CHECK_INT(light_calls, 3);
+
+    // Both fans in one register write pair, one store update for the batch
+    CHECK_INT(switch_calls, 1);
+    CHECK_INT(switch_set, 1UL << PIN_FAN1);
+    CHECK_INT(switch_clr, 1UL << PIN_FAN2);
+    CHECK_INT(changed_calls, 1);
+
+    // Later entries win within a batch
+    reset_fakes();
+    CHECK_INT(dispatch("[{\"device\":\"fan1\",\"value\":0},{\"device\":\"fan1\",\"value\":1}]", &st), 2);
+    CHECK_INT(st.fan1, 1);
+    CHECK_INT(switch_calls, 1);
+    CHECK_INT(changed_calls, 1);
+}
+
+static void test_rejected(void) {
+    static const char *const rejected[] = {
+        // Unknown device after valid ones
+        "[{\"device\":\"light1\",\"value\":1},{\"device\":\"fan1\",\"value\":1},{\"device\":\"toaster\",\"value\":1}]",
+        // Missing value
+        "[{\"device\":\"light1\",\"value\":1},{\"device\":\"fan1\"}]",
+        // Parse errors
+        "[{\"device\":\"light1\",\"value\":1},{\"device\":\"fan1\",\"value\":1}",
+        "[{\"device\":\"light1\",\"value\":1},{\"device\":\"a\"},{\"device\":\"b\"},{\"device\":\"c\"},"
+        "{\"device\":\"d\"},{\"device\":\"e\"},{\"device\":\"f\"},{\"device\":\"g\"},{\"device\":\"h\"}]",
+    };
+    for (size_t i = 0; i < sizeof(rejected) / sizeof(rejected[0]); i++) {
+        device_state_t st = initial;
+        reset_fakes();
+        CHECK_INT(dispatch(rejected[i], &st), -1);
+        CHECK(memcmp(&st, &initial, sizeof(st)) == 0);
+        CHECK_INT(light_calls + switch_calls + servo_calls + buzzer_calls + changed_calls, 0);
+    }
+
+    control_parsed_op_t parsed[2] = {{"light1", 1, true, 0, 0}, {"nope", 1, true, 0, 0}};
+    control_op_t ops[2];
+    int bad = -1;
+    CHECK(!devices_resolve(parsed, 2, ops, &bad));
+    CHECK_INT(bad, 1);
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Host cost of one message, parse through apply - configure with
+// -DHOST_TEST_SANITIZE=OFF for meaningful numbers. On the board the same
+// path is timed by dispatch_log_stats().
+static void bench(const char *label, const char *json, int ops) {
+    const int iterations = 20000;
+    device_state_t st = initial;
+    int applied = 0;
+    double start = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        applied += dispatch(json, &st);
+    }
+    double per_msg = (now_ns() - start) / iterations;
+    CHECK_INT(applied, (long long)iterations * ops);
+    printf("bench %-8s %d op(s): %7.0f ns/message, %6.0f ns/op\n", label, ops, per_msg, per_msg / ops);
+}
+
+int main(void) {
+    devices_init();
+    test_table();
+    test_single();
+    test_batch();
+    test_rejected();
+
+    bench("single", "{\"device\":\"fan1\",\"value\":1}", 1);
+    bench("scene", "[{\"device\":\"light1\",\"value\":0},{\"device\":\"light2\",\"value\":0},"
+                   "{\"device\":\"light3\",\"value\":0},{\"device\":\"fan1\",\"value\":1},"
+                   "{\"device\":\"fan2\",\"value\":1},{\"device\":\"servo\",\"value\":150},"
+                   "{\"device\":\"buzzer\",\"value\":0}]", 7);
+    return TEST_RESULT();
+}
@@ -0,0 +1,99 @@
+#include <stdint.h>
+#include "dht11_decode.h"
+#include "test_util.h"
+
+#define ARRAY_LEN(a) (sizeof(a) / sizeof((a)[0]))
+
+// RMT captures from a DHT11 (pulses in us, level after the host start pulse)
+
+// 55 %RH, 24 C
+static const dht11_pulse_t good_frame[] = {
+    {1, 34}, {0, 84}, {1, 88},  // Host release, response low/high
+    {0, 55}, {1, 26}, {0, 56}, {1, 29}, {0, 51}, {1, 69}, {0, 56}, {1, 71},  // humidity 0x37
+    {0, 50}, {1, 23}, {0, 55}, {1, 70}, {0, 50}, {1, 68}, {0, 56}, {1, 74},
+    {0, 48}, {1, 27}, {0, 54}, {1, 26}, {0, 50}, {1, 27}, {0, 48}, {1, 29},  // humidity dec 0x00
+    {0, 56}, {1, 23}, {0, 48}, {1, 23}, {0, 51}, {1, 24}, {0, 48}, {1, 29},
+    {0, 55}, {1, 25}, {0, 55}, {1, 27}, {0, 51}, {1, 27}, {0, 51}, {1, 73},  // temperature 0x18
+    {0, 52}, {1, 71}, {0, 48}, {1, 28}, {0, 49}, {1, 26}, {0, 52}, {1, 26},
+    {0, 56}, {1, 29}, {0, 49}, {1, 28}, {0, 52}, {1, 25}, {0, 51}, {1, 27},  // temperature dec 0x00
+    {0, 52}, {1, 23}, {0, 49}, {1, 27}, {0, 49}, {1, 26}, {0, 49}, {1, 29},
+    {0, 52}, {1, 26}, {0, 49}, {1, 68}, {0, 48}, {1, 24}, {0, 51}, {1, 23},  // checksum 0x4F
+    {0, 55}, {1, 71}, {0, 54}, {1, 71}, {0, 49}, {1, 72}, {0, 51}, {1, 74},
+    {0, 55},
+};
+
+// 61 %RH, 27 C - a 2us low glitch splits the fourth temperature bit
+static const dht11_pulse_t glitchy_frame[] = {
+    {1, 28}, {0, 80}, {1, 81},  // Host release, response low/high
+    {0, 52}, {1, 25}, {0, 48}, {1, 26}, {0, 49}, {1, 69}, {0, 51}, {1, 73},  // humidity 0x3D
+    {0, 49}, {1, 68}, {0, 48}, {1, 71}, {0, 55}, {1, 24}, {0, 56}, {1, 69},
+    {0, 55}, {1, 27}, {0, 51}, {1, 28}, {0, 50}, {1, 26}, {0, 54}, {1, 23},  // humidity dec 0x00
+    {0, 54}, {1, 26}, {0, 51}, {1, 23}, {0, 52}, {1, 29}, {0, 52}, {1, 23},
+    {0, 51}, {1, 24}, {0, 54}, {1, 29}, {0, 49}, {1, 23}, {0, 50}, {1, 34}, {0, 2}, {1, 33},  // temperature 0x1B
+    {0, 55}, {1, 70}, {0, 48}, {1, 29}, {0, 53}, {1, 74}, {0, 52}, {1, 71},
+    {0, 49}, {1, 23}, {0, 49}, {1, 24}, {0, 51}, {1, 23}, {0, 53}, {1, 25},  // temperature dec 0x00
+    {0, 55}, {1, 24}, {0, 55}, {1, 29}, {0, 50}, {1, 29}, {0, 54}, {1, 24},
+    {0, 50}, {1, 25}, {0, 51}, {1, 74}, {0, 51}, {1, 28}, {0, 51}, {1, 69},  // checksum 0x58
+    {0, 56}, {1, 69}, {0, 54}, {1, 26}, {0, 49}, {1, 26}, {0, 48}, {1, 23},
+    {0, 50},};
+
+static void test_good(void) {
+    dht11_reading_t r = {0};
+    CHECK_INT(dht11_decode(good_frame, ARRAY_LEN(good_frame), &r), DHT11_OK);
+    CHECK_INT(r.humidity, 55);
+    CHECK_INT(r.temperature, 24);
+}
+
+static void test_leading_noise(void) {
+    // Line bounce before the response must be skipped, not decoded
+    dht11_pulse_t frame[ARRAY_LEN(good_frame) + 4] = {
+        {0, 3}, {1, 5}, {0, 120}, {1, 60},
+    };
+    memcpy(&frame[4], good_frame, sizeof(good_frame));
+    dht11_reading_t r = {0};
+    CHECK_INT(dht11_decode(frame, ARRAY_LEN(frame), &r), DHT11_OK);
+    CHECK_INT(r.humidity, 55);
+    CHECK_INT(r.temperature, 24);
+}
+
+static void test_short(void) {
+    dht11_reading_t r = {-1, -1};
+    // Capture cut off mid temperature byte
+    CHECK_INT(dht11_decode(good_frame, 40, &r), DHT11_ERR_SHORT);
+    // Last data bit missing its high half
+    CHECK_INT(dht11_decode(good_frame, ARRAY_LEN(good_frame) - 2, &r), DHT11_ERR_SHORT);
+    CHECK_INT(r.humidity, -1);
+}
+
+static void test_glitchy(void) {
+    dht11_reading_t r = {-1, -1};
+    CHECK_INT(dht11_decode(glitchy_frame, ARRAY_LEN(glitchy_frame), &r), DHT11_ERR_TIMING);
+    CHECK_INT(r.temperature, -1);
+}
+
+static void test_bad_checksum(void) {
+    dht11_pulse_t frame[ARRAY_LEN(good_frame)];
+    memcpy(frame, good_frame, sizeof(good_frame));
+    frame[3 + 2 * 7 + 1].duration_us = 26;   // Humidity LSB 1 -> 0 (0x36)
+    dht11_reading_t r = {-1, -1};
+    CHECK_INT(dht11_decode(frame, ARRAY_LEN(frame), &r), DHT11_ERR_CHECKSUM);
+    CHECK_INT(r.humidity, -1);
+}
+
+static void test_no_response(void) {
+    dht11_reading_t r;
+    CHECK_INT(dht11_decode(good_frame, 0, &r), DHT11_ERR_NO_RESPONSE);
+    // Data bits alone: no 80us low/high pair anywhere
+    CHECK_INT(dht11_decode(&good_frame[3], ARRAY_LEN(good_frame) - 3, &r), DHT11_ERR_NO_RESPONSE);
+}
+
+int main(void) {
+    test_good();
+    test_leading_noise();
+    test_short();
+    test_glitchy();
+    test_bad_checksum();
+    test_no_response();
+    CHECK_STR(dht11_status_name(DHT11_ERR_CHECKSUM), "checksum");
+    return TEST_RESULT();
+}
@@ -0,0 +1,213 @@
+#include <stdint.h>
+#include "rules.h"
+#include "test_util.h"
+
+#define SEC 1000000LL
+
+enum { IN_TEMP, IN_HUM, NUM_INPUTS };
+enum { OUT_FAN1, OUT_LIGHT1 };
+
+static int resolve_source(const char *name) {
+    if (strcmp(name, "temp") == 0) return IN_TEMP;
+    if (strcmp(name, "hum") == 0) return IN_HUM;
+    return -1;
+}
+
+static int resolve_target(const char *name) {
+    if (strcmp(name, "fan1") == 0) return OUT_FAN1;
+    if (strcmp(name, "light1") == 0) return OUT_LIGHT1;
+    return -1;
+}
+
+static int parse(const char *text, rule_set_t *set, int *bad_line) {
+    return rules_parse(text, strlen(text), set, resolve_source, resolve_target, bad_line);
+}
+
+typedef struct {
+    const char *text;
+    int bad_line;       // 0 = parses
+} parse_case_t;
+
+static const parse_case_t parse_cases[] = {
+    {"hot temp above 30 1 10 fan1 1 0", 0},
+    {"hot temp > 30 1 10 fan1 1\r\n\r\ndry hum < 40 5 0 light1 1 0\r\n", 0},
+    {"# comment\n   \n\thot temp above 30 1 10 fan1 1 0 \t", 0},
+    {"a temp above 30 1 10 fan1 1;b hum below 40 5 0 light1 1 0;", 0},
+    {"a temp above -5 0 0 fan1 -1 0", 0},
+    
+    // The failing line is reported 1-based, counting comments, blanks and ';'
+    {"hot temp abve 30 1 10 fan1 1 0", 1},
+    {"# rules\nhot temp above 30 1 10 fan1 1 0\ncold tmp below 10 1 10 fan1 0", 3},
+    {"a temp above 30 1 10 fan1 1 0;b temp above 30 1 10 pump1 1 0", 2},
+    {"\n\nhot temp above 30 -1 10 fan1 1 0", 3},
+    {"hot temp above 30 1 -10 fan1 1 0", 1},
+    {"hot temp above 30 1 10 fan1", 1},
+    {"hot temp above thirty 1 10 fan1 1 0", 1},
+    {"hot temp above 30 1 10 fan1 1 0 2", 1},
+    {"hot temp above 30 1 10 fan1 1 x", 1},
+    {"hot temp above 30 1 10 fan1 1x", 1},
+    {"hot temp above 30 1 10 fan1 1 0abc", 1},
+    
+    // Over-long names are errors, not split into the following fields
+    {"hot temp above 30 1 10 fan12345678901234 1 0", 1},
+    {"hot temp above 30 1 10 fan1234567890123 1", 1},
+    {"averyveryverylongid temp above 30 1 10 fan1 1 0", 1},
+    
+    // Over-long line
+    {"ok temp above 30 1 10 fan1 1 0\n"
+     "hot temp above 30 1 10 fan1 1 0                                                                  ", 2},
+};
+
+static void test_parse_lines(void) {
+    rule_set_t set;
+    for (size_t i = 0; i < sizeof(parse_cases) / sizeof(parse_cases[0]); i++) {
+        const parse_case_t *tc = &parse_cases[i];
+        int bad_line = -1;
+        int count = parse(tc->text, &set, &bad_line);
+        if ((tc->bad_line == 0) != (count >= 0) || bad_line != tc->bad_line) {
+            printf("case %zu \"%s\": count %d, bad line %d, expected %d\n",
+                   i, tc->text, count, bad_line, tc->bad_line);
+            test_failures++;
+        }
+    }
+}
+
+static void test_parse_fields(void) {
+    rule_set_t set;
+    int bad_line;
+    CHECK_INT(parse("hot temp above 30 1 10 fan1 1 0\ndry hum < 40 5 0 light1 1", &set, &bad_line), 2);
+    rule_t *hot = &set.rules[0];
+    CHECK_STR(hot->id, "hot");
+    CHECK_INT(hot->source, IN_TEMP);
+    CHECK_INT(hot->cmp, RULE_ABOVE);
+    CHECK_INT(hot->threshold, 30);
+    CHECK_INT(hot->hysteresis, 1);
+    CHECK_INT(hot->hold_us, 10 * SEC);
+    CHECK_INT(hot->target, OUT_FAN1);
+    CHECK_INT(hot->on_value, 1);
+    CHECK(hot->has_off);
+    CHECK_INT(hot->off_value, 0);
+    CHECK(!hot->active);
+    rule_t *dry = &set.rules[1];
+    CHECK_INT(dry->cmp, RULE_BELOW);
+    CHECK_INT(dry->target, OUT_LIGHT1);
+    CHECK(!dry->has_off);
+    
+    // Set limits
+    char text[RULES_TEXT_MAX + 64] = "";
+    for (int i = 0; i <= RULES_MAX; i++) {
+        strcat(text, "r temp above 30 1 10 fan1 1 0\n");
+    }
+    CHECK_INT(parse(text, &set, &bad_line), -1);
+    CHECK_INT(bad_line, RULES_MAX + 1);
+    
+    memset(text, ' ', RULES_TEXT_MAX + 1);
+    text[RULES_TEXT_MAX + 1] = '\0';
+    CHECK_INT(parse(text, &set, &bad_line), -1);
+    CHECK_INT(bad_line, 0);
+    
+    CHECK_INT(parse("", &set, &bad_line), 0);
+    CHECK_INT(bad_line, 0);
+}
+
+static rule_set_t set;
+static int inputs[NUM_INPUTS];
+static bool valid[NUM_INPUTS] = {true, true};
+static rule_action_t actions[RULES_MAX];
+
+// Evaluate with temp at t seconds; returns the single action value, or -1
+static int step(int temp, int64_t t) {
+    inputs[IN_TEMP] = temp;
+    int n = rules_evaluate(&set, inputs, NUM_INPUTS, valid, t * SEC, actions, RULES_MAX);
+    CHECK(n <= 1);
+    if (n == 1) {
+        CHECK_INT(actions[0].rule, 0);
+        CHECK_INT(actions[0].target, OUT_FAN1);
+    }
+    return n == 1 ? actions[0].value : -1;
+}
+
+static void load(const char *text) {
+    int bad_line;
+    CHECK_INT(parse(text, &set, &bad_line), 1);
+}
+
+static void test_hold(void) {
+    load("hot temp above 30 1 10 fan1 1 0");
+    
+    // Must stay above the threshold for the whole hold time
+    CHECK_INT(step(31, 0), -1);
+    CHECK_INT(step(31, 9), -1);
+    CHECK_INT(step(31, 10), 1);
+    CHECK_INT(step(35, 15), -1);
+    
+    // A dip below the threshold restarts the hold
+    load("hot temp above 30 1 10 fan1 1 0");
+    CHECK_INT(step(31, 100), -1);
+    CHECK_INT(step(30, 105), -1);
+    CHECK_INT(step(31, 108), -1);
+    CHECK_INT(step(31, 117), -1);
+    CHECK_INT(step(31, 118), 1);
+    
+    // No hold fires on the first reading, even at time 0
+    load("hot temp above 30 1 0 fan1 1 0");
+    CHECK_INT(step(31, 0), 1);
+}
+
+static void test_hysteresis(void) {
+    load("hot temp above 30 2 0 fan1 1 0");
+    CHECK_INT(step(31, 0), 1);
+    
+    // Back at or inside threshold - hysteresis: still on, no chatter
+    for (int t = 1; t <= 20; t++) {
+        CHECK_INT(step(28 + t % 4, t), -1);
+    }
+    // Released only once below 30 - 2
+    CHECK_INT(step(27, 21), 0);
+    CHECK_INT(step(27, 22), -1);
+    
+    // Re-arms: fires again once above the threshold
+    CHECK_INT(step(29, 23), -1);
+    CHECK_INT(step(31, 24), 1);
+    
+    // Below rules mirror it
+    load("cold temp below 18 1 0 fan1 0 1");
+    CHECK_INT(step(17, 0), 0);
+    CHECK_INT(step(19, 1), -1);
+    CHECK_INT(step(20, 2), 1);
+}
+
+static void test_release(void) {
+    // Without an off value the release is silent but still re-arms
+    load("hot temp above 30 1 0 fan1 1");
+    CHECK_INT(step(31, 0), 1);
+    CHECK_INT(step(20, 1), -1);
+    CHECK(!set.rules[0].active);
+    CHECK_INT(step(31, 2), 1);
+    
+    // An invalid input neither fires nor releases
+    load("hot temp above 30 1 0 fan1 1 0");
+    CHECK_INT(step(31, 0), 1);
+    valid[IN_TEMP] = false;
+    CHECK_INT(step(10, 1), -1);
+    CHECK(set.rules[0].active);
+    valid[IN_TEMP] = true;
+    CHECK_INT(step(10, 2), 0);
+    
+    // Actions beyond max_actions are dropped, state still advances
+    int bad_line;
+    CHECK_INT(parse("a temp above 30 0 0 fan1 1 0;b temp above 30 0 0 light1 1 0", &set, &bad_line), 2);
+    inputs[IN_TEMP] = 31;
+    CHECK_INT(rules_evaluate(&set, inputs, NUM_INPUTS, NULL, SEC, actions, 1), 1);
+    CHECK_INT(actions[0].target, OUT_FAN1);
+    CHECK(set.rules[1].active);
+}
+
+int main(void) {
+    test_parse_lines();
+    test_parse_fields();
+    test_hold();
+    test_hysteresis();
+    test_release();
+    return TEST_RESULT();
+}
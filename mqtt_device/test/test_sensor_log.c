@@ -0,0 +1,168 @@
+#include <stdint.h>
+#include "sensor_log.h"
+#include "test_util.h"
+
+#define SEC 1000000LL
+
+static sensor_ring_t ring;
+
+static sensor_record_t record(int i) {
+    sensor_record_t rec = { (int16_t)i, (int16_t)(i / 2), i * SEC };
+    return rec;
+}
+
+static sensor_filter_t filter(void) {
+    sensor_filter_t f = {0};
+    f.deadband_temp = 1;
+    f.deadband_hum = 3;
+    f.min_interval_us = 10 * SEC;
+    f.heartbeat_us = 300 * SEC;
+    return f;
+}
+
+static void test_ring_basic(void) {
+    sensor_record_t out[8];
+    memset(&ring, 0, sizeof(ring));
+    CHECK_INT(sensor_ring_peek(&ring, out, 8), 0);
+    
+    for (int i = 0; i < 3; i++) {
+        sensor_record_t rec = record(i);
+        sensor_ring_push(&ring, &rec);
+    }
+    // Peek is oldest first and leaves the entries in place
+    CHECK_INT(sensor_ring_peek(&ring, out, 2), 2);
+    CHECK_INT(out[0].temperature, 0);
+    CHECK_INT(out[1].temperature, 1);
+    CHECK_INT(sensor_ring_peek(&ring, out, 8), 3);
+    CHECK_INT(ring.count, 3);
+    
+    sensor_ring_pop(&ring, 2);
+    CHECK_INT(sensor_ring_peek(&ring, out, 8), 1);
+    CHECK_INT(out[0].temperature, 2);
+    CHECK_INT(out[0].timestamp_us, 2 * SEC);
+    
+    // Popping more than is held empties the ring
+    sensor_ring_pop(&ring, 10);
+    CHECK_INT(ring.count, 0);
+    CHECK_INT(sensor_ring_peek(&ring, out, 8), 0);
+    CHECK_INT(ring.dropped, 0);
+}
+
+static void test_ring_overflow(void) {
+    // Offline longer than the ring holds: oldest readings are dropped
+    sensor_record_t out[SENSOR_LOG_SIZE];
+    memset(&ring, 0, sizeof(ring));
+    for (int i = 0; i < SENSOR_LOG_SIZE + 10; i++) {
+        sensor_record_t rec = record(i);
+        sensor_ring_push(&ring, &rec);
+    }
+    CHECK_INT(ring.count, SENSOR_LOG_SIZE);
+    CHECK_INT(ring.dropped, 10);
+    CHECK_INT(sensor_ring_peek(&ring, out, SENSOR_LOG_SIZE), SENSOR_LOG_SIZE);
+    for (int i = 0; i < SENSOR_LOG_SIZE; i++) {
+        if (out[i].temperature != i + 10) {
+            printf("overflow: slot %d holds %d\n", i, out[i].temperature);
+            test_failures++;
+            break;
+        }
+    }
+}
+
+static void test_ring_wrap(void) {
+    // Backfill in batches while new readings arrive: the indices wrap many
+    // times and the order survives
+    sensor_record_t out[16];
+    memset(&ring, 0, sizeof(ring));
+    int next_push = 0;
+    int next_expected = 0;
+    for (int round = 0; round < 200; round++) {
+        for (int i = 0; i < 7; i++) {
+            sensor_record_t rec = record(next_push++);
+            sensor_ring_push(&ring, &rec);
+        }
+        int n = sensor_ring_peek(&ring, out, 5 + round % 4);
+        for (int i = 0; i < n; i++) {
+            CHECK_INT(out[i].temperature, (int16_t)(next_expected + i));
+        }
+        sensor_ring_pop(&ring, n);
+        next_expected += n;
+    }
+    CHECK_INT(ring.count, next_push - next_expected);
+    CHECK_INT(ring.dropped, 0);
+    CHECK(next_push > 2 * SENSOR_LOG_SIZE);
+}
+
+static void test_filter_deadband(void) {
+    sensor_filter_t f = filter();
+    
+    // First reading always goes out and becomes the reference
+    CHECK(sensor_filter_accept(&f, 25, 60, 0));
+    
+    // Inside the humidity dead-band, temperature unchanged
+    CHECK(!sensor_filter_accept(&f, 25, 62, 20 * SEC));
+    CHECK(!sensor_filter_accept(&f, 25, 58, 30 * SEC));
+    
+    // Exactly on the dead-band edge, either direction, either field
+    CHECK(sensor_filter_accept(&f, 26, 60, 40 * SEC));
+    CHECK(sensor_filter_accept(&f, 25, 60, 50 * SEC));
+    CHECK(sensor_filter_accept(&f, 25, 63, 60 * SEC));
+    CHECK(sensor_filter_accept(&f, 25, 60, 70 * SEC));
+    
+    // Rejected readings don't move the reference - a slow creep is
+    // published once it adds up to the dead-band
+    f = filter();
+    f.deadband_temp = 2;
+    CHECK(sensor_filter_accept(&f, 20, 50, 0));
+    CHECK(!sensor_filter_accept(&f, 21, 50, 20 * SEC));
+    CHECK(sensor_filter_accept(&f, 22, 50, 40 * SEC));
+    CHECK_INT(f.last_temp, 22);
+    CHECK_INT(f.last_us, 40 * SEC);
+}
+
+static void test_filter_min_interval(void) {
+    sensor_filter_t f = filter();
+    CHECK(sensor_filter_accept(&f, 25, 60, 0));
+    
+    // A jump right after a publish waits for the interval
+    CHECK(!sensor_filter_accept(&f, 30, 60, 2 * SEC));
+    CHECK(!sensor_filter_accept(&f, 30, 60, 10 * SEC - 1));
+    CHECK(sensor_filter_accept(&f, 30, 60, 10 * SEC));
+    
+    // Bouncing between two values every second can't publish faster than
+    // the interval: 21, 32, 43, 54 and 65 s
+    int published = 0;
+    for (int i = 1; i <= 60; i++) {
+        published += sensor_filter_accept(&f, 30 + (i & 1) * 5, 60, 10 * SEC + i * SEC);
+    }
+    CHECK_INT(published, 5);
+    CHECK_INT(f.last_us, 65 * SEC);
+}
+
+static void test_filter_heartbeat(void) {
+    sensor_filter_t f = filter();
+    CHECK(sensor_filter_accept(&f, 25, 60, 0));
+    
+    // Steady readings stay quiet until the heartbeat is due
+    for (int t = 20; t < 300; t += 20) {
+        CHECK(!sensor_filter_accept(&f, 25, 60, t * SEC));
+    }
+    CHECK(sensor_filter_accept(&f, 25, 60, 300 * SEC));
+    CHECK(!sensor_filter_accept(&f, 25, 60, 320 * SEC));
+    CHECK(sensor_filter_accept(&f, 25, 60, 600 * SEC));
+    
+    // The heartbeat wins even when it is shorter than the interval
+    f = filter();
+    f.heartbeat_us = 5 * SEC;
+    CHECK(sensor_filter_accept(&f, 25, 60, 0));
+    CHECK(sensor_filter_accept(&f, 25, 60, 5 * SEC));
+}
+
+int main(void) {
+    test_ring_basic();
+    test_ring_overflow();
+    test_ring_wrap();
+    test_filter_deadband();
+    test_filter_min_interval();
+    test_filter_heartbeat();
+    return TEST_RESULT();
+}
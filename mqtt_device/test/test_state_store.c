@@ -0,0 +1,177 @@
+#include <stdint.h>
+#include "state_store.h"
+#include "esp_rom_crc.h"
+#include "fake_idf.h"
+#include "test_util.h"
+
+#define NS          "test"
+#define VERSION     3
+
+typedef struct {
+    uint8_t light[4];
+    uint8_t fan;
+    uint8_t speed;
+} test_state_t;
+
+// Blob layout from state_store.h: {version, size, crc32, payload}
+typedef struct {
+    uint16_t version;
+    uint16_t size;
+    uint32_t crc;
+} test_header_t;
+
+#define BLOB_SIZE (sizeof(test_header_t) + sizeof(test_state_t))
+
+static test_state_t state;
+static uint8_t toggle_count;
+
+static void put_blob(uint16_t version, uint16_t size, const test_state_t *payload, int corrupt) {
+    uint8_t blob[BLOB_SIZE];
+    test_header_t hdr = {version, size, esp_rom_crc32_le(0, (const uint8_t *)payload, sizeof(*payload))};
+    memcpy(blob, &hdr, sizeof(hdr));
+    memcpy(blob + sizeof(hdr), payload, sizeof(*payload));
+    if (corrupt) {
+        blob[BLOB_SIZE - 1] ^= 1;
+    }
+    fake_nvs_put(NS, STATE_STORE_KEY, blob, sizeof(blob));
+}
+
+static test_state_t stored_state(void) {
+    uint8_t blob[BLOB_SIZE + 1];
+    test_header_t hdr;
+    test_state_t payload;
+    CHECK_INT(fake_nvs_get(NS, STATE_STORE_KEY, blob, sizeof(blob)), BLOB_SIZE);
+    memcpy(&hdr, blob, sizeof(hdr));
+    memcpy(&payload, blob + sizeof(hdr), sizeof(payload));
+    CHECK_INT(hdr.version, VERSION);
+    CHECK_INT(hdr.size, sizeof(test_state_t));
+    CHECK_INT(hdr.crc, esp_rom_crc32_le(0, (const uint8_t *)&payload, sizeof(payload)));
+    return payload;
+}
+
+// One command from MQTT: change a light and mark the state dirty
+static void command(void) {
+    state.light[toggle_count % 4] ^= 1;
+    state.speed = ++toggle_count;
+    state_store_mark_dirty();
+}
+
+static void revert(void) {
+    toggle_count--;
+    state.light[toggle_count % 4] ^= 1;
+    state.speed = toggle_count;
+    state_store_mark_dirty();
+}
+
+static void test_load(void) {
+    const test_state_t saved = {{1, 0, 1, 0}, 1, 2};
+    
+    // Nothing on flash yet
+    CHECK(!state_store_load());
+    
+    // Version, size and CRC mismatches leave the defaults in place
+    put_blob(VERSION + 1, sizeof(test_state_t), &saved, 0);
+    CHECK(!state_store_load());
+    put_blob(VERSION, sizeof(test_state_t) - 1, &saved, 0);
+    CHECK(!state_store_load());
+    put_blob(VERSION, sizeof(test_state_t), &saved, 1);
+    CHECK(!state_store_load());
+    uint8_t short_blob[4] = {VERSION, 0, sizeof(test_state_t), 0};
+    fake_nvs_put(NS, STATE_STORE_KEY, short_blob, sizeof(short_blob));
+    CHECK(!state_store_load());
+    CHECK_INT(state.fan, 0);
+    CHECK_INT(state.speed, 0);
+    
+    put_blob(VERSION, sizeof(test_state_t), &saved, 0);
+    CHECK(state_store_load());
+    CHECK(memcmp(&state, &saved, sizeof(state)) == 0);
+    toggle_count = state.speed;
+}
+
+static void test_identical_skip(void) {
+    // Dirty but equal to what was just loaded: no flash write
+    state_store_mark_dirty();
+    fake_run(1000);
+    CHECK_INT(fake_nvs_commits, 0);
+    
+    // Changed and changed back before the commit: still no write
+    fake_schedule(1100, command);
+    fake_schedule(1200, revert);
+    fake_run(3000);
+    CHECK_INT(fake_nvs_commits, 0);
+}
+
+static void test_burst(void) {
+    // Ten commands inside 90 ms land in one commit after the settle time
+    for (int i = 0; i < 10; i++) {
+        fake_schedule(4000 + i * 10, command);
+    }
+    fake_run(5000);
+    CHECK_INT(fake_nvs_commits, 1);
+    CHECK_INT(fake_nvs_last_commit_ms, 4000 + STATE_STORE_SETTLE_MS);
+    test_state_t stored = stored_state();
+    CHECK(memcmp(&stored, &state, sizeof(state)) == 0);
+    
+    // Bursts spaced wider than the interval: one commit each
+    for (int burst = 0; burst < 3; burst++) {
+        for (int i = 0; i < 20; i++) {
+            fake_schedule(10000 + burst * 10000 + i * 25, command);
+        }
+    }
+    fake_run(30000 + STATE_STORE_SETTLE_MS);
+    CHECK_INT(fake_nvs_commits, 4);
+    CHECK_INT(fake_nvs_last_commit_ms, 30000 + STATE_STORE_SETTLE_MS);
+}
+
+static void test_min_interval(void) {
+    // A change soon after a commit waits out the interval, and changes
+    // arriving meanwhile ride along in the same write
+    int64_t last = fake_nvs_last_commit_ms;
+    fake_schedule(last + 1000, command);
+    fake_schedule(last + 2000, command);
+    fake_schedule(last + 4900, command);
+    fake_run(last + 20000);
+    CHECK_INT(fake_nvs_commits, 5);
+    CHECK_INT(fake_nvs_last_commit_ms, last + STATE_STORE_MIN_INTERVAL_MS);
+    test_state_t stored = stored_state();
+    CHECK_INT(stored.speed, state.speed);
+}
+
+static void test_failed_commit_retry(void) {
+    // A failed write backs off a full interval and then retries
+    int64_t start = fake_now_ms();
+    fake_nvs_fail_commits = 1;
+    fake_schedule(start + 100, command);
+    fake_run(start + 20000);
+    CHECK_INT(fake_nvs_commits, 6);
+    CHECK_INT(fake_nvs_last_commit_ms,
+              start + 100 + STATE_STORE_SETTLE_MS + STATE_STORE_MIN_INTERVAL_MS + STATE_STORE_SETTLE_MS);
+}
+
+static void test_shutdown_flush(void) {
+    // Pending change written by the restart handler, before the writer runs
+    command();
+    fake_shutdown();
+    CHECK_INT(fake_nvs_commits, 7);
+    test_state_t stored = stored_state();
+    CHECK_INT(stored.speed, state.speed);
+    
+    // Nothing pending: the handler does not write
+    fake_shutdown();
+    CHECK_INT(fake_nvs_commits, 7);
+}
+
+int main(void) {
+    fake_reset();
+    CHECK_INT(state_store_init(NS, &state, STATE_STORE_MAX_SIZE + 1, VERSION), ESP_ERR_INVALID_ARG);
+    CHECK_INT(state_store_init(NS, &state, sizeof(state), VERSION), ESP_OK);
+    
+    // One timeline - the store keeps its counters across steps
+    test_load();
+    test_identical_skip();
+    test_burst();
+    test_min_interval();
+    test_failed_commit_retry();
+    test_shutdown_flush();
+    return TEST_RESULT();
+}
@@ -0,0 +1,37 @@
+#ifndef _TEST_UTIL_H_
+#define _TEST_UTIL_H_
+
+#include <stdio.h>
+#include <string.h>
+
+// Minimal host test helpers - a failed check is reported and counted, the
+// test keeps going so one run shows every broken case
+static int test_failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+        test_failures++; \
+    } \
+} while (0)
+
+#define CHECK_INT(actual, expected) do { \
+    long long _a = (long long)(actual), _e = (long long)(expected); \
+    if (_a != _e) { \
+        printf("%s:%d: %s == %lld, expected %lld\n", __FILE__, __LINE__, #actual, _a, _e); \
+        test_failures++; \
+    } \
+} while (0)
+
+#define CHECK_STR(actual, expected) do { \
+    const char *_a = (actual), *_e = (expected); \
+    if (strcmp(_a, _e) != 0) { \
+        printf("%s:%d: %s == \"%s\", expected \"%s\"\n", __FILE__, __LINE__, #actual, _a, _e); \
+        test_failures++; \
+    } \
+} while (0)
+
+#define TEST_RESULT() (printf("%s: %s (%d failed)\n", __FILE__, \
+    test_failures ? "FAIL" : "ok", test_failures), test_failures ? 1 : 0)
+
+#endif // _TEST_UTIL_H_
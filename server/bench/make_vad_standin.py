@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+"""
+Build a stand-in for silero_vad.onnx, for VAD load benchmarks offline
+
+Same interface as Silero VAD v5 at 16 kHz - input [n, 64 + 512] float32,
+state [2, n, 128] float32, sr int64 -> output [n, 1], stateN [2, n, 128] -
+and the same layer shapes: STFT as a 256-tap strided conv, four conv
+encoder layers, a 128-unit LSTM and a 1x1 conv decoder. The weights are
+random, so the probabilities mean nothing, but the inference cost per
+window and per batch is close to the real model's. The decoder bias keeps
+every probability far below VAD_THRESHOLD, so streamed audio never opens
+a turn and a stream benchmark measures VAD alone. Use the real model
+(server/models/silero_vad.onnx) for anything that depends on detection.
+
+    python bench/make_vad_standin.py /tmp/silero_vad_standin.onnx
+    python bench/run_server.py --vad-model /tmp/silero_vad_standin.onnx
+"""
+import argparse
+
+import numpy as np
+import onnx
+from onnx import TensorProto, helper, numpy_helper
+
+CONTEXT = 64
+WINDOW = 512
+HIDDEN = 128
+FILTER = 256  # STFT: n_fft 256, hop 128 -> 129 bins
+HOP = 128
+
+
+def build(seed=0):
+    rng = np.random.default_rng(seed)
+    inits = []
+
+    def weight(name, *shape):
+        fan_in = int(np.prod(shape[1:])) if len(shape) > 1 else shape[0]
+        w = (rng.standard_normal(shape) / np.sqrt(fan_in)).astype(np.float32)
+        inits.append(numpy_helper.from_array(w, name))
+        return name
+
+    def const(name, values, dtype=np.int64):
+        inits.append(numpy_helper.from_array(np.array(values, dtype=dtype), name))
+        return name
+
+    nodes = [
+        # [n, 576] -> [n, 1, 640], reflect-padded like Silero's STFT
+        helper.make_node("Unsqueeze", ["input", const("axis1", [1])], ["x3"]),
+        helper.make_node("Pad", ["x3", const("stft_pad", [0, 0, 0, 0, 0, CONTEXT])], ["xp"], mode="reflect"),
+        helper.make_node("Conv", ["xp", weight("stft_basis", 2 * (FILTER // 2 + 1), 1, FILTER)], ["spec"],
+                         strides=[HOP]),
+        # Magnitude of the real/imaginary halves -> [n, 129, frames]
+        helper.make_node("Split", ["spec"], ["re", "im"], axis=1, num_outputs=2),
+        helper.make_node("Mul", ["re", "re"], ["re2"]),
+        helper.make_node("Mul", ["im", "im"], ["im2"]),
+        helper.make_node("Add", ["re2", "im2"], ["pow"]),
+        helper.make_node("Sqrt", ["pow"], ["mag"]),
+    ]
+
+    # Encoder: (in, out, stride)
+    prev = "mag"
+    for i, (cin, cout, stride) in enumerate([(FILTER // 2 + 1, 128, 1), (128, 64, 2), (64, 64, 2), (64, 128, 1)]):
+        nodes += [
+            helper.make_node("Conv", [prev, weight(f"enc{i}_w", cout, cin, 3), weight(f"enc{i}_b", cout)],
+                             [f"enc{i}"], pads=[1, 1], strides=[stride]),
+            helper.make_node("Relu", [f"enc{i}"], [f"enc{i}_r"]),
+        ]
+        prev = f"enc{i}_r"
+
+    nodes += [
+        # [n, 128, 1] -> [1, n, 128], one LSTM step carrying the session state
+        helper.make_node("Transpose", [prev], ["seq"], perm=[2, 0, 1]),
+        helper.make_node("Split", ["state"], ["h0", "c0"], axis=0, num_outputs=2),
+        helper.make_node("LSTM", ["seq", weight("lstm_w", 1, 4 * HIDDEN, HIDDEN), weight("lstm_r", 1, 4 * HIDDEN, HIDDEN),
+                                  weight("lstm_b", 1, 8 * HIDDEN), "", "h0", "c0"],
+                         ["lstm_y", "h1", "c1"], hidden_size=HIDDEN),
+        helper.make_node("Concat", ["h1", "c1"], ["stateN"], axis=0),
+        # Decoder: ReLU, 1x1 conv, sigmoid -> [n, 1]
+        helper.make_node("Squeeze", ["lstm_y", const("axes01", [0, 1])], ["h"]),
+        helper.make_node("Relu", ["h"], ["h_r"]),
+        helper.make_node("Unsqueeze", ["h_r", const("axis2", [2])], ["h3"]),
+        helper.make_node("Conv", ["h3", weight("dec_w", 1, HIDDEN, 1), const("dec_b", [-8.0], np.float32)], ["logit3"]),
+        helper.make_node("Squeeze", ["logit3", const("axis2b", [2])], ["logit"]),
+        helper.make_node("Sigmoid", ["logit"], ["output"]),
+    ]
+
+    graph = helper.make_graph(
+        nodes, "silero_vad_standin",
+        inputs=[
+            helper.make_tensor_value_info("input", TensorProto.FLOAT, ["n", CONTEXT + WINDOW]),
+            helper.make_tensor_value_info("state", TensorProto.FLOAT, [2, "n", HIDDEN]),
+            helper.make_tensor_value_info("sr", TensorProto.INT64, []),  # Accepted, 16 kHz assumed
+        ],
+        outputs=[
+            helper.make_tensor_value_info("output", TensorProto.FLOAT, ["n", 1]),
+            helper.make_tensor_value_info("stateN", TensorProto.FLOAT, [2, "n", HIDDEN]),
+        ],
+        initializer=inits,
+    )
+    model = helper.make_model(graph, opset_imports=[helper.make_opsetid("", 18)])
+    model.ir_version = 8  # Loadable by onnxruntime >= 1.14
+    onnx.checker.check_model(model)
+    return model
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("path")
+    parser.add_argument("--seed", type=int, default=0)
+    args = parser.parse_args()
+    model = build(args.seed)
+    onnx.save(model, args.path)
+    params = sum(int(np.prod(t.dims)) for t in model.graph.initializer)
+    print(f"Wrote {args.path} ({params} parameters)")
+
+
+if __name__ == "__main__":
+    main()
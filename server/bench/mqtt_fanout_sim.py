@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+"""
+mqtt_device fan-out simulation against a local mosquitto
+
+N simulated boards subscribe the way the firmware does and a publisher sends
+device commands at a fixed rate. Compares the legacy single topic
+(device/control - every board receives every command) with the per-node
+namespace (home/<node>/control + group/all scene topics).
+
+Reports broker deliveries/s, per-node received/s and how many of the
+messages a node received were not addressed to it (parsed for nothing).
+
+    mosquitto -p 1883 &
+    python bench/mqtt_fanout_sim.py --boards 8 --rate 20 --duration 30
+    python bench/mqtt_fanout_sim.py --boards 8 --rate 20 --mode legacy
+
+Needs paho-mqtt (requirements.txt).
+"""
+import argparse
+import json
+import random
+import threading
+import time
+
+import paho.mqtt.client as mqtt
+
+TOPIC_ROOT = "home"
+LEGACY_TOPIC = "device/control"
+
+
+def make_client(client_id):
+    try:
+        return mqtt.Client(mqtt.CallbackAPIVersion.VERSION2, client_id=client_id)
+    except AttributeError:
+        return mqtt.Client(client_id=client_id)  # paho-mqtt < 2.0
+
+
+class Board:
+    """One simulated mqtt_device - subscribes like main.c and counts messages"""
+
+    def __init__(self, args, index):
+        self.node = f"sim-node-{index:03d}"
+        self.group = f"room{index % args.groups}"
+        self.received = 0
+        self.addressed = 0
+        self.lock = threading.Lock()
+        self.client = make_client(f"{args.prefix}-{self.node}")
+        self.client.on_connect = self.on_connect
+        self.client.on_message = self.on_message
+        self.mode = args.mode
+        self.client.connect(args.host, args.port, keepalive=30)
+        self.client.loop_start()
+
+    def topics(self):
+        if self.mode == "legacy":
+            return [LEGACY_TOPIC]
+        return [f"{TOPIC_ROOT}/{self.node}/control",
+                f"{TOPIC_ROOT}/group/{self.group}/control",
+                f"{TOPIC_ROOT}/all/control"]
+
+    def on_connect(self, client, userdata, flags, *rest):
+        for topic in self.topics():
+            client.subscribe(topic, qos=0)
+
+    def on_message(self, client, userdata, msg):
+        # The firmware parses every message it gets - so does the simulation
+        target = json.loads(msg.payload).get("_target")
+        with self.lock:
+            self.received += 1
+            if target in (self.node, self.group, "all"):
+                self.addressed += 1
+
+    def stop(self):
+        self.client.loop_stop()
+        self.client.disconnect()
+
+
+class BrokerCounters:
+    """$SYS message counters, if the broker publishes them (sys_interval > 0)"""
+
+    def __init__(self, args):
+        self.values = {}
+        self.client = make_client(f"{args.prefix}-sys")
+        self.client.on_connect = lambda c, *a: c.subscribe("$SYS/broker/messages/#")
+        self.client.on_message = self.on_message
+        self.client.connect(args.host, args.port, keepalive=30)
+        self.client.loop_start()
+
+    def on_message(self, client, userdata, msg):
+        try:
+            self.values[msg.topic] = int(msg.payload)
+        except ValueError:
+            pass
+
+    def stop(self):
+        self.client.loop_stop()
+        self.client.disconnect()
+
+
+def pick_target(args, boards):
+    """Single-board command, or a scene with probability --scene-share"""
+    if random.random() < args.scene_share:
+        return random.choice([b.group for b in boards] + ["all"])
+    return random.choice(boards).node
+
+
+def topic_for(args, target, boards):
+    if args.mode == "legacy":
+        return LEGACY_TOPIC
+    if target == "all":
+        return f"{TOPIC_ROOT}/all/control"
+    if target.startswith("room"):
+        return f"{TOPIC_ROOT}/group/{target}/control"
+    return f"{TOPIC_ROOT}/{target}/control"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="localhost")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--boards", type=int, default=8)
+    parser.add_argument("--groups", type=int, default=2, help="Rooms the boards are spread over")
+    parser.add_argument("--rate", type=float, default=10.0, help="Commands published per second")
+    parser.add_argument("--duration", type=float, default=30.0)
+    parser.add_argument("--scene-share", type=float, default=0.1, help="Fraction of group/all commands")
+    parser.add_argument("--mode", choices=("namespaced", "legacy"), default="namespaced")
+    parser.add_argument("--prefix", default="fanout-sim")
+    args = parser.parse_args()
+
+    boards = [Board(args, i) for i in range(args.boards)]
+    sys_counters = BrokerCounters(args)
+    publisher = make_client(f"{args.prefix}-pub")
+    publisher.connect(args.host, args.port, keepalive=30)
+    publisher.loop_start()
+    time.sleep(1.0)  # Subscriptions in place
+
+    sys_before = dict(sys_counters.values)
+    published = 0
+    interval = 1.0 / args.rate
+    start = time.perf_counter()
+    next_send = start
+    while time.perf_counter() - start < args.duration:
+        target = pick_target(args, boards)
+        payload = json.dumps({"device": "light1", "value": published % 2, "_target": target})
+        publisher.publish(topic_for(args, target, boards), payload, qos=0)
+        published += 1
+        next_send += interval
+        time.sleep(max(0.0, next_send - time.perf_counter()))
+    elapsed = time.perf_counter() - start
+    time.sleep(1.0)  # Drain - late deliveries still count against the send window
+
+    received = [b.received for b in boards]
+    wasted = sum(b.received - b.addressed for b in boards)
+    total = sum(received)
+    print(f"mode={args.mode} boards={args.boards} groups={args.groups} "
+          f"rate={args.rate}/s scene_share={args.scene_share}")
+    print(f"published        {published / elapsed:8.1f} msg/s")
+    print(f"broker delivered {total / elapsed:8.1f} msg/s (fan-out x{total / max(published, 1):.2f})")
+    print(f"per node         {total / elapsed / len(boards):8.1f} msg/s avg, {max(received) / elapsed:.1f} max")
+    print(f"not addressed    {wasted / max(total, 1) * 100:8.1f} % of messages parsed")
+
+    sent_key = "$SYS/broker/messages/sent"
+    if sent_key in sys_before and sent_key in sys_counters.values:
+        print(f"broker $SYS sent {(sys_counters.values[sent_key] - sys_before[sent_key]) / elapsed:8.1f} msg/s")
+
+    for b in boards:
+        b.stop()
+    sys_counters.stop()
+    publisher.loop_stop()
+    publisher.disconnect()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+"""
+Run server_streaming_n8n.py against local stand-ins
+
+Imports the server unmodified and overrides its config before main():
+n8n webhook URL, TTS backend (bench/stub_tts.py), encoder, ports, uplink
+impairment and fast path. Debug audio saving is off so disk writes don't
+skew the numbers.
+
+    python bench/stub_n8n.py &
+    python bench/run_server.py --tts stub
+    python bench/ws_load.py --clients 8 --turns 5
+
+On a host without ffmpeg add --encoder cat (see stub_tts.py).
+
+Offline, VAD load can be measured on a stand-in model with Silero's
+interface and cost (bench/make_vad_standin.py) via --vad-model.
+--vad-inline runs each window synchronously on the event loop instead of
+through the batcher - the pre-batching execution model, for comparison.
+"""
+import argparse
+import asyncio
+import os
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+
+import stub_tts  # noqa: E402
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--n8n-url", default="http://127.0.0.1:5678/webhook/bench")
+    parser.add_argument("--port", type=int, default=6666)
+    parser.add_argument("--http-port", type=int, default=6667)
+    parser.add_argument("--tts", choices=("stub", "say"), default="stub")
+    parser.add_argument("--tts-startup-ms", type=float, default=150.0, help="Stub: fixed cost per synthesis call")
+    parser.add_argument("--tts-per-char-ms", type=float, default=4.0, help="Stub: cost per character")
+    parser.add_argument("--encoder", choices=("ffmpeg", "cat"), default="ffmpeg")
+    parser.add_argument("--uplink-delay-ms", type=float, default=0, help="Added per received audio frame")
+    parser.add_argument("--uplink-bps", type=int, default=0, help="Uplink bandwidth cap (bytes/s)")
+    parser.add_argument("--vad-batch-ms", type=float, help="Override VAD_BATCH_WINDOW_MS")
+    parser.add_argument("--vad-model", help="ONNX model to load instead of VAD_ONNX_PATH")
+    parser.add_argument("--vad-workers", type=int, help="Override VAD_WORKERS")
+    parser.add_argument("--vad-inline", action="store_true", help="One window per inference, on the event loop")
+    parser.add_argument("--fast-path", action="store_true", help="Keep the fast path if FASTPATH_ENABLED loaded it")
+    parser.add_argument("--mqtt-host", help="Fast path: broker to publish to (e.g. a local mosquitto)")
+    parser.add_argument("--mqtt-port", type=int, default=1883)
+    args = parser.parse_args()
+
+    import onnxruntime as ort
+    import server_streaming_n8n as server
+    from aiohttp import web
+
+    server.web = web  # Imported under __main__ in the server
+    server.N8N_WEBHOOK_URL = args.n8n_url
+    server.PORT = args.port
+    server.HTTP_PORT = args.http_port
+    server.DEBUG_SAVE_AUDIO = False
+    server.DEBUG_UPLINK_DELAY_MS = args.uplink_delay_ms
+    server.DEBUG_UPLINK_BPS = args.uplink_bps
+    if args.vad_batch_ms is not None:
+        server.VAD_BATCH_WINDOW_MS = args.vad_batch_ms
+    if args.vad_workers is not None:
+        server.VAD_WORKERS = args.vad_workers
+        server.vad_batcher = server.VADBatcher()  # Executor is sized at construction
+    if args.vad_model:
+        options = ort.SessionOptions()
+        options.intra_op_num_threads = 1
+        options.inter_op_num_threads = 1
+        server.vad_session = ort.InferenceSession(args.vad_model, options, providers=["CPUExecutionProvider"])
+        server.VAD_AVAILABLE = True
+    if args.vad_inline:
+        async def infer(vad, window):
+            return server.run_vad_batch([(vad, window)])[0]
+        server.vad_batcher.infer = infer
+    if not args.fast_path:
+        server.asr_model = None
+    if args.mqtt_host:
+        server.MQTT_BROKER_HOST = args.mqtt_host
+        server.MQTT_BROKER_PORT = args.mqtt_port
+    if args.tts == "stub":
+        stub_tts.install(server, startup_ms=args.tts_startup_ms, per_char_ms=args.tts_per_char_ms)
+    if args.encoder == "cat":
+        stub_tts.use_passthrough_encoder(server)
+
+    server.logger.info(f"Bench config: n8n={args.n8n_url} tts={args.tts} encoder={args.encoder} "
+                       f"vad={'on' if server.VAD_AVAILABLE else 'off'}{' inline' if args.vad_inline else ''}")
+    try:
+        asyncio.run(server.main())
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
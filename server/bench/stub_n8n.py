@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+"""
+Stand-in n8n webhook for latency benchmarks
+
+Accepts the same multipart upload as the real workflow (file, device_id,
+conversation_id, followup), waits --think-ms to stand in for ASR + LLM,
+then streams a silent 128 kbps MP3 reply at --synth-kbps, the way a TTS
+node produces it. --buffered holds the whole reply back and sends it in
+one go instead (what a non-streaming workflow looks like).
+
+Counts requests and how many arrived on a reused keep-alive connection.
+
+    python bench/stub_n8n.py --port 5678 --think-ms 800 --reply-kb 64 --synth-kbps 512
+    curl localhost:5678/stats
+
+Point the server at it with bench/run_server.py --n8n-url
+http://127.0.0.1:5678/webhook/bench
+"""
+import argparse
+import asyncio
+import time
+
+from aiohttp import web
+
+MP3_FRAME_BYTES = 417  # MPEG-1 Layer III, 128 kbps, 44.1 kHz, no padding
+# Mono frame header; zero side info decodes as silence
+MP3_SILENT_FRAME = bytes([0xFF, 0xFB, 0x90, 0xC0]) + bytes(MP3_FRAME_BYTES - 4)
+
+
+def silent_mp3(size):
+    frames = max(1, size // MP3_FRAME_BYTES)
+    return MP3_SILENT_FRAME * frames
+
+
+class Stats:
+    def __init__(self):
+        self.requests = 0
+        self.reused = 0
+        self.upload_bytes = 0
+        self.devices = set()
+        self.seen_peers = set()
+        self.in_flight = 0
+        self.max_in_flight = 0
+
+    def snapshot(self):
+        return {
+            "requests": self.requests,
+            "reused_connections": self.reused,
+            "new_connections": self.requests - self.reused,
+            "upload_bytes": self.upload_bytes,
+            "devices": len(self.devices),
+            "max_in_flight": self.max_in_flight,
+        }
+
+
+stats = Stats()
+
+
+async def handle_webhook(request):
+    args = request.app["args"]
+    received = time.perf_counter()
+
+    # Same socket as an earlier request = the caller kept the connection alive
+    peer = request.transport.get_extra_info("peername") if request.transport else None
+    if peer in stats.seen_peers:
+        stats.reused += 1
+    stats.seen_peers.add(peer)
+
+    form = await request.post()
+    upload = form.get("file")
+    size = len(upload.file.read()) if upload is not None else 0
+    stats.requests += 1
+    stats.upload_bytes += size
+    stats.devices.add(form.get("device_id", "?"))
+    stats.in_flight += 1
+    stats.max_in_flight = max(stats.max_in_flight, stats.in_flight)
+
+    try:
+        await asyncio.sleep(args.think_ms / 1000)
+
+        reply = silent_mp3(args.reply_kb * 1024)
+        resp = web.StreamResponse(headers={"Content-Type": "audio/mpeg"})
+        await resp.prepare(request)
+
+        if args.buffered:
+            # Whole reply synthesized before the first byte leaves
+            await asyncio.sleep(len(reply) * 8 / (args.synth_kbps * 1000))
+            await resp.write(reply)
+        else:
+            chunk = args.chunk
+            per_chunk_sec = chunk * 8 / (args.synth_kbps * 1000)
+            start = time.perf_counter()
+            for i, offset in enumerate(range(0, len(reply), chunk)):
+                due = start + (i + 1) * per_chunk_sec
+                delay = due - time.perf_counter()
+                if delay > 0:
+                    await asyncio.sleep(delay)
+                await resp.write(reply[offset:offset + chunk])
+        await resp.write_eof()
+
+        if args.verbose:
+            print(f"{form.get('device_id', '?')}: {size} B in, {len(reply)} B out, "
+                  f"{(time.perf_counter() - received) * 1000:.0f} ms")
+        return resp
+    finally:
+        stats.in_flight -= 1
+
+
+async def handle_stats(request):
+    return web.json_response(stats.snapshot())
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=5678)
+    parser.add_argument("--think-ms", type=float, default=800, help="Delay before the first reply byte")
+    parser.add_argument("--reply-kb", type=int, default=64, help="Reply size (64 KB = ~4 s of speech)")
+    parser.add_argument("--synth-kbps", type=float, default=512, help="Rate the reply is produced at (128 = real time)")
+    parser.add_argument("--chunk", type=int, default=4096, help="Bytes per streamed write")
+    parser.add_argument("--buffered", action="store_true", help="Send the reply only once fully produced")
+    parser.add_argument("--verbose", action="store_true")
+    args = parser.parse_args()
+
+    app = web.Application(client_max_size=4 * 1024 * 1024)
+    app["args"] = args
+    app.router.add_post("/webhook/{hook}", handle_webhook)
+    app.router.add_get("/stats", handle_stats)
+    mode = "buffered" if args.buffered else "streamed"
+    print(f"stub n8n on {args.host}:{args.port} - think {args.think_ms:.0f} ms, "
+          f"{args.reply_kb} KB reply {mode} at {args.synth_kbps:.0f} kbps")
+    web.run_app(app, host=args.host, port=args.port, print=None)
+
+
+if __name__ == "__main__":
+    main()
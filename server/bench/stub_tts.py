@@ -0,0 +1,57 @@
+"""
+Stub TTS for benchmarks - stands in for macOS `say`
+
+StubBackend implements the server's pluggable synthesis interface
+(async synthesize(text, voice) -> s16le PCM at TTS_PCM_RATE). It costs a
+fixed startup plus a per-character time, like a `say` process, and returns
+a tone as long as the text would take to speak. The delay is a sleep, not
+CPU, so the numbers isolate the pipeline (queueing, segment overlap,
+encoder pool) from the engine.
+
+use_passthrough_encoder() swaps the ffmpeg encoders for `cat`, for hosts
+without ffmpeg: the device then receives raw PCM labelled as MP3, which the
+load generator doesn't decode anyway.
+
+Used by bench/run_server.py (--tts stub, --encoder cat).
+"""
+import asyncio
+
+import numpy as np
+
+
+class StubBackend:
+    """Fixed + per-character synthesis delay, tone output"""
+
+    def __init__(self, pcm_rate, startup_ms=150.0, per_char_ms=4.0, chars_per_sec=15.0):
+        self.pcm_rate = pcm_rate
+        self.startup_ms = startup_ms
+        self.per_char_ms = per_char_ms
+        self.chars_per_sec = chars_per_sec
+        self.version = f"tone-{chars_per_sec}"  # Cache key: the tone length depends on it
+        self.calls = 0
+
+    async def synthesize(self, text, voice):
+        self.calls += 1
+        await asyncio.sleep((self.startup_ms + self.per_char_ms * len(text)) / 1000)
+        samples = max(1, int(len(text) / self.chars_per_sec * self.pcm_rate))
+        t = np.arange(samples, dtype=np.float32) / self.pcm_rate
+        return (np.sin(2 * np.pi * 220 * t) * 3000).astype("<i2").tobytes()
+
+
+def install(server, **kwargs):
+    """Register the stub as the server's synthesis backend"""
+    server.TTS_BACKENDS["stub"] = StubBackend
+    server.TTS_BACKEND = "stub"
+    server.tts_backend = StubBackend(server.TTS_PCM_RATE, **kwargs)
+    return server.tts_backend
+
+
+def use_passthrough_encoder(server):
+    """Encoder pool spawns `cat` instead of ffmpeg (same pipes, no encoding)"""
+    async def spawn(filters):
+        return await asyncio.create_subprocess_exec(
+            "cat",
+            stdin=asyncio.subprocess.PIPE,
+            stdout=asyncio.subprocess.PIPE,
+        )
+    server.encoder_pool._spawn = spawn
@@ -0,0 +1,451 @@
+#!/usr/bin/env python3
+"""
+Multi-device WebSocket load generator for server_streaming_n8n.py
+
+Each client connects like the LyraT (ws://host:port/?device_id=..&group=..)
+and speaks the device protocol: TURN, paced PCM uplink, END, BARGE_IN,
+AUDIO_START/AUDIO_END, CLIP_STORE/CLIP_PLAY. Audio comes from the debug
+WAVs (16 kHz mono s16le), round-robin across clients.
+
+Modes:
+  turns   Each client runs --turns voice turns and times the reply from
+          its endpoint: END sent (--endpoint device) or the last speech
+          frame (--endpoint server, waits for STOP_RECORDING - needs the
+          VAD model, without it every frame counts as speech and turns
+          end at MAX_RECORDING_SEC)
+  stream  Clients stream continuously for --duration with no turns - VAD
+          load (chunk p50/p99, streams per core, per-device RTF), and how
+          long a light HTTP request takes meanwhile (event loop stalls)
+  speak   Clients stay connected while --speak-concurrency workers POST
+          /speak to them - TTS throughput and time to audio
+
+    python bench/stub_n8n.py &
+    python bench/run_server.py --tts stub &
+    python bench/ws_load.py --clients 8 --turns 5
+    python bench/ws_load.py --clients 32 --mode stream --duration 60
+    python bench/ws_load.py --clients 4 --mode speak --phrases 40 --speak-concurrency 8
+    python bench/ws_load.py --clients 4 --mode speak --phrases 200 --speak-concurrency 16 --unique-phrases
+
+Voice-to-actuation on the fast path: add --mqtt-host to time the MQTT
+command from the endpoint (one client - messages are matched FIFO).
+
+Prints per-turn latency percentiles, then the server's /status sections.
+"""
+import argparse
+import asyncio
+import glob
+import json
+import os
+import random
+import time
+import wave
+from collections import deque
+
+import aiohttp
+import numpy as np
+import websockets
+
+BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_WAVS = os.path.join(BENCH_DIR, "..", "debug_audio", "*.wav")
+SAMPLE_RATE = 16000
+
+SPEAK_PHRASES = [
+    "Đã bật đèn phòng khách.",
+    "Đã tắt quạt.",
+    "Bây giờ là mười giờ sáng. Nhiệt độ trong phòng là hai mươi sáu độ.",
+    "Good morning. The weather today is sunny with a high of thirty degrees. "
+    "Remember to take an umbrella in the afternoon, showers are expected after four.",
+    "OK.",
+]
+
+
+def percentiles(values):
+    if not values:
+        return "n=0"
+    arr = np.array(values) * 1000
+    return (f"n={len(arr)} p50={np.percentile(arr, 50):.0f} p90={np.percentile(arr, 90):.0f} "
+            f"p99={np.percentile(arr, 99):.0f} max={arr.max():.0f} ms")
+
+
+def load_audio(pattern):
+    clips = []
+    for path in sorted(glob.glob(pattern)):
+        with wave.open(path, "rb") as w:
+            if w.getnchannels() != 1 or w.getsampwidth() != 2 or w.getframerate() != SAMPLE_RATE:
+                continue
+            clips.append(w.readframes(w.getnframes()))
+    if not clips:
+        # Synthetic fallback: a warbling tone the VAD may or may not call speech
+        t = np.arange(SAMPLE_RATE * 10) / SAMPLE_RATE
+        tone = np.sin(2 * np.pi * (180 + 60 * np.sin(2 * np.pi * 3 * t)) * t) * 8000
+        clips.append(tone.astype("<i2").tobytes())
+    return clips
+
+
+class Results:
+    def __init__(self):
+        self.to_start = []      # Endpoint → AUDIO_START / CLIP_PLAY
+        self.to_first = []      # Endpoint → first audio byte
+        self.to_end = []        # Endpoint → AUDIO_END
+        self.to_actuation = []  # Endpoint → MQTT command seen
+        self.pending_actuation = deque()  # Endpoints waiting for their MQTT command
+        self.barge_stop = []    # BARGE_IN → last reply byte received
+        self.speak_http = []    # /speak request round trip
+        self.speak_first = []   # /speak POST → first audio at the device
+        self.http_probe = []    # GET /sweep round trip while streaming
+        self.stop_recording = 0
+        self.timeouts = 0
+        self.barge_ins = 0
+        self.clips_stored = 0
+        self.clip_plays = 0
+        self.bytes_down = 0
+        self.frames_up = 0
+
+
+class Device:
+    """One emulated LyraT"""
+
+    def __init__(self, args, index, audio, results):
+        self.args = args
+        self.device_id = f"{args.prefix}-{index:03d}"
+        self.audio = audio
+        self.results = results
+        self.ws = None
+        self.events = asyncio.Queue()   # (kind, time) from the receiver
+        self.clip_rx = None             # [id, size, received] while a CLIP_STORE is open
+        self.clips = set()
+        self.speak_lock = asyncio.Lock()  # One /speak in flight per device
+        self.cursor = random.Random(index).randrange(0, len(audio[0]) // 2) * 2
+
+    async def connect(self):
+        url = f"ws://{self.args.host}:{self.args.port}/?device_id={self.device_id}&group={self.args.group}"
+        self.ws = await websockets.connect(url, max_size=None, ping_interval=None)
+        asyncio.create_task(self.receive())
+
+    async def receive(self):
+        try:
+            async for message in self.ws:
+                now = time.perf_counter()
+                if isinstance(message, bytes):
+                    if self.clip_rx is not None:
+                        self.clip_rx[2] += len(message)
+                        if self.clip_rx[2] >= self.clip_rx[1]:
+                            self.clips.add(self.clip_rx[0])
+                            await self.ws.send(f"CLIP_STORED {self.clip_rx[0]}")
+                            self.results.clips_stored += 1
+                            self.clip_rx = None
+                        continue
+                    self.results.bytes_down += len(message)
+                    self.events.put_nowait(("audio", now))
+                    continue
+
+                kind, _, rest = message.partition(" ")
+                if kind == "CLIP_STORE":
+                    cid, size = rest.split()
+                    self.clip_rx = [cid, int(size), 0]
+                    continue
+                self.clip_rx = None  # Any other text frame abandons an upload
+                if kind == "CLIP_PLAY":
+                    if rest in self.clips:
+                        self.results.clip_plays += 1
+                        self.events.put_nowait(("clip", now))
+                    else:
+                        await self.ws.send(f"CLIP_MISS {rest}")
+                elif kind in ("AUDIO_START", "AUDIO_END", "STOP_RECORDING"):
+                    self.events.put_nowait((kind, now))
+        except websockets.ConnectionClosed:
+            pass
+        finally:
+            self.events.put_nowait(("closed", time.perf_counter()))
+
+    def next_frame(self, clip_index, silence=False):
+        size = self.args.chunk_bytes * self.args.batch
+        if silence:
+            return bytes(size)
+        pcm = self.audio[clip_index % len(self.audio)]
+        if self.cursor + size > len(pcm):
+            self.cursor = 0
+        frame = pcm[self.cursor:self.cursor + size]
+        self.cursor += size
+        return frame
+
+    async def send_paced(self, frames_fn, seconds, until=None):
+        """Stream frames in real time for up to seconds, or until an event kind"""
+        frame_sec = self.args.chunk_bytes * self.args.batch / 2 / SAMPLE_RATE
+        start = time.perf_counter()
+        sent = 0
+        while time.perf_counter() - start < seconds:
+            await self.ws.send(frames_fn())
+            self.results.frames_up += 1
+            sent += 1
+            if until is not None and self.peek_event(until):
+                return True
+            delay = start + sent * frame_sec - time.perf_counter()
+            if delay > 0:
+                await asyncio.sleep(delay)
+        return False
+
+    def peek_event(self, kinds):
+        return any(kind in kinds for kind, _ in list(self.events._queue))
+
+    async def wait_event(self, kinds, timeout):
+        deadline = time.perf_counter() + timeout
+        while True:
+            remaining = deadline - time.perf_counter()
+            if remaining <= 0:
+                return None, None
+            try:
+                kind, t = await asyncio.wait_for(self.events.get(), remaining)
+            except asyncio.TimeoutError:
+                return None, None
+            if kind in kinds or kind == "closed":
+                return kind, t
+
+    async def run_turn(self, turn):
+        args = self.args
+        clip_index = turn + int(self.device_id[-3:])
+        while not self.events.empty():
+            self.events.get_nowait()
+
+        await self.ws.send("TURN wake")
+        await self.send_paced(lambda: self.next_frame(clip_index), args.speech_sec)
+
+        if args.endpoint == "device":
+            await self.ws.send("END")
+            endpoint = time.perf_counter()
+        else:
+            # Trailing silence until the server endpoints (or gives up)
+            endpoint = time.perf_counter()
+            stopped = await self.send_paced(lambda: self.next_frame(clip_index, silence=True),
+                                            args.timeout, until=("STOP_RECORDING", "AUDIO_START"))
+            if stopped and self.peek_event(("STOP_RECORDING",)):
+                self.results.stop_recording += 1
+        if args.mqtt_host:
+            self.results.pending_actuation.append(endpoint)
+
+        kind, t = await self.wait_event(("AUDIO_START", "clip"), args.timeout)
+        if kind is None or kind == "closed":
+            self.results.timeouts += 1
+            return
+        self.results.to_start.append(t - endpoint)
+        if kind == "clip":
+            self.results.to_first.append(t - endpoint)
+            self.results.to_end.append(t - endpoint)
+            return
+
+        kind, t = await self.wait_event(("audio", "AUDIO_END"), args.timeout)
+        if kind == "audio":
+            self.results.to_first.append(t - endpoint)
+            if args.barge_in_ms is not None:
+                await self.barge_in()
+                return
+        if kind != "AUDIO_END":
+            kind, t = await self.wait_event(("AUDIO_END",), args.timeout)
+        if kind == "AUDIO_END":
+            self.results.to_end.append(t - endpoint)
+        else:
+            self.results.timeouts += 1
+
+    async def barge_in(self):
+        """Interrupt the reply - the server cancels it without AUDIO_END"""
+        await asyncio.sleep(self.args.barge_in_ms / 1000)
+        while not self.events.empty():
+            self.events.get_nowait()
+        sent = time.perf_counter()
+        await self.ws.send("BARGE_IN")
+        self.results.barge_ins += 1
+
+        # Audio still arriving after the BARGE_IN was already in flight
+        last = sent
+        while True:
+            kind, t = await self.wait_event(("audio", "AUDIO_END"), 1.0)
+            if kind != "audio":
+                break
+            last = t
+        self.results.barge_stop.append(last - sent)
+
+    async def run_turns(self):
+        for turn in range(self.args.turns):
+            await self.run_turn(turn)
+            await asyncio.sleep(self.args.gap * random.uniform(0.5, 1.5))
+
+    async def run_stream(self):
+        await self.send_paced(lambda: self.next_frame(0), self.args.duration)
+
+
+async def mqtt_actuation_listener(args, results):
+    """Time fast-path MQTT commands against pending endpoints (FIFO)"""
+    import paho.mqtt.client as mqtt
+    loop = asyncio.get_running_loop()
+
+    def on_message(client, userdata, msg):
+        now = time.perf_counter()
+        loop.call_soon_threadsafe(match, now)
+
+    def match(now):
+        if results.pending_actuation:
+            results.to_actuation.append(now - results.pending_actuation.popleft())
+
+    try:
+        client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2, client_id=f"{args.prefix}-mqtt")
+    except AttributeError:
+        client = mqtt.Client(client_id=f"{args.prefix}-mqtt")
+    client.on_connect = lambda c, *a: c.subscribe(args.mqtt_topic)
+    client.on_message = on_message
+    client.connect(args.mqtt_host, args.mqtt_port, keepalive=30)
+    client.loop_start()
+    return client
+
+
+async def probe_http(args, results, http):
+    """Time a cheap HTTP request every 100 ms - it waits behind anything blocking the event loop"""
+    url = f"http://{args.host}:{args.http_port}/sweep"
+    while True:
+        start = time.perf_counter()
+        async with http.get(url) as resp:
+            await resp.read()
+        results.http_probe.append(time.perf_counter() - start)
+        await asyncio.sleep(0.1)
+
+
+async def run_speak(args, devices, results, http):
+    """Concurrent /speak requests round-robin over the devices"""
+    queue = asyncio.Queue()
+    run = random.randrange(10 ** 6)
+    for i in range(args.phrases):
+        text = SPEAK_PHRASES[i % len(SPEAK_PHRASES)]
+        if args.unique_phrases:
+            text = f"{text} {run} {i}."  # Miss the TTS cache, every request synthesizes and encodes
+        queue.put_nowait((devices[i % len(devices)], text))
+    url = f"http://{args.host}:{args.http_port}/speak"
+
+    async def worker():
+        while not queue.empty():
+            device, text = queue.get_nowait()
+            async with device.speak_lock:
+                while not device.events.empty():
+                    device.events.get_nowait()
+                start = time.perf_counter()
+                first = asyncio.create_task(device.wait_event(("audio", "clip"), args.timeout))
+                async with http.post(url, json={"text": text, "device": device.device_id}) as resp:
+                    await resp.read()
+                results.speak_http.append(time.perf_counter() - start)
+                kind, t = await first
+                if kind in ("audio", "clip"):
+                    results.speak_first.append(t - start)
+                else:
+                    results.timeouts += 1
+
+    start = time.perf_counter()
+    await asyncio.gather(*(worker() for _ in range(args.speak_concurrency)))
+    return time.perf_counter() - start
+
+
+def print_status(status, mode):
+    sections = {
+        "turns": ("endpointing", "first_audio", "first_audio_by_turn", "n8n_upload", "fast_path", "vad"),
+        "stream": ("vad",),
+        "speak": ("tts", "tts_cache", "device_clips"),
+    }[mode]
+    for key in sections:
+        if key in status:
+            print(f"  {key}: {json.dumps(status[key])}")
+    if mode == "stream":
+        rtf = [d["vad_rtf"] for d in status.get("devices", [])]
+        if rtf:
+            print(f"  device vad_rtf: avg {np.mean(rtf):.4f} p50 {np.percentile(rtf, 50):.4f} "
+                  f"p99 {np.percentile(rtf, 99):.4f} max {max(rtf):.4f} over {len(rtf)} devices")
+
+
+async def main_async(args):
+    audio = load_audio(args.wav)
+    results = Results()
+    devices = [Device(args, i, audio, results) for i in range(args.clients)]
+    await asyncio.gather(*(d.connect() for d in devices))
+    print(f"{len(devices)} clients connected, mode={args.mode}")
+
+    mqtt_client = await mqtt_actuation_listener(args, results) if args.mqtt_host else None
+    async with aiohttp.ClientSession() as http:
+        start = time.perf_counter()
+        if args.mode == "turns":
+            # Stagger so turns don't all endpoint on the same tick
+            async def staggered(d, i):
+                await asyncio.sleep(i * args.gap / max(1, len(devices)))
+                await d.run_turns()
+            await asyncio.gather(*(staggered(d, i) for i, d in enumerate(devices)))
+        elif args.mode == "stream":
+            probe = asyncio.create_task(probe_http(args, results, http))
+            await asyncio.gather(*(d.run_stream() for d in devices))
+            probe.cancel()
+        else:
+            elapsed = await run_speak(args, devices, results, http)
+        wall = time.perf_counter() - start
+
+        print(f"\n== {args.mode}: {args.clients} clients, {wall:.1f} s ==")
+        if args.mode == "turns":
+            print(f"endpoint -> AUDIO_START  {percentiles(results.to_start)}")
+            print(f"endpoint -> first audio  {percentiles(results.to_first)}")
+            print(f"endpoint -> AUDIO_END    {percentiles(results.to_end)}")
+            if args.mqtt_host:
+                print(f"endpoint -> MQTT command {percentiles(results.to_actuation)}")
+            if args.barge_in_ms is not None:
+                print(f"BARGE_IN -> last byte    {percentiles(results.barge_stop)}")
+            print(f"STOP_RECORDING {results.stop_recording}, barge-ins {results.barge_ins}, "
+                  f"timeouts {results.timeouts}, downlink {results.bytes_down / 1024:.0f} KB")
+        elif args.mode == "stream":
+            audio_sec = results.frames_up * args.chunk_bytes * args.batch / 2 / SAMPLE_RATE
+            print(f"uplink {results.frames_up} frames, {audio_sec:.0f} s of audio "
+                  f"({audio_sec / wall:.1f}x real time across clients)")
+            print(f"GET /sweep under load     {percentiles(results.http_probe)}")
+        else:
+            print(f"/speak round trip         {percentiles(results.speak_http)}")
+            print(f"/speak -> device audio    {percentiles(results.speak_first)}")
+            print(f"throughput {args.phrases / elapsed:.2f} phrases/s, clips stored {results.clips_stored}, "
+                  f"clip plays {results.clip_plays}, timeouts {results.timeouts}")
+
+        try:
+            async with http.get(f"http://{args.host}:{args.http_port}/status") as resp:
+                status = await resp.json()
+            print("server /status:")
+            print_status(status, args.mode)
+        except Exception as e:
+            print(f"/status unavailable: {e}")
+
+    if mqtt_client is not None:
+        mqtt_client.loop_stop()
+    for device in devices:
+        await device.ws.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=6666)
+    parser.add_argument("--http-port", type=int, default=6667)
+    parser.add_argument("--clients", type=int, default=4)
+    parser.add_argument("--mode", choices=("turns", "stream", "speak"), default="turns")
+    parser.add_argument("--wav", default=DEFAULT_WAVS, help="Glob of 16 kHz mono WAVs to stream")
+    parser.add_argument("--chunk-bytes", type=int, default=2048, help="AUDIO_CHUNK_SIZE on the device")
+    parser.add_argument("--batch", type=int, default=3, help="Chunks per WebSocket frame")
+    parser.add_argument("--turns", type=int, default=5)
+    parser.add_argument("--speech-sec", type=float, default=2.0, help="Audio streamed per turn before the endpoint")
+    parser.add_argument("--endpoint", choices=("device", "server"), default="device",
+                        help="Device sends END, or the server's silence timeout decides")
+    parser.add_argument("--barge-in-ms", type=float, help="Send BARGE_IN this long after the first reply byte")
+    parser.add_argument("--gap", type=float, default=1.0, help="Seconds between a client's turns")
+    parser.add_argument("--duration", type=float, default=30.0, help="stream mode length")
+    parser.add_argument("--phrases", type=int, default=20, help="speak mode: /speak requests in total")
+    parser.add_argument("--speak-concurrency", type=int, default=4)
+    parser.add_argument("--unique-phrases", action="store_true", help="speak mode: bypass the TTS cache")
+    parser.add_argument("--timeout", type=float, default=30.0)
+    parser.add_argument("--group", default="bench")
+    parser.add_argument("--prefix", default="bench")
+    parser.add_argument("--mqtt-host", help="Time fast-path MQTT commands on this broker")
+    parser.add_argument("--mqtt-port", type=int, default=1883)
+    parser.add_argument("--mqtt-topic", default="home/+/control")
+    args = parser.parse_args()
+    asyncio.run(main_async(args))
+
+
+if __name__ == "__main__":
+    main()
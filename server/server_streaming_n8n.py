@@ -11,16 +11,28 @@ ESP32 streams audio continuously, server uses VAD to detect when user speaks.
 """
 
 import asyncio
+import hashlib
+import json
 import logging
 import os
+import re
+import struct
 import sys
 import tempfile
+import time
+import urllib.parse
+import urllib.request
+import uuid
+import wave
+from contextlib import aclosing
+from concurrent.futures import ThreadPoolExecutor
 from datetime import datetime
-from collections import deque
+from types import SimpleNamespace
+from collections import Counter, OrderedDict, deque
 
 import aiohttp
 import numpy as np
-import torch
+import onnxruntime as ort
 import websockets
 
 logging.basicConfig(
@@ -40,6 +52,15 @@ DEBUG_LOG_INTERVAL = 20  # Log audio stats every 20 chunks (~2.5 sec)
 PORT = 6666
 HTTP_PORT = 6667
 N8N_WEBHOOK_URL = "http://localhost:5678/webhook/753a58bd-1b12-4643-858f-9249c3477da5"
+N8N_TIMEOUT_SEC = 45
+N8N_POOL_SIZE = 8  # Pooled keep-alive connections to the webhook
+N8N_KEEPALIVE_SEC = 60
+
+# Response relay - forward n8n MP3 to the device as it arrives
+RELAY_CHUNK_SIZE = 8192  # Max bytes per WebSocket frame to the ESP32
+RELAY_PREBUFFER_BYTES = 48 * 1024  # Sent unpaced so playback starts quickly (~3s @ 128kbps)
+RELAY_BITRATE_BPS = 128000  # Expected MP3 bitrate from n8n
+RELAY_PACE_FACTOR = 2.0  # After prebuffer, forward at most this much faster than real time
 
 # Audio settings
 SAMPLE_RATE = 16000
@@ -52,6 +73,8 @@ MIN_SPEECH_SEC = 0.3  # Minimum speech duration before processing
 SILENCE_TIMEOUT_SEC = 1.5  # Silence duration to end recording
 MAX_RECORDING_SEC = 15  # Maximum recording duration
 SPEECH_START_CHUNKS = 3  # Consecutive speech chunks to start recording
+PREROLL_CHUNKS = 3  # Chunks kept before speech start for a smooth transition
+WAV_HEADER_SIZE = 44
 
 # Software gain - amplify weak mic signal from ESP32
 # ESP32-LyraT mic is weak without AGC, multiply to boost signal
@@ -62,6 +85,65 @@ DEBUG_SAVE_AUDIO = True  # Set to True to save audio files
 DEBUG_AUDIO_DIR = "debug_audio"  # Directory to save audio files
 DEBUG_AUDIO_SECONDS = 10  # Save every N seconds of audio
 
+# Uplink impairment for testing the device's adaptive batching (0 = off).
+# Delaying reads pushes back through TCP, so device sends block as on a slow link.
+DEBUG_UPLINK_DELAY_MS = 0  # Added per received audio frame
+DEBUG_UPLINK_BPS = 0  # Bandwidth cap in bytes/sec
+
+# TTS settings - text is split into segments synthesized ahead of playback
+TTS_PCM_RATE = 22050  # Synthesis output rate fed to the MP3 encoder
+TTS_MIN_SEGMENT_CHARS = 20  # Shorter fragments are merged with the next one
+TTS_MAX_SEGMENT_CHARS = 120  # Longer sentences are split further at clause marks
+TTS_BACKEND = "say"  # Synthesis backend (see TTS_BACKENDS)
+TTS_MAX_CONCURRENT = 4  # Concurrent TTS requests - others queue
+TTS_MAX_SYNTH_CONCURRENT = 4  # Concurrent synthesis calls across all requests
+TTS_ENCODER_POOL_SIZE = 2  # Warm ffmpeg encoders kept per voice filter chain
+TTS_OUTPUT_FORMAT = "mp3-44100-mono-128k"  # Part of the cache key - change with encoder args
+
+# TTS audio cache - memory LRU in front of an on-disk store
+TTS_CACHE_DIR = "tts_cache"
+TTS_CACHE_MEMORY_BYTES = 16 * 1024 * 1024
+TTS_CACHE_PHRASES_FILE = "tts_phrases.txt"  # One phrase per line, synthesized at startup
+
+# Device clip cache - frequent phrases pushed to the device, played by id
+CLIP_PUSH_MIN_PLAYS = 2  # Push a phrase once it has been spoken this often
+CLIP_MAX_BYTES = 48 * 1024  # Must not exceed CLIP_MAX_BYTES in the firmware config.h
+CLIP_ID_CHARS = 16  # Prefix of the TTS cache key used as clip id
+
+# Streaming VAD settings (Silero requires exactly 512 samples at 16kHz)
+VAD_WINDOW_SIZE = 512
+VAD_CONTEXT_SIZE = 64  # Silero v5 prepends the tail of the previous window
+VAD_STATE_SHAPE = (2, 1, 128)
+VAD_RING_WINDOWS = 16  # Ring capacity in windows (~0.5s) - chunks larger than this are fed in slices
+VAD_RTF_LOG_INTERVAL = 200  # Log real-time factor every N windows
+
+# ONNX VAD inference - batched across sessions, run off the event loop
+VAD_ONNX_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "models", "silero_vad.onnx")
+VAD_ONNX_URL = "https://github.com/snakers4/silero-vad/raw/master/src/silero_vad/data/silero_vad.onnx"
+VAD_WORKERS = 2  # Inference threads
+VAD_BATCH_WINDOW_MS = 2  # Time budget to collect windows from other sessions
+VAD_BATCH_MAX = 64  # Max windows per inference call
+LATENCY_SAMPLES = 2000  # Chunk latencies kept for p50/p99
+
+# Multi-device sessions
+BROADCAST_GROUP = "all"  # Implicit group every device belongs to
+
+# Fast path - simple device commands go straight to MQTT, skipping n8n
+# Off by default: the local ASR pass runs before n8n is called, so every short
+# turn that is not a device command pays its latency (/status fast_path.added_latency)
+FASTPATH_ENABLED = False  # Needs faster-whisper and paho-mqtt, off if either is missing
+FASTPATH_ASR_MODEL = "tiny"  # faster-whisper model size
+FASTPATH_ASR_LANGUAGE = "vi"  # Pinned - detection on 1-3 s clips is unreliable and costs a pass
+FASTPATH_MAX_SEC = 3.0  # Longer utterances are never simple commands - straight to n8n
+FASTPATH_MAX_WORDS = 8
+MQTT_BROKER_HOST = "laihieu2714.ddns.net"
+MQTT_BROKER_PORT = 1883
+# One board's node topic - rename the board on its serial console
+# (node living_room_1, any time, then restart). The group topic
+# home/group/<group>/control would switch light1 on every board in the room
+MQTT_CONTROL_NODE = "living_room_1"
+MQTT_CONTROL_TOPIC = f"home/{MQTT_CONTROL_NODE}/control"
+
 # Voice Interrupt settings
 VOICE_INTERRUPT_THRESHOLD = 0.5  # Higher threshold during playback
 VOICE_INTERRUPT_CHUNKS = 3  # Consecutive voice chunks to trigger interrupt
@@ -69,27 +151,122 @@ VOICE_INTERRUPT_CHUNKS = 3  # Consecutive voice chunks to trigger interrupt
 # ============================================================================
 # Load Models
 # ============================================================================
-logger.info("Loading Silero VAD...")
+logger.info("Loading Silero VAD (ONNX)...")
 try:
-    vad_model, vad_utils = torch.hub.load(
-        repo_or_dir="snakers4/silero-vad",
-        model="silero_vad",
-        force_reload=False,
-        onnx=False,
+    if not os.path.exists(VAD_ONNX_PATH):
+        logger.info(f"⬇️ Downloading Silero VAD model to {VAD_ONNX_PATH}")
+        os.makedirs(os.path.dirname(VAD_ONNX_PATH), exist_ok=True)
+        urllib.request.urlretrieve(VAD_ONNX_URL, VAD_ONNX_PATH)
+    
+    # One thread per run - parallelism comes from the worker pool
+    sess_options = ort.SessionOptions()
+    sess_options.intra_op_num_threads = 1
+    sess_options.inter_op_num_threads = 1
+    vad_session = ort.InferenceSession(
+        VAD_ONNX_PATH, sess_options, providers=["CPUExecutionProvider"]
     )
-    get_speech_timestamps, _, _, _, _ = vad_utils
     VAD_AVAILABLE = True
     logger.info("✅ Silero VAD loaded")
 except Exception as e:
     logger.warning(f"⚠️ Silero VAD not available: {e}")
     VAD_AVAILABLE = False
 
+asr_model = None
+mqtt = None
+if FASTPATH_ENABLED:
+    logger.info(f"Loading fast-path ASR (faster-whisper {FASTPATH_ASR_MODEL})...")
+    try:
+        from faster_whisper import WhisperModel
+        import paho.mqtt.client as mqtt
+        asr_model = WhisperModel(FASTPATH_ASR_MODEL, device="cpu", compute_type="int8")
+        logger.info("✅ Fast-path ASR loaded")
+    except Exception as e:
+        logger.warning(f"⚠️ Fast path not available: {e}")
+
 # No wake word detection needed - VAD only
 
 
+# ============================================================================
+# Metrics
+# ============================================================================
+class LatencyStats:
+    """Rolling latency samples with p50/p99 for /status"""
+    
+    def __init__(self):
+        self.samples = deque(maxlen=LATENCY_SAMPLES)
+    
+    def add(self, seconds):
+        self.samples.append(seconds)
+    
+    def snapshot(self):
+        if not self.samples:
+            return {"count": 0}
+        ms = np.array(self.samples) * 1000
+        return {
+            "count": len(ms),
+            "p50_ms": round(float(np.percentile(ms, 50)), 1),
+            "p99_ms": round(float(np.percentile(ms, 99)), 1),
+        }
+
+
 # ============================================================================
 # State Management
 # ============================================================================
+def write_wav_header(buf, offset, num_samples):
+    """Write a 16-bit mono PCM WAV header into buf at offset"""
+    data_len = num_samples * 2
+    struct.pack_into(
+        "<4sI4s4sIHHIIHH4sI", buf, offset,
+        b"RIFF", 36 + data_len, b"WAVE",
+        b"fmt ", 16, 1, 1, SAMPLE_RATE, SAMPLE_RATE * 2, 2, 16,
+        b"data", data_len,
+    )
+
+
+class RecordingBuffer:
+    """Preallocated int16 recording buffer for one session
+    
+    Gained float chunks are stored as int16 so a turn can be handed to n8n
+    as an in-memory WAV with a single copy and no temp file.
+    """
+    
+    def __init__(self):
+        capacity = int((MAX_RECORDING_SEC + 1) * SAMPLE_RATE) + PREROLL_CHUNKS * SAMPLES_PER_CHUNK * 4
+        self.pcm = np.zeros(capacity, dtype=np.int16)
+        self.length = 0
+        self.chunk_sizes = deque(maxlen=PREROLL_CHUNKS)  # For keeping the preroll tail
+    
+    def __len__(self):
+        return self.length
+    
+    def append(self, chunk):
+        n = min(len(chunk), len(self.pcm) - self.length)
+        if n < len(chunk):
+            logger.warning("Recording buffer full, dropping samples")
+        out = self.pcm[self.length:self.length + n]
+        np.multiply(chunk[:n], 32767, out=out, casting="unsafe")
+        self.length += n
+        self.chunk_sizes.append(n)
+    
+    def keep_preroll(self):
+        """Keep only the last PREROLL_CHUNKS chunks"""
+        keep = sum(self.chunk_sizes)
+        if keep < self.length:
+            self.pcm[:keep] = self.pcm[self.length - keep:self.length]
+            self.length = keep
+    
+    def clear(self):
+        self.length = 0
+        self.chunk_sizes.clear()
+    
+    def to_wav(self):
+        """Copy the recording into a new in-memory WAV (header + PCM)"""
+        wav = bytearray(WAV_HEADER_SIZE + self.length * 2)
+        write_wav_header(wav, 0, self.length)
+        np.frombuffer(wav, dtype=np.int16, offset=WAV_HEADER_SIZE)[:] = self.pcm[:self.length]
+        return wav
+
+
 class ClientState:
     """State machine for each client - VAD only, no wake word"""
     
@@ -100,12 +277,13 @@ class ClientState:
     
     def __init__(self):
         self.state = self.STATE_IDLE
-        self.recording_buffer = []
+        self.recording_buffer = RecordingBuffer()
         self.recording_start = None
         self.last_speech_time = None
         self.speech_chunk_count = 0  # Consecutive speech chunks
         self.voice_interrupt_count = 0
         self.current_task = None
+        self.vad = StreamingVAD()  # Per-session VAD ring + model state
         self.debug_counter = 0  # For debug logging
         self.total_chunks = 0   # Total audio chunks received
         
@@ -114,17 +292,119 @@ class ClientState:
         self.debug_save_counter = 0
         
     def reset_recording(self):
-        self.recording_buffer = []
+        self.recording_buffer.clear()
         self.recording_start = None
         self.last_speech_time = None
         self.speech_chunk_count = 0
         self.voice_interrupt_count = 0
 
 
+class DeviceSession:
+    """One connected device - socket, identity and isolated client state"""
+    
+    def __init__(self, websocket, device_id, groups):
+        self.ws = websocket
+        self.device_id = device_id
+        self.groups = set(groups) | {BROADCAST_GROUP}
+        self.state = ClientState()
+        self.connected_at = time.time()
+        # Serializes AUDIO_START..AUDIO_END sequences to this device
+        self.play_lock = asyncio.Lock()
+        # Last uplink telemetry from the device (STATS uplink ...)
+        self.uplink = {}
+        # Device runtime tuning as last reported (TUNING k=v ...)
+        self.tuning = {}
+        # Endpoint → first audio byte for this device (reset per sweep step)
+        self.first_audio = LatencyStats()
+        # Clip ids resident in the device clip cache (reported by the device)
+        self.clips = set()
+        # How the current turn was opened (TURN wake|followup) - follow-ups
+        # continue the same n8n conversation
+        self.turn_kind = "wake"
+        self.conversation_id = uuid.uuid4().hex[:12]
+    
+    def info(self):
+        return {
+            "device_id": self.device_id,
+            "groups": sorted(self.groups),
+            "address": str(self.ws.remote_address),
+            "state": self.state.state,
+            "connected_sec": round(time.time() - self.connected_at, 1),
+            "chunks": self.state.total_chunks,
+            "vad_rtf": round(self.state.vad.rtf, 4),
+            "clips": len(self.clips),
+            "uplink": self.uplink,
+            "tuning": self.tuning,
+            "first_audio": self.first_audio.snapshot(),
+        }
+
+
+class SessionRegistry:
+    """Connected devices keyed by the device id sent at connect"""
+    
+    def __init__(self):
+        self.sessions = {}
+        self.last_connected = None
+    
+    async def register(self, session):
+        old = self.sessions.get(session.device_id)
+        self.sessions[session.device_id] = session
+        self.last_connected = session.device_id
+        
+        # Same device reconnected - drop the stale socket
+        if old is not None:
+            logger.warning(f"♻️ {session.device_id} reconnected, closing old session")
+            if old.state.current_task and not old.state.current_task.done():
+                old.state.current_task.cancel()
+            try:
+                await old.ws.close()
+            except Exception:
+                pass
+    
+    def unregister(self, session):
+        if self.sessions.get(session.device_id) is session:
+            del self.sessions[session.device_id]
+            if self.last_connected == session.device_id:
+                self.last_connected = None
+    
+    def get(self, device_id):
+        return self.sessions.get(device_id)
+    
+    def select(self, device=None, group=None):
+        """Resolve a /speak target - device id, group, or last connected"""
+        if device:
+            session = self.sessions.get(device)
+            return [session] if session else []
+        if group:
+            return [s for s in self.sessions.values() if group in s.groups]
+        if self.last_connected in self.sessions:
+            return [self.sessions[self.last_connected]]
+        return []
+
+
+registry = SessionRegistry()
+
+
+def parse_device_identity(websocket):
+    """Read device_id and groups from the connect URL query string
+    
+    ESP32 connects to ws://host:port/?device_id=<id>&group=<g1,g2>.
+    Falls back to the remote address for older firmware.
+    """
+    request = getattr(websocket, "request", None)  # websockets >= 13
+    path = request.path if request is not None else getattr(websocket, "path", "/")
+    query = urllib.parse.parse_qs(urllib.parse.urlsplit(path).query)
+    
+    host, port = websocket.remote_address[:2]
+    device_id = query.get("device_id", [f"{host}:{port}"])[0]
+    groups = [g for value in query.get("group", []) for g in value.split(",") if g]
+    return device_id, groups
+
+
 # ============================================================================
 # Debug Audio Saving
 # ============================================================================
-def save_debug_audio(client_state):
+def save_debug_audio(client_state, device_id):
     """Save debug audio buffer to WAV file for inspection"""
     import soundfile as sf
     
@@ -140,7 +420,8 @@ def save_debug_audio(client_state):
     # Generate filename with timestamp
     client_state.debug_save_counter += 1
     timestamp = datetime.now().strftime("%Y%m%d_%H%M%S")
-    filename = f"{DEBUG_AUDIO_DIR}/debug_{timestamp}_{client_state.debug_save_counter:03d}.wav"
+    safe_id = "".join(c if c.isalnum() or c in "-_" else "_" for c in device_id)
+    filename = f"{DEBUG_AUDIO_DIR}/debug_{safe_id}_{timestamp}_{client_state.debug_save_counter:03d}.wav"
     
     # Calculate stats
     duration = len(audio_data) / SAMPLE_RATE
@@ -160,83 +441,275 @@ def save_debug_audio(client_state):
 # ============================================================================
 # Audio Analysis Functions
 # ============================================================================
-# VAD buffer for accumulating samples (Silero requires exactly 512 samples at 16kHz)
-VAD_CHUNK_SIZE = 512
-vad_sample_buffer = []
+def run_vad_batch(batch):
+    """Run one batched Silero inference (worker thread)
+    
+    batch: list of (StreamingVAD, window) pairs from different sessions.
+    Updates each session's recurrent state and context in place and
+    returns the speech probabilities.
+    """
+    n = len(batch)
+    x = np.empty((n, VAD_CONTEXT_SIZE + VAD_WINDOW_SIZE), dtype=np.float32)
+    state = np.empty((2, n, VAD_STATE_SHAPE[2]), dtype=np.float32)
+    for i, (vad, window) in enumerate(batch):
+        x[i, :VAD_CONTEXT_SIZE] = vad.context
+        x[i, VAD_CONTEXT_SIZE:] = window
+        state[:, i, :] = vad.state[:, 0, :]
+    
+    t0 = time.perf_counter()
+    out, new_state = vad_session.run(None, {
+        "input": x,
+        "state": state,
+        "sr": np.array(SAMPLE_RATE, dtype=np.int64),
+    })
+    elapsed = time.perf_counter() - t0
+    
+    for i, (vad, _) in enumerate(batch):
+        vad.state[:, 0, :] = new_state[:, i, :]
+        vad.context[:] = x[i, -VAD_CONTEXT_SIZE:]
+        vad.infer_sec += elapsed / n
+    
+    vad_stats.record_batch(n, elapsed)
+    return out[:, 0].tolist()
+
 
-def get_speech_probability(audio_chunk):
-    """Get speech probability for audio chunk using VAD
+class VADStats:
+    """Server-wide VAD load metrics for /status"""
     
-    Silero VAD requires exactly 512 samples at 16kHz.
-    We accumulate samples and process when we have enough.
+    def __init__(self):
+        self.batches = 0
+        self.windows = 0
+        self.infer_sec = 0.0
+        self.chunk_latencies = deque(maxlen=LATENCY_SAMPLES)
+    
+    def record_batch(self, n, elapsed):
+        self.batches += 1
+        self.windows += n
+        self.infer_sec += elapsed
+    
+    def snapshot(self):
+        audio_sec = self.windows * VAD_WINDOW_SIZE / SAMPLE_RATE
+        lat = np.array(self.chunk_latencies) * 1000 if self.chunk_latencies else None
+        return {
+            "batches": self.batches,
+            "avg_batch": round(self.windows / self.batches, 2) if self.batches else 0,
+            "chunk_p50_ms": round(float(np.percentile(lat, 50)), 2) if lat is not None else None,
+            "chunk_p99_ms": round(float(np.percentile(lat, 99)), 2) if lat is not None else None,
+            # Streams one core can sustain at the measured inference cost
+            "streams_per_core": round(audio_sec / self.infer_sec, 1) if self.infer_sec else None,
+        }
+
+
+vad_stats = VADStats()
+
+
+class VADBatcher:
+    """Micro-batches VAD windows across all sessions
+    
+    The event loop only enqueues windows and awaits their futures. The
+    batcher waits up to VAD_BATCH_WINDOW_MS for windows from other
+    sessions, then runs the batch on the worker pool.
     """
-    global vad_sample_buffer
     
-    if not VAD_AVAILABLE:
-        return 0.5  # Assume speech if VAD not available
+    def __init__(self):
+        self.queue = None
+        self.executor = ThreadPoolExecutor(max_workers=VAD_WORKERS, thread_name_prefix="vad")
+        self.slots = None
+        self.task = None
     
-    try:
-        # Add new samples to buffer
-        vad_sample_buffer.extend(audio_chunk.tolist())
+    def start(self):
+        self.queue = asyncio.Queue()
+        self.slots = asyncio.Semaphore(VAD_WORKERS)
+        self.task = asyncio.create_task(self._run())
+    
+    async def infer(self, vad, window):
+        future = asyncio.get_running_loop().create_future()
+        self.queue.put_nowait((vad, window, future))
+        return await future
+    
+    async def _run(self):
+        loop = asyncio.get_running_loop()
+        while True:
+            batch = [await self.queue.get()]
+            
+            # Give other sessions a short window to join the batch
+            if VAD_BATCH_WINDOW_MS > 0:
+                await asyncio.sleep(VAD_BATCH_WINDOW_MS / 1000)
+            while len(batch) < VAD_BATCH_MAX and not self.queue.empty():
+                batch.append(self.queue.get_nowait())
+            
+            # Drop windows whose session went away while queued
+            batch = [item for item in batch if not item[2].done()]
+            if not batch:
+                continue
+            
+            await self.slots.acquire()
+            pairs = [(vad, window) for vad, window, _ in batch]
+            result = loop.run_in_executor(self.executor, run_vad_batch, pairs)
+            result.add_done_callback(lambda r, b=batch: self._finish(b, r))
+    
+    def _finish(self, batch, result):
+        self.slots.release()
+        error = result.exception()
+        probs = None if error else result.result()
+        for i, (_, _, future) in enumerate(batch):
+            if future.done():
+                continue
+            if error:
+                future.set_exception(error)
+            else:
+                future.set_result(probs[i])
+
+
+vad_batcher = VADBatcher()
+
+
+class StreamingVAD:
+    """Per-session streaming Silero VAD
+
+    Samples are written into a preallocated float32 ring and every full
+    512-sample window is evaluated on each chunk, so VAD keeps up with the
+    stream instead of building a backlog. The recurrent state and context
+    live here, so each session carries its own state through the shared
+    batched model.
+    """
+
+    def __init__(self):
+        self.capacity = VAD_WINDOW_SIZE * VAD_RING_WINDOWS
+        self.ring = np.zeros(self.capacity, dtype=np.float32)
+        self.read_pos = 0   # Monotonic sample counters
+        self.write_pos = 0
+        self.last_prob = 0.0
+        self.state = np.zeros(VAD_STATE_SHAPE, dtype=np.float32)
+        self.context = np.zeros(VAD_CONTEXT_SIZE, dtype=np.float32)
         
-        # Process if we have enough samples
-        if len(vad_sample_buffer) >= VAD_CHUNK_SIZE:
-            # Take exactly 512 samples
-            samples = np.array(vad_sample_buffer[:VAD_CHUNK_SIZE], dtype=np.float32)
-            # Keep remaining samples for next call
-            vad_sample_buffer = vad_sample_buffer[VAD_CHUNK_SIZE:]
+        # Real-time factor stats (inference time / audio time)
+        self.windows = 0
+        self.infer_sec = 0.0
+    
+    @property
+    def rtf(self):
+        audio_sec = self.windows * VAD_WINDOW_SIZE / SAMPLE_RATE
+        return self.infer_sec / audio_sec if audio_sec else 0.0
+    
+    def reset(self):
+        self.read_pos = 0
+        self.write_pos = 0
+        self.last_prob = 0.0
+        self.state[:] = 0
+        self.context[:] = 0
+    
+    def _write(self, samples):
+        start = self.write_pos % self.capacity
+        first = min(len(samples), self.capacity - start)
+        self.ring[start:start + first] = samples[:first]
+        if first < len(samples):
+            self.ring[:len(samples) - first] = samples[first:]
+        self.write_pos += len(samples)
+    
+    async def _run_windows(self):
+        """Evaluate every full window in the ring, return max probability"""
+        best = None
+        while self.write_pos - self.read_pos >= VAD_WINDOW_SIZE:
+            # Capacity is a multiple of the window size, so windows never wrap
+            start = self.read_pos % self.capacity
+            window = self.ring[start:start + VAD_WINDOW_SIZE]
+            self.read_pos += VAD_WINDOW_SIZE
             
-            # Debug: Check sample stats before VAD
-            sample_max = np.abs(samples).max()
-            sample_rms = np.sqrt(np.mean(samples ** 2))
+            prob = await vad_batcher.infer(self, window)
+            self.windows += 1
             
-            audio_tensor = torch.from_numpy(samples)
-            prob = vad_model(audio_tensor, SAMPLE_RATE).item()
+            if self.windows % VAD_RTF_LOG_INTERVAL == 0:
+                logger.debug(f"VAD: windows={self.windows}, rtf={self.rtf:.4f}")
             
-            # Log occasionally for debugging
-            if prob > 0.1 or sample_max > 0.01:
-                logger.debug(f"VAD: prob={prob:.3f}, sample_max={sample_max:.4f}, rms={sample_rms:.4f}")
+            self.last_prob = prob
+            best = prob if best is None else max(best, prob)
+        return best
+    
+    async def process(self, audio_chunk):
+        """Get speech probability for an audio chunk
+        
+        Returns the highest probability among the windows completed by this
+        chunk, or the previous probability if no window completed.
+        """
+        if not VAD_AVAILABLE:
+            return 0.5  # Assume speech if VAD not available
+        
+        try:
+            best = None
+            # Feed in slices so the ring never overflows on large chunks
+            step = self.capacity - VAD_WINDOW_SIZE
+            for i in range(0, len(audio_chunk), step):
+                self._write(audio_chunk[i:i + step])
+                prob = await self._run_windows()
+                if prob is not None:
+                    best = prob if best is None else max(best, prob)
             
-            return prob
-        else:
-            # Not enough samples yet, return neutral
-            return 0.3
+            return best if best is not None else self.last_prob
             
-    except Exception as e:
-        logger.error(f"VAD error: {e}")
-        vad_sample_buffer = []  # Reset on error
-        return 0.5
+        except asyncio.CancelledError:
+            raise
+        except Exception as e:
+            logger.error(f"VAD error: {e}")
+            self.reset()  # Reset on error
+            return 0.5
 
 
 # Wake word detection removed - using VAD only
 
 
-def trim_silence(audio_data, sample_rate=16000):
-    """Trim silence from audio"""
+def speech_bounds(pcm):
+    """Find first/last speech window in int16 PCM with a fresh VAD state (worker thread)"""
+    state = np.zeros(VAD_STATE_SHAPE, dtype=np.float32)
+    context = np.zeros(VAD_CONTEXT_SIZE, dtype=np.float32)
+    x = np.empty((1, VAD_CONTEXT_SIZE + VAD_WINDOW_SIZE), dtype=np.float32)
+    sr = np.array(SAMPLE_RATE, dtype=np.int64)
+    first = last = None
+    
+    for start in range(0, len(pcm) - VAD_WINDOW_SIZE + 1, VAD_WINDOW_SIZE):
+        x[0, :VAD_CONTEXT_SIZE] = context
+        np.multiply(pcm[start:start + VAD_WINDOW_SIZE], 1 / 32768, out=x[0, VAD_CONTEXT_SIZE:])
+        out, state = vad_session.run(None, {"input": x, "state": state, "sr": sr})
+        context[:] = x[0, -VAD_CONTEXT_SIZE:]
+        
+        if out[0, 0] > VAD_THRESHOLD:
+            if first is None:
+                first = start
+            last = start + VAD_WINDOW_SIZE
+    
+    return first, last
+
+
+async def trim_silence(wav):
+    """Trim silence from an in-memory WAV without copying
+    
+    The header is rewritten just before the first kept sample, so the
+    result is a memoryview into the same buffer.
+    """
+    pcm = np.frombuffer(wav, dtype=np.int16, offset=WAV_HEADER_SIZE)
     if not VAD_AVAILABLE:
-        return audio_data
+        return memoryview(wav)
     
     try:
-        audio_tensor = torch.from_numpy(audio_data).float()
-        speech_timestamps = get_speech_timestamps(
-            audio_tensor,
-            vad_model,
-            sampling_rate=sample_rate,
-            threshold=VAD_THRESHOLD,
-            min_speech_duration_ms=100,
-            min_silence_duration_ms=150,
-        )
+        loop = asyncio.get_running_loop()
+        first, last = await loop.run_in_executor(vad_batcher.executor, speech_bounds, pcm)
         
-        if not speech_timestamps:
-            return audio_data
+        if first is None:
+            return memoryview(wav)
         
-        start = max(0, speech_timestamps[0]["start"] - int(0.1 * sample_rate))
-        end = min(len(audio_data), speech_timestamps[-1]["end"] + int(0.1 * sample_rate))
+        start = max(0, first - int(0.1 * SAMPLE_RATE))
+        end = min(len(pcm), last + int(0.1 * SAMPLE_RATE))
         
-        return audio_data[start:end]
+        # Need room for the header in the trimmed-away lead-in
+        if start * 2 < WAV_HEADER_SIZE:
+            start = 0
+        offset = start * 2  # Header now ends exactly at sample `start`
+        write_wav_header(wav, offset, end - start)
+        return memoryview(wav)[offset:WAV_HEADER_SIZE + end * 2]
     except Exception as e:
         logger.error(f"Trim error: {e}")
-        return audio_data
+        write_wav_header(wav, 0, len(pcm))
+        return memoryview(wav)
 
 
 # ============================================================================
@@ -247,98 +720,851 @@ def is_vietnamese(text):
     return any(c in vn_chars for c in text.lower())
 
 
-async def tts_stream(text):
-    """Convert text to MP3 speech"""
-    if not text or not text.strip():
-        return
+SENTENCE_RE = re.compile(r"(?<=[.!?…。\n])\s+")
+CLAUSE_RE = re.compile(r"(?<=[,;:])\s+")
+
+
+def split_segments(text):
+    """Split text into sentences, and long sentences into clauses
     
-    voice = "Linh" if is_vietnamese(text) else "Samantha"
-    logger.info(f"🗣️ TTS ({voice}): '{text[:40]}...'")
+    Very short fragments are merged forward so each segment is worth
+    a synthesis call.
+    """
+    pieces = []
+    for sentence in SENTENCE_RE.split(text.strip()):
+        if len(sentence) > TTS_MAX_SEGMENT_CHARS:
+            pieces.extend(CLAUSE_RE.split(sentence))
+        elif sentence:
+            pieces.append(sentence)
     
-    temp_file = None
-    try:
-        with tempfile.NamedTemporaryFile(suffix=".aiff", delete=False) as f:
-            temp_file = f.name
-        
+    segments = []
+    pending = ""
+    for piece in pieces:
+        pending = f"{pending} {piece}".strip()
+        if len(pending) >= TTS_MIN_SEGMENT_CHARS:
+            segments.append(pending)
+            pending = ""
+    if pending:
+        if segments:
+            segments[-1] = f"{segments[-1]} {pending}"
+        else:
+            segments.append(pending)
+    return segments
+
+
+class SayBackend:
+    """macOS `say` synthesis → raw PCM (s16le mono @ TTS_PCM_RATE)"""
+    
+    version = "1"  # Part of the cache key - bump when the output changes
+    
+    async def synthesize(self, text, voice):
+        temp_file = None
+        proc = None
+        try:
+            with tempfile.NamedTemporaryFile(suffix=".wav", delete=False) as f:
+                temp_file = f.name
+            
+            proc = await asyncio.create_subprocess_exec(
+                "say", "-v", voice, "-o", temp_file,
+                f"--data-format=LEI16@{TTS_PCM_RATE}", text,
+                stdout=asyncio.subprocess.DEVNULL,
+                stderr=asyncio.subprocess.DEVNULL,
+            )
+            await proc.wait()
+            
+            with wave.open(temp_file, "rb") as w:
+                return w.readframes(w.getnframes())
+        except asyncio.CancelledError:
+            # Stop `say` before the temp file is removed under it
+            if proc and proc.returncode is None:
+                proc.kill()
+                await proc.wait()
+            raise
+        finally:
+            if temp_file and os.path.exists(temp_file):
+                try:
+                    os.remove(temp_file)
+                except:
+                    pass
+
+
+class EspeakBackend:
+    """espeak-ng synthesis over pipes → raw PCM, no temp file
+    
+    Text goes in on stdin and a WAV comes back on stdout at espeak-ng's
+    native 22050 Hz. The WAV size fields aren't filled in on a pipe, so
+    the samples are taken from after the "data" chunk header.
+    """
+    
+    version = "1"  # Part of the cache key - bump when the output changes
+    voices = {"Linh": "vi", "Samantha": "en-us"}
+    
+    async def synthesize(self, text, voice):
         proc = await asyncio.create_subprocess_exec(
-            "say", "-v", voice, "-o", temp_file, text,
-            stdout=asyncio.subprocess.DEVNULL,
+            "espeak-ng", "--stdout", "--stdin", "-v", self.voices.get(voice, voice),
+            stdin=asyncio.subprocess.PIPE,
+            stdout=asyncio.subprocess.PIPE,
             stderr=asyncio.subprocess.DEVNULL,
         )
-        await proc.wait()
-        
-        filters = ["apad=pad_dur=0.3"]
-        if voice == "Linh":
-            filters.insert(0, "atempo=1.25")
+        try:
+            wav, _ = await proc.communicate(text.encode("utf-8"))
+        except asyncio.CancelledError:
+            if proc.returncode is None:
+                proc.kill()
+                await proc.wait()
+            raise
         
-        ffmpeg = await asyncio.create_subprocess_exec(
-            "ffmpeg", "-i", temp_file,
+        data = wav.find(b"data", 12)
+        if proc.returncode != 0 or wav[:4] != b"RIFF" or data < 0:
+            raise RuntimeError(f"espeak-ng failed (exit {proc.returncode}, {len(wav)} bytes)")
+        rate = struct.unpack_from("<I", wav, 24)[0]
+        if rate != TTS_PCM_RATE:
+            raise RuntimeError(f"espeak-ng output is {rate} Hz, TTS_PCM_RATE is {TTS_PCM_RATE}")
+        return wav[data + 8:]
+
+
+# Pluggable synthesis backends: async synthesize(text, voice) -> PCM bytes,
+# plus a `version` string that goes into the cache key
+TTS_BACKENDS = {
+    "say": SayBackend,
+    "espeak": EspeakBackend,
+}
+tts_backend = TTS_BACKENDS[TTS_BACKEND]()
+
+
+def voice_filters(voice):
+    filters = ["apad=pad_dur=0.3"]
+    if voice == "Linh":
+        filters.insert(0, "atempo=1.25")
+    return ",".join(filters)
+
+
+class EncoderPool:
+    """Warm ffmpeg MP3 encoders, spawned ahead of time
+    
+    Each encoder is already running and blocked on its stdin pipe, so a
+    request only writes PCM and reads MP3. Process startup happens in the
+    background when the pool is refilled, not on the request path.
+    Encoders are single-use because ffmpeg only flushes an utterance's last
+    frames at EOF.
+    """
+    
+    def __init__(self):
+        self.idle = {}      # filters -> [process]
+        self.spawning = {}  # filters -> count
+        self.warm_hits = 0
+        self.cold_spawns = 0
+    
+    async def _spawn(self, filters):
+        return await asyncio.create_subprocess_exec(
+            # No input analysis: raw PCM needs none, and ffmpeg would otherwise
+            # read up to 5 s of it before encoding anything
+            "ffmpeg", "-analyzeduration", "0", "-probesize", "32",
+            "-f", "s16le", "-ar", str(TTS_PCM_RATE), "-ac", "1", "-i", "pipe:0",
             "-f", "mp3", "-ac", "1", "-ar", "44100", "-b:a", "128k",
-            "-filter:a", ",".join(filters),
+            "-filter:a", filters,
             "pipe:1",
+            stdin=asyncio.subprocess.PIPE,
             stdout=asyncio.subprocess.PIPE,
             stderr=asyncio.subprocess.DEVNULL,
         )
-        
-        while True:
-            chunk = await ffmpeg.stdout.read(8192)
-            if not chunk:
+    
+    async def _add(self, filters):
+        try:
+            proc = await self._spawn(filters)
+            self.idle.setdefault(filters, []).append(proc)
+        except Exception as e:
+            logger.error(f"Encoder spawn error: {e}")
+        finally:
+            self.spawning[filters] -= 1
+    
+    def refill(self, filters):
+        idle = self.idle.setdefault(filters, [])
+        self.spawning.setdefault(filters, 0)
+        for _ in range(TTS_ENCODER_POOL_SIZE - len(idle) - self.spawning[filters]):
+            self.spawning[filters] += 1
+            asyncio.create_task(self._add(filters))
+    
+    async def acquire(self, filters):
+        idle = self.idle.setdefault(filters, [])
+        proc = None
+        while idle:
+            candidate = idle.pop()
+            if candidate.returncode is None:
+                proc = candidate
+                self.warm_hits += 1
                 break
-            yield chunk
+        if proc is None:
+            proc = await self._spawn(filters)
+            self.cold_spawns += 1
+        self.refill(filters)
+        return proc
+    
+    def close(self):
+        for procs in self.idle.values():
+            for proc in procs:
+                if proc.returncode is None:
+                    proc.kill()
+        self.idle.clear()
+
+
+encoder_pool = EncoderPool()
+
+
+class TTSStats:
+    """TTS queueing, synthesis and throughput metrics for /status"""
+    
+    def __init__(self):
+        self.started = time.time()
+        self.phrases = 0
+        self.queue_wait = LatencyStats()
+        self.synth = LatencyStats()  # Per segment
+        self.first_audio = LatencyStats()
+        self.total = LatencyStats()
+    
+    def snapshot(self):
+        uptime = time.time() - self.started
+        return {
+            "backend": TTS_BACKEND,
+            "phrases": self.phrases,
+            "phrases_per_sec": round(self.phrases / uptime, 3) if uptime else 0,
+            "queue_wait": self.queue_wait.snapshot(),
+            "synth": self.synth.snapshot(),
+            "first_audio": self.first_audio.snapshot(),
+            "total": self.total.snapshot(),
+            "encoder_warm_hits": encoder_pool.warm_hits,
+            "encoder_cold_spawns": encoder_pool.cold_spawns,
+        }
+
+
+tts_stats = TTSStats()
+tts_slots = None  # Semaphores created in main (need a running loop)
+synth_slots = None
+
+
+async def synthesize_timed(text, voice):
+    async with synth_slots:
+        t0 = time.perf_counter()
+        pcm = await tts_backend.synthesize(text, voice)
+        tts_stats.synth.add(time.perf_counter() - t0)
+        return pcm
+
+
+def tts_voice(text):
+    return "Linh" if is_vietnamese(text) else "Samantha"
+
+
+async def tts_stream(text, result=None):
+    """Convert text to MP3 speech, pipelined by sentence
+    
+    Segment N+1 is synthesized while segment N is being encoded and
+    streamed. All segments go through one warm encoder as a continuous PCM
+    stream, so there are no MP3 gaps at the joins.
+    
+    result: optional dict, set to {"ok": True, ...} only if the whole
+    utterance was synthesized and encoded without errors.
+    """
+    if not text or not text.strip():
+        return
+    
+    voice = tts_voice(text)
+    failed = False
+    segments = split_segments(text)
+    logger.info(f"🗣️ TTS ({voice}, {len(segments)} segments): '{text[:40]}...'")
+    
+    queued = time.perf_counter()
+    async with tts_slots:
+        start = time.perf_counter()
+        tts_stats.queue_wait.add(start - queued)
         
-        await ffmpeg.wait()
+        ffmpeg = None
+        feeder = None
+        try:
+            ffmpeg = await encoder_pool.acquire(voice_filters(voice))
+            
+            async def feed():
+                nonlocal failed
+                pending = None
+                try:
+                    pending = asyncio.create_task(synthesize_timed(segments[0], voice))
+                    for i in range(len(segments)):
+                        pcm = await pending
+                        # Start the next segment before encoding this one
+                        if i + 1 < len(segments):
+                            pending = asyncio.create_task(synthesize_timed(segments[i + 1], voice))
+                        ffmpeg.stdin.write(pcm)
+                        await ffmpeg.stdin.drain()
+                except Exception as e:
+                    failed = True
+                    logger.error(f"TTS synthesis error: {e}")
+                finally:
+                    # Cancelled mid-drain: the next segment is still synthesizing
+                    if pending and not pending.done():
+                        pending.cancel()
+                    ffmpeg.stdin.close()
+            
+            feeder = asyncio.create_task(feed())
+            
+            first_audio = None
+            while True:
+                chunk = await ffmpeg.stdout.read(8192)
+                if not chunk:
+                    break
+                if first_audio is None:
+                    first_audio = time.perf_counter() - start
+                    tts_stats.first_audio.add(first_audio)
+                yield chunk
+            
+            await ffmpeg.wait()
+            tts_stats.total.add(time.perf_counter() - start)
+            tts_stats.phrases += 1
+            
+            if result is not None and not failed and ffmpeg.returncode == 0 and first_audio is not None:
+                result.update(ok=True, first_audio_sec=first_audio)
+            
+        except asyncio.CancelledError:
+            raise
+        except Exception as e:
+            logger.error(f"TTS error: {e}")
+        finally:
+            if feeder and not feeder.done():
+                feeder.cancel()
+            if ffmpeg and ffmpeg.returncode is None:
+                ffmpeg.kill()
+
+
+# ============================================================================
+# TTS Cache - content-addressed, memory LRU + disk
+# ============================================================================
+def tts_cache_key(text, voice):
+    """Hash of everything that changes the encoded audio"""
+    material = "\x00".join([
+        text.strip(), voice, voice_filters(voice), TTS_OUTPUT_FORMAT,
+        TTS_BACKEND, getattr(tts_backend, "version", ""),
+    ])
+    return hashlib.sha256(material.encode("utf-8")).hexdigest()
+
+
+class TTSCache:
+    """Two-tier cache of encoded TTS audio
+    
+    Entries are keyed by tts_cache_key(). Each disk entry is <key>.mp3 with
+    a <key>.json sidecar that records the text and its original
+    synthesis latency, which is used for the latency-saved counter.
+    """
+    
+    def __init__(self):
+        self.memory = OrderedDict()  # key -> (mp3 bytes, first_audio_sec)
+        self.memory_bytes = 0
+        self.hits_memory = 0
+        self.hits_disk = 0
+        self.misses = 0
+        self.bytes_served = 0
+        self.latency_saved_sec = 0.0
+    
+    def _path(self, key, ext):
+        return os.path.join(TTS_CACHE_DIR, f"{key}.{ext}")
+    
+    def _remember(self, key, entry):
+        if key in self.memory:
+            self.memory_bytes -= len(self.memory.pop(key)[0])
+        self.memory[key] = entry
+        self.memory_bytes += len(entry[0])
+        while self.memory_bytes > TTS_CACHE_MEMORY_BYTES and len(self.memory) > 1:
+            _, (old, _) = self.memory.popitem(last=False)
+            self.memory_bytes -= len(old)
+    
+    def _read_disk(self, key):
+        try:
+            with open(self._path(key, "mp3"), "rb") as f:
+                data = f.read()
+        except FileNotFoundError:
+            return None
+        try:
+            with open(self._path(key, "json")) as f:
+                first_audio = json.load(f).get("first_audio_sec", 0.0)
+        except (OSError, ValueError):
+            first_audio = 0.0
+        return data, first_audio
+    
+    def _write_disk(self, key, text, data, first_audio):
+        os.makedirs(TTS_CACHE_DIR, exist_ok=True)
+        for ext, payload, mode in (
+            ("mp3", data, "wb"),
+            ("json", json.dumps({"text": text, "first_audio_sec": first_audio}, ensure_ascii=False), "w"),
+        ):
+            tmp = self._path(key, ext) + ".tmp"
+            with open(tmp, mode) as f:
+                f.write(payload)
+            os.replace(tmp, self._path(key, ext))
+    
+    async def get(self, key, count=True):
+        """Cached MP3 for key, or None - count=False skips the hit/miss counters"""
+        entry = self.memory.get(key)
+        if entry is not None:
+            self.memory.move_to_end(key)
+            self.hits_memory += count
+        else:
+            entry = await asyncio.to_thread(self._read_disk, key)
+            if entry is None:
+                self.misses += count
+                return None
+            self._remember(key, entry)
+            self.hits_disk += count
         
-    except asyncio.CancelledError:
-        raise
-    except Exception as e:
-        logger.error(f"TTS error: {e}")
-    finally:
-        if temp_file and os.path.exists(temp_file):
-            try:
-                os.remove(temp_file)
-            except:
+        if count:
+            self.bytes_served += len(entry[0])
+            self.latency_saved_sec += entry[1]
+        return entry[0]
+    
+    async def put(self, key, text, data, first_audio):
+        self._remember(key, (data, first_audio))
+        try:
+            await asyncio.to_thread(self._write_disk, key, text, data, first_audio)
+        except Exception as e:
+            logger.error(f"TTS cache write error: {e}")
+    
+    def snapshot(self):
+        hits = self.hits_memory + self.hits_disk
+        lookups = hits + self.misses
+        return {
+            "hits_memory": self.hits_memory,
+            "hits_disk": self.hits_disk,
+            "misses": self.misses,
+            "hit_rate": round(hits / lookups, 3) if lookups else None,
+            "memory_entries": len(self.memory),
+            "memory_bytes": self.memory_bytes,
+            "bytes_served": self.bytes_served,
+            "latency_saved_ms": round(self.latency_saved_sec * 1000, 1),
+        }
+
+
+tts_cache = TTSCache()
+
+
+async def cached_tts_stream(text):
+    """tts_stream() behind the TTS cache - hits stream immediately"""
+    if not text or not text.strip():
+        return
+    
+    key = tts_cache_key(text, tts_voice(text))
+    data = await tts_cache.get(key)
+    if data is not None:
+        logger.info(f"⚡ TTS cache hit: '{text[:40]}'")
+        for i in range(0, len(data), 8192):
+            yield data[i:i + 8192]
+        return
+    
+    # Miss - stream while collecting, store only complete utterances
+    result = {}
+    parts = []
+    async for chunk in tts_stream(text, result):
+        parts.append(chunk)
+        yield chunk
+    
+    if result.get("ok"):
+        await tts_cache.put(key, text, b"".join(parts), result["first_audio_sec"])
+
+
+async def prewarm_tts_cache(extra=()):
+    """Synthesize every phrase in TTS_CACHE_PHRASES_FILE (plus extra) that isn't cached yet"""
+    phrases = list(extra)
+    try:
+        with open(TTS_CACHE_PHRASES_FILE, encoding="utf-8") as f:
+            phrases += [line.strip() for line in f if line.strip() and not line.startswith("#")]
+    except FileNotFoundError:
+        pass
+    if not phrases:
+        return
+    
+    logger.info(f"🔥 Pre-warming TTS cache ({len(phrases)} phrases)")
+    for phrase in phrases:
+        try:
+            async for _ in cached_tts_stream(phrase):
                 pass
+        except Exception as e:
+            logger.error(f"TTS prewarm error for '{phrase[:40]}': {e}")
+    logger.info("🔥 TTS cache ready")
+
+
+# ============================================================================
+# Device Clip Cache - server-controlled residency, LRU eviction on device
+#
+# Server → device: CLIP_STORE <id> <size> + binary frames, CLIP_PLAY <id>,
+#                  CLIP_DROP <id>
+# Device → server: CLIP_HAVE <id>... (on connect), CLIP_STORED <id>,
+#                  CLIP_EVICTED <id>, CLIP_REJECTED <id>, CLIP_MISS <id>
+# ============================================================================
+class ClipStats:
+    """Pushes, device-side misses and time-to-audio, cached vs streamed"""
+    
+    def __init__(self):
+        self.pushes = 0
+        self.bytes_pushed = 0
+        self.rejected = 0
+        self.evictions = 0
+        self.plays = 0
+        self.misses = 0
+        # /speak request → CLIP_PLAY sent / first streamed MP3 chunk sent
+        self.time_to_audio = {"clip": LatencyStats(), "stream": LatencyStats()}
+    
+    def snapshot(self):
+        return {
+            "pushes": self.pushes,
+            "bytes_pushed": self.bytes_pushed,
+            "rejected": self.rejected,
+            "evictions": self.evictions,
+            "plays": self.plays,
+            "misses": self.misses,
+            "time_to_audio": {k: v.snapshot() for k, v in self.time_to_audio.items()},
+        }
+
+
+clip_stats = ClipStats()
+clip_library = {}  # clip id -> TTS cache key
+clip_plays = Counter()  # clip id -> times spoken
+
+
+def register_clip(text):
+    """Clip id for a phrase - the TTS cache key prefix"""
+    key = tts_cache_key(text, tts_voice(text))
+    cid = key[:CLIP_ID_CHARS]
+    clip_library[cid] = key
+    return cid
+
+
+async def push_clip(session, cid):
+    """Upload a cached phrase into the device clip cache
+    
+    Residency is only recorded once the device answers CLIP_STORED.
+    """
+    data = await tts_cache.get(clip_library.get(cid, ""), count=False)
+    if data is None or len(data) > CLIP_MAX_BYTES or cid in session.clips:
+        return False
+    
+    async with session.play_lock:
+        await session.ws.send(f"CLIP_STORE {cid} {len(data)}")
+        for i in range(0, len(data), RELAY_CHUNK_SIZE):
+            await session.ws.send(data[i:i + RELAY_CHUNK_SIZE])
+    
+    clip_stats.pushes += 1
+    clip_stats.bytes_pushed += len(data)
+    logger.info(f"📼 [{session.device_id}] Pushed clip {cid} ({len(data)} bytes)")
+    return True
+
+
+async def play_clip(session, cid, request_start):
+    """Play a resident clip - one text frame instead of an MP3 stream"""
+    async with session.play_lock:
+        await session.ws.send(f"CLIP_PLAY {cid}")
+    clip_stats.plays += 1
+    clip_stats.time_to_audio["clip"].add(time.perf_counter() - request_start)
+
+
+async def stream_clip(session, cid):
+    """Fallback after CLIP_MISS - stream the clip like any other response"""
+    data = await tts_cache.get(clip_library.get(cid, ""), count=False)
+    if data is None:
+        return
+    async with session.play_lock:
+        await session.ws.send("AUDIO_START")
+        for i in range(0, len(data), RELAY_CHUNK_SIZE):
+            await session.ws.send(data[i:i + RELAY_CHUNK_SIZE])
+        await asyncio.sleep(0.3)
+        await session.ws.send("AUDIO_END")
+
+
+def handle_clip_message(session, command):
+    """Track device clip residency from CLIP_* text frames"""
+    kind, *ids = command.split()
+    if kind == "CLIP_HAVE":
+        session.clips = set(ids)
+        logger.info(f"📼 [{session.device_id}] {len(ids)} clips resident")
+    elif kind == "CLIP_STORED":
+        session.clips.update(ids)
+    elif kind == "CLIP_EVICTED":
+        session.clips.difference_update(ids)
+        clip_stats.evictions += len(ids)
+    elif kind == "CLIP_REJECTED":
+        clip_stats.rejected += len(ids)
+    elif kind == "CLIP_MISS":
+        session.clips.difference_update(ids)
+        clip_stats.misses += len(ids)
+        for cid in ids:
+            logger.warning(f"📼 [{session.device_id}] Clip miss {cid}, streaming instead")
+            asyncio.create_task(stream_clip(session, cid))
 
 
 # ============================================================================
 # n8n Integration
 # ============================================================================
-async def call_n8n(audio_path):
-    """Call n8n with audio - returns MP3 bytes"""
-    async with aiohttp.ClientSession() as session:
-        try:
-            logger.info(f"📤 Sending to n8n: {audio_path}")
+http_session = None  # Long-lived pooled session to n8n (created in main)
+
+
+class UploadStats:
+    """Endpoint → request on the wire, and connection reuse"""
+    
+    def __init__(self):
+        self.overhead = LatencyStats()
+        self.new_connections = 0
+        self.reused_connections = 0
+    
+    def snapshot(self):
+        return {
+            **self.overhead.snapshot(),
+            "new_connections": self.new_connections,
+            "reused_connections": self.reused_connections,
+        }
+
+
+upload_stats = UploadStats()
+
+
+async def on_request_headers_sent(session, ctx, params):
+    turn_start = getattr(ctx.trace_request_ctx, "turn_start", None)
+    if turn_start is not None:
+        upload_stats.overhead.add(time.perf_counter() - turn_start)
+
+
+async def on_connection_create_end(session, ctx, params):
+    upload_stats.new_connections += 1
+
+
+async def on_connection_reuseconn(session, ctx, params):
+    upload_stats.reused_connections += 1
+
+
+def create_http_session():
+    trace = aiohttp.TraceConfig()
+    trace.on_request_headers_sent.append(on_request_headers_sent)
+    trace.on_connection_create_end.append(on_connection_create_end)
+    trace.on_connection_reuseconn.append(on_connection_reuseconn)
+    connector = aiohttp.TCPConnector(limit=N8N_POOL_SIZE, keepalive_timeout=N8N_KEEPALIVE_SEC)
+    return aiohttp.ClientSession(connector=connector, trace_configs=[trace])
+
+
+async def call_n8n(wav, turn_start, session):
+    """Call n8n with an in-memory WAV - yields MP3 chunks as they arrive
+    
+    device_id / conversation_id / followup let the workflow keep memory
+    across follow-up turns.
+    """
+    try:
+        logger.info(f"📤 Sending to n8n: {len(wav)} bytes")
+        
+        data = aiohttp.FormData()
+        data.add_field("file", wav, filename="audio.wav", content_type="audio/wav")
+        data.add_field("device_id", session.device_id)
+        data.add_field("conversation_id", session.conversation_id)
+        data.add_field("followup", "1" if session.turn_kind == "followup" else "0")
+        
+        timeout = aiohttp.ClientTimeout(total=N8N_TIMEOUT_SEC)
+        async with http_session.post(
+            N8N_WEBHOOK_URL, data=data, timeout=timeout,
+            trace_request_ctx=SimpleNamespace(turn_start=turn_start),
+        ) as resp:
+            if resp.status != 200:
+                logger.error(f"n8n error: {resp.status}")
+                return
             
-            with open(audio_path, "rb") as f:
-                data = aiohttp.FormData()
-                data.add_field("file", f, filename="audio.wav", content_type="audio/wav")
-                
-                async with session.post(N8N_WEBHOOK_URL, data=data, timeout=45) as resp:
-                    if resp.status == 200:
-                        audio_data = await resp.read()
-                        logger.info(f"🎵 Received {len(audio_data)} bytes from n8n")
-                        return audio_data
-                    else:
-                        logger.error(f"n8n error: {resp.status}")
-                        return None
-                        
-        except Exception as e:
-            logger.error(f"n8n error: {e}")
-            return None
+            received = 0
+            async for chunk in resp.content.iter_chunked(RELAY_CHUNK_SIZE):
+                received += len(chunk)
+                yield chunk
+            logger.info(f"🎵 Received {received} bytes from n8n")
+                    
+    except Exception as e:
+        logger.error(f"n8n error: {e}")
+
+
+class RelayPacer:
+    """Paces relayed MP3 to the device
+    
+    The first RELAY_PREBUFFER_BYTES go out as soon as they arrive so
+    playback starts right away. After that, forwarding is capped at
+    RELAY_PACE_FACTOR x real time so the device ring buffer is not flooded.
+    """
+    
+    def __init__(self):
+        self.start = None
+        self.sent = 0
+    
+    async def wait(self, size):
+        loop = asyncio.get_running_loop()
+        now = loop.time()
+        if self.start is None:
+            self.start = now
+        
+        ahead = self.sent - RELAY_PREBUFFER_BYTES
+        if ahead > 0:
+            due = self.start + ahead / (RELAY_BITRATE_BPS / 8 * RELAY_PACE_FACTOR)
+            if due > now:
+                await asyncio.sleep(due - now)
+        self.sent += size
+
+
+# Endpoint → first response byte sent to the device
+first_audio_stats = LatencyStats()
+# Same, split by wake-initiated vs follow-up turns
+turn_first_audio_stats = {"wake": LatencyStats(), "followup": LatencyStats()}
+
+
+# ============================================================================
+# Fast Path - local ASR + command table → MQTT, everything else → n8n
+# ============================================================================
+def _device_commands():
+    """(pattern, device, value, reply) for every mqtt_device actuator"""
+    on = r"(bật|mở|turn on|switch on)"
+    off = r"(tắt|turn off|switch off)"
+    numbers = {1: r"(1|một|mot|one)", 2: r"(2|hai|two)", 3: r"(3|ba|three)"}
+    commands = []
+    for n in (1, 2, 3):
+        commands.append((rf"{on} (đèn|den|light) {numbers[n]}", f"light{n}", 1, f"Đã bật đèn {n}"))
+        commands.append((rf"{off} (đèn|den|light) {numbers[n]}", f"light{n}", 0, f"Đã tắt đèn {n}"))
+    for n in (1, 2):
+        commands.append((rf"{on} (quạt|quat|fan) {numbers[n]}", f"fan{n}", 1, f"Đã bật quạt {n}"))
+        commands.append((rf"{off} (quạt|quat|fan) {numbers[n]}", f"fan{n}", 0, f"Đã tắt quạt {n}"))
+    commands.append((r"(mở|open( the)?) (cửa|door)", "servo", 180, "Đã mở cửa"))
+    commands.append((r"(đóng|close( the)?) (cửa|door)", "servo", 120, "Đã đóng cửa"))
+    return [(re.compile(rf"\b{pattern}\b"), device, value, reply) for pattern, device, value, reply in commands]
+
+
+FASTPATH_COMMANDS = _device_commands()
+INTENT_STRIP_RE = re.compile(r"[^\w\s]")
+
+
+class FastPathStats:
+    """Turns answered locally vs forwarded, ASR cost and voice-to-actuation"""
+    
+    def __init__(self):
+        self.hits = Counter()  # By device
+        self.no_match = 0
+        self.too_long = 0
+        self.mqtt_errors = 0
+        self.asr = LatencyStats()
+        self.added_latency = LatencyStats()  # ASR time on turns that still went to n8n
+        self.voice_to_actuation = LatencyStats()  # Endpoint → MQTT publish
+    
+    def snapshot(self):
+        return {
+            "available": fast_path_ready(),
+            "mqtt_connected": bool(mqtt_client and mqtt_client.is_connected()),
+            "hits": dict(self.hits),
+            "no_match": self.no_match,
+            "too_long": self.too_long,
+            "mqtt_errors": self.mqtt_errors,
+            "asr": self.asr.snapshot(),
+            "added_latency": self.added_latency.snapshot(),
+            "voice_to_actuation": self.voice_to_actuation.snapshot(),
+        }
+
+
+fast_path_stats = FastPathStats()
+mqtt_client = None
+
+
+def start_mqtt():
+    """Background MQTT client - paho runs its own network thread"""
+    global mqtt_client
+    if mqtt is None:
+        return
+    try:
+        client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+    except AttributeError:
+        client = mqtt.Client()  # paho-mqtt < 2.0
+    client.connect_async(MQTT_BROKER_HOST, MQTT_BROKER_PORT, keepalive=30)
+    client.loop_start()
+    mqtt_client = client
+    logger.info(f"📡 MQTT → {MQTT_BROKER_HOST}:{MQTT_BROKER_PORT}")
+
+
+def fast_path_ready():
+    return asr_model is not None and mqtt_client is not None
+
+
+def fast_path_replies():
+    """Confirmation phrases - pre-warmed into the TTS cache at startup"""
+    return sorted({reply for _, _, _, reply in FASTPATH_COMMANDS})
+
+
+def transcribe(pcm):
+    """Greedy, timestamp-free decode - commands are a few words"""
+    segments, _ = asr_model.transcribe(pcm, language=FASTPATH_ASR_LANGUAGE, beam_size=1,
+                                       without_timestamps=True, condition_on_previous_text=False)
+    return " ".join(segment.text for segment in segments)
+
+
+def match_intent(text):
+    """Command table lookup - only short utterances that are just a command"""
+    normalized = " ".join(INTENT_STRIP_RE.sub(" ", text.lower()).split())
+    if not normalized or len(normalized.split()) > FASTPATH_MAX_WORDS:
+        return None
+    for pattern, device, value, reply in FASTPATH_COMMANDS:
+        if pattern.search(normalized):
+            return device, value, reply
+    return None
+
+
+async def try_fast_path(wav, session, turn_start):
+    """Handle a simple device command without n8n
+    
+    Returns True if the turn was answered here, False to forward to n8n.
+    """
+    pcm = np.frombuffer(wav, dtype=np.int16, offset=WAV_HEADER_SIZE)
+    if len(pcm) > FASTPATH_MAX_SEC * SAMPLE_RATE:
+        fast_path_stats.too_long += 1
+        return False
+    
+    t0 = time.perf_counter()
+    text = await asyncio.to_thread(transcribe, pcm.astype(np.float32) / 32768.0)
+    asr_time = time.perf_counter() - t0
+    fast_path_stats.asr.add(asr_time)
+    
+    intent = match_intent(text)
+    if intent is None:
+        fast_path_stats.no_match += 1
+        fast_path_stats.added_latency.add(asr_time)
+        logger.info(f"➡️ [{session.device_id}] '{text.strip()}' → n8n (+{asr_time * 1000:.0f}ms ASR)")
+        return False
+    
+    device, value, reply = intent
+    if not mqtt_client.is_connected():
+        fast_path_stats.mqtt_errors += 1
+        fast_path_stats.added_latency.add(asr_time)
+        logger.warning("MQTT not connected, forwarding command to n8n")
+        return False
+    
+    payload = json.dumps({"device": device, "value": value})
+    info = mqtt_client.publish(MQTT_CONTROL_TOPIC, payload, qos=0)
+    if info.rc != mqtt.MQTT_ERR_SUCCESS:
+        fast_path_stats.mqtt_errors += 1
+        fast_path_stats.added_latency.add(asr_time)
+        return False
+    
+    actuation = time.perf_counter() - turn_start
+    fast_path_stats.voice_to_actuation.add(actuation)
+    fast_path_stats.hits[device] += 1
+    logger.info(f"⚡ [{session.device_id}] '{text.strip()}' → {payload} in {actuation * 1000:.0f}ms")
+    
+    await speak_phrase(session, reply, turn_start)
+    return True
 
 
 # ============================================================================
 # Process Pipeline
 # ============================================================================
-async def process_audio(audio_buffer, websocket, client_state):
-    """Process recorded audio: trim → n8n → stream response"""
-    import soundfile as sf
+async def process_audio(wav, session, turn_start):
+    """Process recorded audio: trim → n8n → stream response
     
+    wav: in-memory WAV from the session's RecordingBuffer
+    turn_start: perf_counter() at the endpoint
+    """
+    websocket = session.ws
+    client_state = session.state
     try:
         client_state.state = ClientState.STATE_PROCESSING
         
-        audio_data = np.concatenate(audio_buffer)
-        duration = len(audio_data) / SAMPLE_RATE
+        duration = (len(wav) - WAV_HEADER_SIZE) / 2 / SAMPLE_RATE
         logger.info(f"Processing {duration:.2f}s audio")
         
         if duration < MIN_SPEECH_SEC:
@@ -346,44 +1572,46 @@ async def process_audio(audio_buffer, websocket, client_state):
             client_state.state = ClientState.STATE_IDLE
             return
         
-        # Trim silence
-        trimmed = trim_silence(audio_data)
-        
-        # Save temp file
-        with tempfile.NamedTemporaryFile(suffix=".wav", delete=False) as f:
-            temp_path = f.name
-            sf.write(temp_path, trimmed, SAMPLE_RATE)
+        # Trim silence (in place, no copy)
+        trimmed = await trim_silence(wav)
         
-        # Signal start
-        await websocket.send("AUDIO_START")
-        client_state.state = ClientState.STATE_PLAYING
-        
-        # Get response from n8n
-        audio_bytes = await call_n8n(temp_path)
-        os.remove(temp_path)
+        if fast_path_ready() and await try_fast_path(trimmed, session, turn_start):
+            return
         
-        # Stream response
-        if audio_bytes:
-            logger.info(f"🔊 Streaming {len(audio_bytes)} bytes")
+        async with session.play_lock:
+            # Signal start
+            await websocket.send("AUDIO_START")
+            client_state.state = ClientState.STATE_PLAYING
             
-            chunk_size = 8192
-            for i in range(0, len(audio_bytes), chunk_size):
-                # Check for voice interrupt
-                if client_state.state != ClientState.STATE_PLAYING:
-                    logger.warning("⏹️ Playback interrupted!")
-                    break
+            # Relay the n8n response chunk by chunk as it arrives
+            pacer = RelayPacer()
+            sent = 0
+            async with aclosing(call_n8n(trimmed, turn_start, session)) as response:
+                async for chunk in response:
+                    # Check for voice interrupt - closing the generator drops the n8n request
+                    if client_state.state != ClientState.STATE_PLAYING:
+                        logger.warning("⏹️ Playback interrupted!")
+                        break
+                    
+                    await pacer.wait(len(chunk))
+                    await websocket.send(chunk)
                     
-                chunk = audio_bytes[i:i + chunk_size]
-                await websocket.send(chunk)
-                await asyncio.sleep(0.01)  # Small delay for ESP32
+                    if sent == 0:
+                        ttfb = time.perf_counter() - turn_start
+                        first_audio_stats.add(ttfb)
+                        turn_first_audio_stats[session.turn_kind].add(ttfb)
+                        session.first_audio.add(ttfb)
+                        logger.info(f"🔊 [{session.device_id}] First audio byte after {ttfb * 1000:.0f}ms")
+                    sent += len(chunk)
             
-            logger.info("✅ Response streamed")
-        else:
-            logger.error("❌ No response from n8n")
-        
-        await asyncio.sleep(0.3)
-        await websocket.send("AUDIO_END")
-        logger.info("✅ AUDIO_END sent")
+            if sent:
+                logger.info(f"✅ Response streamed ({sent} bytes)")
+            else:
+                logger.error("❌ No response from n8n")
+            
+            await asyncio.sleep(0.3)
+            await websocket.send("AUDIO_END")
+            logger.info("✅ AUDIO_END sent")
         
     except asyncio.CancelledError:
         logger.info("Pipeline cancelled")
@@ -395,25 +1623,162 @@ async def process_audio(audio_buffer, websocket, client_state):
 
 
 # ============================================================================
-# WebSocket Handler - Baidu RTC Style
+# Endpointing - device END / BARGE_IN, server STOP_RECORDING
 # ============================================================================
-active_ws = None
-active_state = None
+class EndpointStats:
+    """Which side ended each turn, and dispatch time saved by device END"""
+    
+    def __init__(self):
+        self.counts = {"device_end": 0, "server_silence": 0, "max_duration": 0}
+        self.barge_ins = 0
+        self.local_commands = Counter()  # Turns the device handled itself, by command
+        self.turns = Counter()  # By how they were opened - wake / followup
+        self.followup_timeouts = 0
+        self.saved_sec = 0.0
+    
+    def snapshot(self):
+        device_ends = self.counts["device_end"]
+        return {
+            **self.counts,
+            "barge_ins": self.barge_ins,
+            "local_commands": dict(self.local_commands),
+            "turns": dict(self.turns),
+            "followup_timeouts": self.followup_timeouts,
+            "avg_saved_ms": round(self.saved_sec / device_ends * 1000, 1) if device_ends else None,
+        }
 
 
-async def handle_client(websocket):
-    """Handle ESP32 client with continuous streaming"""
-    global active_ws, active_state, vad_sample_buffer
+endpoint_stats = EndpointStats()
+
+
+def dispatch_recording(session, reason):
+    """Hand the current recording to the pipeline and reset for the next turn"""
+    client_state = session.state
+    endpoint_stats.counts[reason] += 1
+    
+    if len(client_state.recording_buffer):
+        if client_state.current_task and not client_state.current_task.done():
+            client_state.current_task.cancel()
+        
+        # Leave LISTENING now so later chunks don't re-trigger the endpoint
+        client_state.state = ClientState.STATE_PROCESSING
+        client_state.current_task = asyncio.create_task(
+            process_audio(client_state.recording_buffer.to_wav(), session, time.perf_counter())
+        )
+    else:
+        client_state.state = ClientState.STATE_IDLE
+    
+    client_state.reset_recording()
+
+
+async def end_turn_on_server(session, reason):
+    """Server-side endpoint - dispatch and tell the device to stop uploading"""
+    dispatch_recording(session, reason)
+    try:
+        await session.ws.send("STOP_RECORDING")
+    except Exception:
+        pass
+
+
+def handle_device_end(session, current_time):
+    """Device VAD decided the user stopped - dispatch without waiting for silence"""
+    client_state = session.state
+    
+    if client_state.state == ClientState.STATE_LISTENING:
+        silence = current_time - (client_state.last_speech_time or current_time)
+        saved = max(0.0, SILENCE_TIMEOUT_SEC - silence)
+        endpoint_stats.saved_sec += saved
+        logger.info(f"🏁 [{session.device_id}] Device END → dispatch (saved {saved * 1000:.0f}ms)")
+        dispatch_recording(session, "device_end")
+    
+    elif client_state.state == ClientState.STATE_IDLE and client_state.speech_chunk_count > 0:
+        # Short utterance ended before server VAD confirmed it
+        logger.info(f"🏁 [{session.device_id}] Device END on short speech → dispatch")
+        dispatch_recording(session, "device_end")
+    
+    else:
+        # END after our own STOP_RECORDING, or while a response is playing
+        logger.debug(f"[{session.device_id}] END ignored in state {client_state.state}")
+
+
+def handle_barge_in(session):
+    """Device interrupted playback - drop the response immediately"""
+    client_state = session.state
+    endpoint_stats.barge_ins += 1
+    logger.warning(f"✋ [{session.device_id}] BARGE_IN")
+    
+    if client_state.current_task and not client_state.current_task.done():
+        client_state.current_task.cancel()
+    
+    client_state.reset_recording()
+    client_state.state = ClientState.STATE_IDLE
+
+
+def handle_turn_start(session, command):
+    """TURN wake|followup - a wake word starts a new n8n conversation"""
+    kind = command.partition(" ")[2]
+    session.turn_kind = kind if kind in turn_first_audio_stats else "wake"
+    endpoint_stats.turns[session.turn_kind] += 1
+    if session.turn_kind == "wake":
+        session.conversation_id = uuid.uuid4().hex[:12]
+    logger.info(f"🎙️ [{session.device_id}] Turn ({session.turn_kind}, conversation {session.conversation_id})")
+
+
+def handle_followup_end(session):
+    """Follow-up window closed without speech - discard anything buffered"""
+    client_state = session.state
+    endpoint_stats.followup_timeouts += 1
+    logger.info(f"💤 [{session.device_id}] Follow-up window closed")
     
-    # Reset VAD buffer for new client
-    vad_sample_buffer = []
+    if client_state.state in (ClientState.STATE_IDLE, ClientState.STATE_LISTENING):
+        client_state.reset_recording()
+        client_state.state = ClientState.STATE_IDLE
+
+
+def handle_tuning_report(session, command):
+    """TUNING k=v ... - '*' marks values stored for the next reboot"""
+    session.tuning = dict(field.partition("=")[::2] for field in command.split()[1:])
+
+
+def handle_device_stats(session, command):
+    """STATS <kind> key=value ... - per-turn device telemetry"""
+    _, kind, *fields = command.split()
+    values = {}
+    for field in fields:
+        key, _, value = field.partition("=")
+        try:
+            values[key] = int(value)
+        except ValueError:
+            values[key] = value
+    if kind == "uplink":
+        session.uplink = values
+        logger.info(f"📶 [{session.device_id}] Uplink: {values}")
+
+
+def handle_local_command(session, command):
+    """Device recognized the command with MultiNet - drop the uploaded turn"""
+    client_state = session.state
+    name = command.partition(" ")[2] or "unknown"
+    endpoint_stats.local_commands[name] += 1
+    logger.info(f"🏠 [{session.device_id}] Local command '{name}' - turn handled on device")
     
-    active_ws = websocket
-    client_state = ClientState()
-    active_state = client_state
+    if client_state.state in (ClientState.STATE_IDLE, ClientState.STATE_LISTENING):
+        client_state.reset_recording()
+        client_state.state = ClientState.STATE_IDLE
+
+
+# ============================================================================
+# WebSocket Handler - Baidu RTC Style
+# ============================================================================
+async def handle_client(websocket):
+    """Handle ESP32 client with continuous streaming"""
+    device_id, groups = parse_device_identity(websocket)
+    session = DeviceSession(websocket, device_id, groups)
+    client_state = session.state
+    await registry.register(session)
     
     client_addr = websocket.remote_address
-    logger.info(f"🔌 Connected: {client_addr}")
+    logger.info(f"🔌 Connected: {device_id} {client_addr} groups={sorted(session.groups)}")
     logger.info("📡 Continuous streaming mode - VAD only (no wake word)")
     
     try:
@@ -422,10 +1787,37 @@ async def handle_client(websocket):
             
             # Text commands (from ESP32)
             if isinstance(message, str):
-                logger.debug(f"Text: {message}")
+                command = message.strip()
+                if command == "END":
+                    handle_device_end(session, current_time)
+                elif command == "BARGE_IN":
+                    handle_barge_in(session)
+                elif command.startswith("TUNING"):
+                    handle_tuning_report(session, command)
+                elif command.startswith("TUNE_ERR"):
+                    logger.warning(f"🎛️ [{device_id}] Rejected tuning: {command[9:]}")
+                elif command.startswith("STATS "):
+                    handle_device_stats(session, command)
+                elif command.startswith("TURN"):
+                    handle_turn_start(session, command)
+                elif command == "FOLLOWUP_END":
+                    handle_followup_end(session)
+                elif command.startswith("LOCAL_CMD"):
+                    handle_local_command(session, command)
+                elif command.startswith("CLIP_"):
+                    handle_clip_message(session, command)
+                else:
+                    logger.debug(f"Text: {message}")
                 continue
             
             # Binary audio - continuous stream
+            if DEBUG_UPLINK_DELAY_MS or DEBUG_UPLINK_BPS:
+                impairment = DEBUG_UPLINK_DELAY_MS / 1000
+                if DEBUG_UPLINK_BPS:
+                    impairment += len(message) / DEBUG_UPLINK_BPS
+                await asyncio.sleep(impairment)
+            
+            chunk_start = time.perf_counter()
             raw_chunk = np.frombuffer(message, dtype=np.int16)
             
             # Debug: Save raw audio to file for inspection
@@ -434,7 +1826,7 @@ async def handle_client(websocket):
                 # Check if we have enough audio to save
                 total_samples = sum(len(c) for c in client_state.debug_audio_buffer)
                 if total_samples >= SAMPLE_RATE * DEBUG_AUDIO_SECONDS:
-                    save_debug_audio(client_state)
+                    save_debug_audio(client_state, device_id)
             
             # Apply software gain to boost weak mic signal
             chunk = raw_chunk.astype(np.float32) / 32768.0
@@ -458,7 +1850,7 @@ async def handle_client(websocket):
             rms = np.sqrt(np.mean(chunk ** 2))
             
             # Get speech probability
-            speech_prob = get_speech_probability(chunk)
+            speech_prob = await client_state.vad.process(chunk)
             is_speech = speech_prob > VAD_THRESHOLD
             
             # Debug logging every N chunks
@@ -468,6 +1860,7 @@ async def handle_client(websocket):
                     f"🔊 Audio: chunks={client_state.total_chunks}, "
                     f"raw={raw_max}, boosted={boosted_max:.3f}, "
                     f"VAD={speech_prob:.2f}, speech={is_speech}, "
+                    f"rtf={client_state.vad.rtf:.4f}, "
                     f"state={client_state.state}"
                 )
                 if raw_max < 50:
@@ -493,8 +1886,7 @@ async def handle_client(websocket):
                         logger.debug(f"🔇 Speech interrupted, resetting count (was {client_state.speech_chunk_count})")
                     client_state.speech_chunk_count = 0
                     # Keep small buffer for smooth transition
-                    if client_state.recording_buffer:
-                        client_state.recording_buffer = client_state.recording_buffer[-3:]
+                    client_state.recording_buffer.keep_preroll()
             
             # === STATE: LISTENING - Collecting speech ===
             elif client_state.state == ClientState.STATE_LISTENING:
@@ -513,37 +1905,18 @@ async def handle_client(websocket):
                     logger.debug(
                         f"📝 Recording: {recording_duration:.1f}s, "
                         f"silence={time_since_speech:.1f}s, "
-                        f"buffers={len(client_state.recording_buffer)}"
+                        f"samples={len(client_state.recording_buffer)}"
                     )
                 
                 # End on silence timeout
                 if time_since_speech > SILENCE_TIMEOUT_SEC:
                     logger.info(f"🔇 Silence detected ({time_since_speech:.1f}s)")
-                    
-                    # Process the recording
-                    if client_state.recording_buffer:
-                        if client_state.current_task and not client_state.current_task.done():
-                            client_state.current_task.cancel()
-                        
-                        client_state.current_task = asyncio.create_task(
-                            process_audio(list(client_state.recording_buffer), websocket, client_state)
-                        )
-                    
-                    client_state.reset_recording()
+                    await end_turn_on_server(session, "server_silence")
                 
                 # End on max duration
                 elif recording_duration > MAX_RECORDING_SEC:
                     logger.warning("⏱️ Max recording duration")
-                    
-                    if client_state.recording_buffer:
-                        if client_state.current_task and not client_state.current_task.done():
-                            client_state.current_task.cancel()
-                        
-                        client_state.current_task = asyncio.create_task(
-                            process_audio(list(client_state.recording_buffer), websocket, client_state)
-                        )
-                    
-                    client_state.reset_recording()
+                    await end_turn_on_server(session, "max_duration")
             
             # === STATE: PLAYING - Voice Interrupt Detection ===
             elif client_state.state == ClientState.STATE_PLAYING:
@@ -560,7 +1933,8 @@ async def handle_client(websocket):
                         
                         # Switch to listening mode
                         client_state.state = ClientState.STATE_LISTENING
-                        client_state.recording_buffer = [chunk]
+                        client_state.recording_buffer.clear()
+                        client_state.recording_buffer.append(chunk)
                         client_state.recording_start = current_time
                         client_state.last_speech_time = current_time
                         client_state.voice_interrupt_count = 0
@@ -572,6 +1946,8 @@ async def handle_client(websocket):
                             pass
                 else:
                     client_state.voice_interrupt_count = 0
+            
+            vad_stats.chunk_latencies.append(time.perf_counter() - chunk_start)
     
     except websockets.exceptions.ConnectionClosed:
         logger.info(f"Connection closed: {client_addr}")
@@ -581,56 +1957,300 @@ async def handle_client(websocket):
         if client_state.current_task and not client_state.current_task.done():
             client_state.current_task.cancel()
         
-        if active_ws == websocket:
-            active_ws = None
-            active_state = None
+        registry.unregister(session)
         
-        logger.info(f"🔌 Disconnected: {client_addr}")
+        logger.info(f"🔌 Disconnected: {device_id} {client_addr}")
 
 
 # ============================================================================
 # HTTP API
 # ============================================================================
+async def speak_to_session(session, queue, request_start):
+    """Play MP3 chunks from a queue on one device (None ends the stream)"""
+    async with session.play_lock:
+        session.state.state = ClientState.STATE_PLAYING
+        try:
+            await session.ws.send("AUDIO_START")
+            first = True
+            while (chunk := await queue.get()) is not None:
+                await session.ws.send(chunk)
+                if first:
+                    clip_stats.time_to_audio["stream"].add(time.perf_counter() - request_start)
+                    first = False
+            await asyncio.sleep(0.3)
+            await session.ws.send("AUDIO_END")
+        finally:
+            session.state.state = ClientState.STATE_IDLE
+
+
+async def speak_phrase(session, text, request_start):
+    """Speak a short phrase on one device - from its clip cache if resident"""
+    cid = register_clip(text)
+    clip_plays[cid] += 1
+    if cid in session.clips:
+        await play_clip(session, cid, request_start)
+        return
+    
+    queue = asyncio.Queue()
+    player = asyncio.create_task(speak_to_session(session, queue, request_start))
+    try:
+        async for chunk in cached_tts_stream(text):
+            queue.put_nowait(chunk)
+    finally:
+        queue.put_nowait(None)
+    await player
+    
+    if clip_plays[cid] >= CLIP_PUSH_MIN_PLAYS:
+        asyncio.create_task(push_clip(session, cid))
+
+
 async def handle_speak_request(request):
-    """Immediate TTS to ESP32"""
+    """Immediate TTS to one device, a group, or the last connected device
+    
+    Body: {"text": "...", "device": "<device_id>"} or {"text": "...", "group": "<group>"}
+    """
     try:
         data = await request.json()
         text = data.get("text", "")
         
-        if not active_ws:
+        targets = registry.select(data.get("device"), data.get("group"))
+        if not targets:
             return web.json_response({"error": "No client"}, status=400)
         
         if not text:
             return web.json_response({"error": "Missing text"}, status=400)
         
-        logger.info(f"📢 Speaking: '{text[:40]}...'")
+        request_start = time.perf_counter()
+        cid = register_clip(text)
+        clip_plays[cid] += 1
         
-        if active_state:
-            active_state.state = ClientState.STATE_PLAYING
+        # Devices holding the clip play it locally, the rest get a stream
+        resident = [s for s in targets if cid in s.clips]
+        streamed = [s for s in targets if cid not in s.clips]
+        targets = resident + streamed
+        device_ids = [s.device_id for s in targets]
+        logger.info(f"📢 Speaking to {device_ids} ({len(resident)} cached): '{text[:40]}...'")
         
-        await active_ws.send("AUDIO_START")
-        async for chunk in tts_stream(text):
-            await active_ws.send(chunk)
-        await asyncio.sleep(0.3)
-        await active_ws.send("AUDIO_END")
+        # Synthesize once, fan out to every streamed target as audio is produced
+        queues = [asyncio.Queue() for _ in streamed]
+        players = asyncio.gather(
+            *(play_clip(s, cid, request_start) for s in resident),
+            *(speak_to_session(s, q, request_start) for s, q in zip(streamed, queues)),
+            return_exceptions=True,
+        )
+        if streamed:
+            try:
+                async for chunk in cached_tts_stream(text):
+                    for q in queues:
+                        q.put_nowait(chunk)
+            finally:
+                for q in queues:
+                    q.put_nowait(None)
+        results = await players
+        
+        failed = {d: str(r) for d, r in zip(device_ids, results) if isinstance(r, Exception)}
+        if failed:
+            logger.warning(f"Speak failed on {list(failed)}")
         
-        if active_state:
-            active_state.state = ClientState.STATE_IDLE
+        # Frequent phrase - push it so the next play skips streaming
+        if clip_plays[cid] >= CLIP_PUSH_MIN_PLAYS:
+            for s in streamed:
+                if s.device_id not in failed:
+                    asyncio.create_task(push_clip(s, cid))
         
-        return web.json_response({"status": "ok"})
+        return web.json_response({
+            "status": "ok" if not failed else "partial",
+            "devices": [d for d in device_ids if d not in failed],
+            "failed": failed,
+        })
         
     except Exception as e:
         return web.json_response({"error": str(e)}, status=500)
 
 
+async def handle_clips_request(request):
+    """Control device clip residency
+    
+    Body: {"text": "...", "action": "push" | "drop", "device": "<id>" | "group": "<group>"}
+    """
+    try:
+        data = await request.json()
+        text = data.get("text", "")
+        action = data.get("action", "push")
+        
+        targets = registry.select(data.get("device"), data.get("group"))
+        if not targets:
+            return web.json_response({"error": "No client"}, status=400)
+        if not text or action not in ("push", "drop"):
+            return web.json_response({"error": "Missing text or bad action"}, status=400)
+        
+        cid = register_clip(text)
+        if action == "drop":
+            for s in targets:
+                await s.ws.send(f"CLIP_DROP {cid}")
+                s.clips.discard(cid)
+            return web.json_response({"status": "ok", "clip": cid, "devices": [s.device_id for s in targets]})
+        
+        # Make sure the phrase is synthesized before pushing
+        async for _ in cached_tts_stream(text):
+            pass
+        pushed = [s.device_id for s in targets if await push_clip(s, cid)]
+        return web.json_response({"status": "ok", "clip": cid, "devices": pushed})
+        
+    except Exception as e:
+        return web.json_response({"error": str(e)}, status=500)
+
+
+async def send_tuning(session, params):
+    """Push runtime tuning to a device - it answers with TUNING"""
+    if params:
+        await session.ws.send("TUNE " + " ".join(f"{k}={v}" for k, v in params.items()))
+
+
+async def handle_tune_request(request):
+    """Set device runtime tuning live
+    
+    Body: {"params": {"vad_silence": 4, ...}, "device": "<id>" | "group": "<group>",
+           "reset": false, "reboot": false}
+    Buffer sizes, AFE gain and ping interval apply after "reboot": true.
+    """
+    try:
+        data = await request.json()
+        targets = registry.select(data.get("device"), data.get("group"))
+        if not targets:
+            return web.json_response({"error": "No client"}, status=400)
+        
+        for s in targets:
+            if data.get("reset"):
+                await s.ws.send("TUNE_RESET")
+            await send_tuning(s, data.get("params", {}))
+            if data.get("reboot"):
+                await s.ws.send("REBOOT")
+        
+        return web.json_response({"status": "ok", "devices": [s.device_id for s in targets]})
+        
+    except Exception as e:
+        return web.json_response({"error": str(e)}, status=500)
+
+
+sweeps = {}  # sweep id -> {"status", "param", "results", ...}
+
+
+async def run_sweep(sweep, targets, param, values, step_sec, split):
+    """Scripted A/B over one tuning parameter
+    
+    Sequential: every device runs each value for step_sec in turn.
+    Split: values are assigned round-robin across devices and run at once.
+    Each step records per-device first-audio latency and uplink telemetry,
+    then the original values are restored.
+    """
+    original = {s.device_id: s.tuning.get(param, "").rstrip("*") for s in targets}
+    steps = [[(s, values[i % len(values)]) for i, s in enumerate(targets)]] if split \
+        else [[(s, value) for s in targets] for value in values]
+    
+    try:
+        for step in steps:
+            for s, value in step:
+                s.first_audio.samples.clear()
+                await send_tuning(s, {param: value})
+            sweep["current"] = [value for _, value in step]
+            await asyncio.sleep(step_sec)
+            sweep["results"].append({
+                s.device_id: {
+                    "value": value,
+                    "first_audio": s.first_audio.snapshot(),
+                    "uplink": dict(s.uplink),
+                } for s, value in step
+            })
+        sweep["status"] = "done"
+    except asyncio.CancelledError:
+        sweep["status"] = "cancelled"
+        raise
+    except Exception as e:
+        sweep["status"] = f"error: {e}"
+    finally:
+        # Tuning lives in device NVS - restore on the current session even after a reconnect
+        for device_id, value in original.items():
+            session = registry.get(device_id)
+            if value and session:
+                try:
+                    await send_tuning(session, {param: value})
+                except Exception:
+                    pass
+
+
+async def handle_sweep_request(request):
+    """Start a tuning sweep
+    
+    Body: {"param": "vad_silence", "values": [2, 3, 4], "step_sec": 300,
+           "split": false, "device": "<id>" | "group": "<group>"}
+    """
+    try:
+        data = await request.json()
+        targets = registry.select(data.get("device"), data.get("group"))
+        param = data.get("param")
+        values = data.get("values") or []
+        if not targets:
+            return web.json_response({"error": "No client"}, status=400)
+        if not param or not values:
+            return web.json_response({"error": "Missing param or values"}, status=400)
+        
+        sweep_id = uuid.uuid4().hex[:8]
+        sweep = {
+            "status": "running",
+            "param": param,
+            "values": values,
+            "devices": [s.device_id for s in targets],
+            "results": [],
+        }
+        sweeps[sweep_id] = sweep
+        sweep["task"] = asyncio.create_task(run_sweep(
+            sweep, targets, param, values, float(data.get("step_sec", 300)), bool(data.get("split"))
+        ))
+        return web.json_response({"status": "ok", "sweep_id": sweep_id})
+        
+    except Exception as e:
+        return web.json_response({"error": str(e)}, status=500)
+
+
+def sweep_info(sweep):
+    return {k: v for k, v in sweep.items() if k != "task"}
+
+
+async def handle_sweep_status(request):
+    """Sweep progress and results - ?id=<sweep_id>, or all sweeps"""
+    sweep_id = request.query.get("id")
+    if sweep_id:
+        if sweep_id not in sweeps:
+            return web.json_response({"error": "Unknown sweep"}, status=404)
+        return web.json_response(sweep_info(sweeps[sweep_id]))
+    return web.json_response({k: sweep_info(v) for k, v in sweeps.items()})
+
+
 async def handle_status(request):
-    """Server status endpoint"""
+    """Server status endpoint - all devices, or ?device=<id>"""
+    device = request.query.get("device")
+    if device:
+        session = registry.get(device)
+        if not session:
+            return web.json_response({"error": "Unknown device"}, status=404)
+        return web.json_response(session.info())
+    
     return web.json_response({
         "status": "running",
         "mode": "vad_only",
-        "client_connected": active_ws is not None,
-        "client_state": active_state.state if active_state else None,
+        "clients_connected": len(registry.sessions),
+        "devices": [s.info() for s in registry.sessions.values()],
         "vad_available": VAD_AVAILABLE,
+        "vad": vad_stats.snapshot(),
+        "endpointing": endpoint_stats.snapshot(),
+        "first_audio": first_audio_stats.snapshot(),
+        "first_audio_by_turn": {k: v.snapshot() for k, v in turn_first_audio_stats.items()},
+        "n8n_upload": upload_stats.snapshot(),
+        "tts": tts_stats.snapshot(),
+        "tts_cache": tts_cache.snapshot(),
+        "device_clips": clip_stats.snapshot(),
+        "fast_path": fast_path_stats.snapshot(),
     })
 
 
@@ -638,6 +2258,10 @@ async def start_http_server():
     """Start HTTP API server"""
     app = web.Application()
     app.router.add_post("/speak", handle_speak_request)
+    app.router.add_post("/clips", handle_clips_request)
+    app.router.add_post("/tune", handle_tune_request)
+    app.router.add_post("/sweep", handle_sweep_request)
+    app.router.add_get("/sweep", handle_sweep_status)
     app.router.add_get("/status", handle_status)
     
     runner = web.AppRunner(app)
@@ -652,11 +2276,14 @@ async def start_http_server():
 # Main
 # ============================================================================
 async def main():
+    global http_session, tts_slots, synth_slots
+    
     logger.info("╔════════════════════════════════════════╗")
     logger.info("║   JARVIS v6 Server - VAD Only Mode   ║")
     logger.info("║   Continuous Streaming (No Wake Word)  ║")
     logger.info("╠════════════════════════════════════════╣")
     logger.info(f"║   VAD:     {'✅ Ready' if VAD_AVAILABLE else '❌ Not available':<20} ║")
+    logger.info(f"║   Fast:    {'✅ Ready' if asr_model is not None else '❌ Not available':<20} ║")
     logger.info("╠════════════════════════════════════════╣")
     logger.info("║   Features:                           ║")
     logger.info("║   • Auto-detect speech (VAD)          ║")
@@ -664,19 +2291,34 @@ async def main():
     logger.info("║   • Voice Interrupt Detection         ║")
     logger.info("╚════════════════════════════════════════╝")
     
+    vad_batcher.start()
+    http_session = create_http_session()
+    tts_slots = asyncio.Semaphore(TTS_MAX_CONCURRENT)
+    synth_slots = asyncio.Semaphore(TTS_MAX_SYNTH_CONCURRENT)
+    for voice in ("Linh", "Samantha"):
+        encoder_pool.refill(voice_filters(voice))
+    if asr_model is not None:
+        start_mqtt()
+    asyncio.create_task(prewarm_tts_cache(fast_path_replies() if fast_path_ready() else ()))
     await start_http_server()
     
-    async with websockets.serve(
-        handle_client, 
-        "0.0.0.0", 
-        PORT, 
-        max_size=64 * 1024,
-        ping_interval=20,
-        ping_timeout=10,
-    ):
-        logger.info(f"🎤 WebSocket server on port {PORT}")
-        logger.info("   Waiting for ESP32 (continuous stream)...")
-        await asyncio.Future()
+    try:
+        async with websockets.serve(
+            handle_client, 
+            "0.0.0.0", 
+            PORT, 
+            max_size=64 * 1024,
+            ping_interval=20,
+            ping_timeout=10,
+        ):
+            logger.info(f"🎤 WebSocket server on port {PORT}")
+            logger.info("   Waiting for ESP32 (continuous stream)...")
+            await asyncio.Future()
+    finally:
+        encoder_pool.close()
+        if mqtt_client is not None:
+            mqtt_client.loop_stop()
+        await http_session.close()
 
 
 if __name__ == "__main__":